@@ -67,19 +67,6 @@ bool variable_type::is_void() const {
     return is_intrinsic() && std::get<intrinsic_type>(type) == intrinsic_type::void_;
 }
 
-size_t variable_type::get_size() const {
-    if (is_intrinsic())
-        return *pm::find_element(intrinsic_size, std::get<intrinsic_type>(type));
-
-    auto struct_type = *pm::find_element(struct_types, std::get<std::string_view>(type));
-    size_t size = 0;
-
-    for (const auto &field : struct_type)
-        size += field.type.get_size();
-
-    return size;
-}
-
 bool variable_type::operator ==(const variable_type &other) const {
     return type == other.type && pointer_depth == other.pointer_depth;
 }
@@ -8,7 +8,7 @@ using namespace ast::nodes;
 
 // -- Specialized Constructors --
 
-array_initializer::array_initializer(variable_type type, ast::nodes::initializer_list &&init_list)
+array_initializer::array_initializer(variable_type type, ast::nodes::initializer_list &&init_list, util::arena &arena)
     : array_type(type), values(std::move(init_list.values)) {
 
     const auto expected_type = array_type.dereference();
@@ -20,12 +20,12 @@ array_initializer::array_initializer(variable_type type, ast::nodes::initializer
             if (!val_type.is_intrinsic() || !array_type.is_intrinsic())
                 throw std::runtime_error("Non-intrinsic types cannot be casted (yet)!");
 
-            val = std::make_unique<cast>(std::move(val), expected_type);
+            val = make_node<cast>(arena, std::move(val), expected_type);
         }
     }
 }
 
-struct_initializer::struct_initializer(const struct_declaration* type, std::vector<std::unique_ptr<nodes::expression>> init_list)
+struct_initializer::struct_initializer(const struct_declaration* type, std::vector<nodes::node_ptr<nodes::expression>> init_list, util::arena &arena)
     : struct_type(type->struct_name), values(std::move(init_list)) {
     const auto &fields = type->fields;
 
@@ -40,7 +40,47 @@ struct_initializer::struct_initializer(const struct_declaration* type, std::vect
             if (!val_type.is_intrinsic() || !expected_type.is_intrinsic())
                 throw std::runtime_error("Non-intrinsic types cannot be casted (yet)!");
 
-            values[i] = std::make_unique<cast>(std::move(values[i]), expected_type);
+            values[i] = make_node<cast>(arena, std::move(values[i]), expected_type);
         }
     }
-}
\ No newline at end of file
+}
+
+// -- Printing ------------------
+
+std::string literal::get_type_name() const {
+    switch (value.index()) {
+        case UINT:
+            return "uint " + std::to_string(type_size);
+        case INT:
+            return "int " + std::to_string(type_size);
+        case FLOAT:
+            return "float " + std::to_string(type_size);
+        case CHAR:
+            return "char " + std::to_string(type_size);
+        case STRING:
+            break;
+        default:
+            std::unreachable();
+    }
+
+    // Strings are printed the way they were written, so control characters stay on one line
+    std::string out = "string ";
+
+    for (const char c : std::get<std::string_view>(value)) {
+        switch (c) {
+            case '\n': out += "\\n"; break;
+            case '\t': out += "\\t"; break;
+            case '\r': out += "\\r"; break;
+            case '\0': out += "\\0"; break;
+            case '\a': out += "\\a"; break;
+            case '\b': out += "\\b"; break;
+            case '\f': out += "\\f"; break;
+            case '\v': out += "\\v"; break;
+            case '\\': out += "\\\\"; break;
+            case '\"': out += "\\\""; break;
+            default: out += c; break;
+        }
+    }
+
+    return out;
+}
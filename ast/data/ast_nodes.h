@@ -1,9 +1,14 @@
 #pragma once
 
+#include <optional>
 #include <utility>
 #include "abstract_data.h"
 #include "data_maps.h"
 
+namespace ast {
+    struct lazy_state;
+}
+
 namespace ast::nodes {
     // -- Expression Nodes ----------
 
@@ -14,12 +19,12 @@ namespace ast::nodes {
         DETAILS(method_name);
 
         std::string_view method_name;
-        std::vector<std::unique_ptr<expression>> arguments;
+        std::vector<node_ptr<expression>> arguments;
         variable_type return_type;
 
         method_call(method_call&&) noexcept = default;
         method_call(std::string_view method_name,
-                    std::vector<std::unique_ptr<expression>> arguments)
+                    std::vector<node_ptr<expression>> arguments)
                 : method_name(method_name), arguments(std::move(arguments)), return_type(variable_type::void_type()) {}
 
         CG_BASICGEN();
@@ -67,10 +72,10 @@ namespace ast::nodes {
         DETAILS(ast::pm::find_key(ast::pm::unop_type_map, type));
 
         un_op_type type;
-        std::unique_ptr<expression> value;
+        node_ptr<expression> value;
 
         un_op(un_op&&) noexcept = default;
-        un_op(un_op_type type, std::unique_ptr<expression> value) noexcept
+        un_op(un_op_type type, node_ptr<expression> value) noexcept
             : type(type), value(std::move(value)) {}
 
         CG_BASICGEN();
@@ -86,14 +91,17 @@ namespace ast::nodes {
         DETAILS(ast::pm::find_key(ast::pm::binop_type_map, type));
 
         bin_op_type type;
-        std::unique_ptr<expression> left;
-        std::unique_ptr<expression> right;
+        node_ptr<expression> left;
+        node_ptr<expression> right;
+
+        // Set by the validator once its operands are checked, so the type of a long chain is not walked again
+        std::optional<variable_type> result_type;
 
         bin_op(bin_op&&) noexcept = default;
-        bin_op(bin_op_type type, std::unique_ptr<expression> left, std::unique_ptr<expression> right) noexcept
+        bin_op(bin_op_type type, node_ptr<expression> left, node_ptr<expression> right) noexcept
                 : type(type), left(std::move(left)), right(std::move(right)) {}
 
-        virtual void populate(std::unique_ptr<expression> left, std::unique_ptr<expression> right) {
+        virtual void populate(node_ptr<expression> left, node_ptr<expression> right) {
             this->left = std::move(left);
             this->right = std::move(right);
         }
@@ -108,11 +116,11 @@ namespace ast::nodes {
         NODENAME("MATCH_CASE");
         CHILDREN(match_expr, body);
 
-        std::unique_ptr<expression> match_expr;
+        node_ptr<expression> match_expr;
         scope_block body;
 
         match_case(match_case&&) noexcept = default;
-        match_case(std::unique_ptr<expression> match_expr, scope_block body)
+        match_case(node_ptr<expression> match_expr, scope_block body)
                 : match_expr(std::move(match_expr)), body(std::move(body)) {}
     };
 
@@ -120,13 +128,13 @@ namespace ast::nodes {
         NODENAME("MATCH");
         CHILDREN(match_expr, cases, default_case);
 
-        std::unique_ptr<expression> match_expr;
+        node_ptr<expression> match_expr;
         std::vector<match_case> cases;
         std::unique_ptr<scope_block> default_case;
 
         match(match&&) noexcept = default;
         match() = default;
-        match(std::unique_ptr<expression> match_expr, std::vector<match_case> cases)
+        match(node_ptr<expression> match_expr, std::vector<match_case> cases)
                 : match_expr(std::move(match_expr)), cases(std::move(cases)) {}
 
         ~match() = default;
@@ -140,11 +148,11 @@ namespace ast::nodes {
         CHILDREN(lhs, rhs);
         DETAILS(op ? ast::pm::find_key(ast::pm::binop_type_map, *op) : "" + std::string("="));
 
-        std::unique_ptr<expression> lhs, rhs;
+        node_ptr<expression> lhs, rhs;
         std::optional<bin_op_type> op = std::nullopt;
 
         assignment(assignment&&) noexcept = default;
-        assignment(std::unique_ptr<expression> lhs, std::unique_ptr<expression> rhs, std::optional<bin_op_type> additional_operator = std::nullopt)
+        assignment(node_ptr<expression> lhs, node_ptr<expression> rhs, std::optional<bin_op_type> additional_operator = std::nullopt)
                 : lhs(std::move(lhs)), rhs(std::move(rhs)), op(additional_operator) {}
 
         CG_BASICGEN();
@@ -161,7 +169,8 @@ namespace ast::nodes {
         STRING
     };
     struct literal : expression {
-        using lit_variant = std::variant<unsigned int, int, double, char, std::string_view>;
+        // Strings hold their text after escape processing
+        using lit_variant = std::variant<uint64_t, int64_t, double, char, std::string_view>;
 
         NODENAME("LITERAL");
         DETAILS(get_type_name());
@@ -169,30 +178,19 @@ namespace ast::nodes {
         lit_variant value;
         uint8_t type_size = 32;
 
+        // Set when the literal was written with a type suffix, e.g. 255u8
+        std::optional<intrinsic_type> suffix;
+
         literal(literal&&) noexcept = default;
-        literal(lit_variant value, uint8_t type_size = 32) noexcept : value(std::move(value)), type_size(type_size) {}
+        literal(lit_variant value, uint8_t type_size = 32, std::optional<intrinsic_type> suffix = std::nullopt) noexcept
+            : value(std::move(value)), type_size(type_size), suffix(suffix) {}
 
         CG_BASICGEN();
         ~literal() = default;
 
         variable_type get_type() const override;
 
-        std::string get_type_name() const {
-            switch (value.index()) {
-                case UINT:
-                    return "uint " + std::to_string(type_size);
-                case INT:
-                    return "int " + std::to_string(type_size);
-                case FLOAT:
-                    return "float " + std::to_string(type_size);
-                case CHAR:
-                    return "char " + std::to_string(type_size);
-                case STRING:
-                    return "string " + std::string(std::get<std::string_view>(value));
-                default:
-                    std::unreachable();
-            }
-        }
+        std::string get_type_name() const;
     };
 
     struct cast : expression {
@@ -200,11 +198,11 @@ namespace ast::nodes {
         CHILDREN(expr);
         DETAILS(cast_type);
 
-        std::unique_ptr<expression> expr;
+        node_ptr<expression> expr;
         variable_type cast_type;
 
         cast(cast&&) noexcept = default;
-        cast(std::unique_ptr<expression> expr, variable_type cast_type)
+        cast(node_ptr<expression> expr, variable_type cast_type)
             : expr(std::move(expr)), cast_type(cast_type) {}
 
         CG_BASICGEN();
@@ -216,10 +214,10 @@ namespace ast::nodes {
         NODENAME("LOAD");
         CHILDREN(expr);
 
-        std::unique_ptr<expression> expr;
+        node_ptr<expression> expr;
 
         load(load&&) noexcept = default;
-        load(std::unique_ptr<expression> expr) : expr(std::move(expr)) {}
+        load(node_ptr<expression> expr) : expr(std::move(expr)) {}
 
         CG_BASICGEN();
 
@@ -230,10 +228,10 @@ namespace ast::nodes {
         NODENAME("EXPRESSION_SHIELD");
         CHILDREN(expr);
 
-        std::unique_ptr<expression> expr;
+        node_ptr<expression> expr;
 
         expression_shield(expression_shield&&) noexcept = default;
-        expression_shield(std::unique_ptr<expression> expr) : expr(std::move(expr)) {}
+        expression_shield(node_ptr<expression> expr) : expr(std::move(expr)) {}
 
         CG_BASICGEN();
 
@@ -247,10 +245,10 @@ namespace ast::nodes {
         CHILDREN(values);
 
         std::string_view struct_hint;
-        std::vector<std::unique_ptr<expression>> values;
+        std::vector<node_ptr<expression>> values;
 
         initializer_list(initializer_list&&) noexcept = default;
-        initializer_list(std::vector<std::unique_ptr<expression>> values, std::string_view struct_hint = "")
+        initializer_list(std::vector<node_ptr<expression>> values, std::string_view struct_hint = "")
             : values(std::move(values)), struct_hint(struct_hint) {}
 
         CG_BASICGEN();
@@ -263,9 +261,9 @@ namespace ast::nodes {
         CHILDREN(values);
 
         variable_type array_type;
-        std::vector<std::unique_ptr<expression>> values;
+        std::vector<node_ptr<expression>> values;
 
-        array_initializer(variable_type, initializer_list&&);
+        array_initializer(variable_type, initializer_list&&, util::arena &arena);
 
         CG_BASICGEN();
 
@@ -282,9 +280,9 @@ namespace ast::nodes {
 
         std::string_view struct_type;
         std::vector<type_instance> struct_types;
-        std::vector<std::unique_ptr<expression>> values;
+        std::vector<node_ptr<expression>> values;
 
-        struct_initializer(const struct_declaration* initializer, std::vector<std::unique_ptr<nodes::expression>> init_list);
+        struct_initializer(const struct_declaration* initializer, std::vector<nodes::node_ptr<nodes::expression>> init_list, util::arena &arena);
 
         CG_BASICGEN();
 
@@ -299,11 +297,11 @@ namespace ast::nodes {
         NODENAME("RETURN_OP");
         CHILDREN(val);
 
-        std::unique_ptr<expression> val;
+        node_ptr<expression> val;
 
         return_op() = default;
         return_op(return_op&&) noexcept = default;
-        return_op(std::unique_ptr<expression> val) : val(std::move(val)) {}
+        return_op(node_ptr<expression> val) : val(std::move(val)) {}
 
         ~return_op() = default;
         CG_BASICGEN();
@@ -313,14 +311,14 @@ namespace ast::nodes {
         NODENAME("IF_STATEMENT");
         CHILDREN(condition, body, else_body);
 
-        std::unique_ptr<expression> condition;
+        node_ptr<expression> condition;
         scope_block body;
         std::optional<scope_block> else_body = std::nullopt;
 
         if_statement(if_statement&&) noexcept = default;
-        if_statement(std::unique_ptr<expression> condition, scope_block body)
+        if_statement(node_ptr<expression> condition, scope_block body)
             : condition(std::move(condition)), body(std::move(body)) {}
-        if_statement(std::unique_ptr<expression> condition, scope_block body,
+        if_statement(node_ptr<expression> condition, scope_block body,
                      std::optional<scope_block> else_body)
             : condition(std::move(condition)), body(std::move(body)), else_body(std::move(else_body)) {}
 
@@ -333,11 +331,11 @@ namespace ast::nodes {
         CHILDREN(condition, body);
 
         bool pre_eval = true;
-        std::unique_ptr<expression> condition;
+        node_ptr<expression> condition;
         scope_block body;
 
         loop(loop&&) noexcept = default;
-        loop(bool pre_eval, std::unique_ptr<expression> condition, scope_block body)
+        loop(bool pre_eval, node_ptr<expression> condition, scope_block body)
                 : pre_eval(pre_eval), condition(std::move(condition)), body(std::move(body)) {}
 
         ~loop() = default;
@@ -348,12 +346,12 @@ namespace ast::nodes {
         NODENAME("FOR_LOOP");
         CHILDREN(init, condition, update, body);
 
-        std::unique_ptr<expression> init;
-        std::unique_ptr<expression> update;
+        node_ptr<expression> init;
+        node_ptr<expression> update;
 
         for_loop(for_loop&&) noexcept = default;
-        for_loop(std::unique_ptr<expression> init, std::unique_ptr<expression> condition,
-                 std::unique_ptr<expression> update, scope_block body)
+        for_loop(node_ptr<expression> init, node_ptr<expression> condition,
+                 node_ptr<expression> update, scope_block body)
                 : init(std::move(init)), loop(true, std::move(condition), std::move(body)),
                   update(std::move(update)) {}
 
@@ -365,10 +363,10 @@ namespace ast::nodes {
         NODENAME("EXPRESSION_ROOT");
         CHILDREN(expr);
 
-        std::unique_ptr<expression> expr;
+        node_ptr<expression> expr;
 
         expression_root(expression_root&&) noexcept = default;
-        expression_root(std::unique_ptr<expression> expr) : expr(std::move(expr)) {}
+        expression_root(node_ptr<expression> expr) : expr(std::move(expr)) {}
 
         ~expression_root() = default;
         CG_BASICGEN();
@@ -411,7 +409,16 @@ namespace ast::nodes {
         std::string_view fn_name;
         method_params params;
 
-        std::unique_ptr<function> implementation = nullptr;
+        // Filled in on first use for a body a lazy parse skipped, hence mutable
+        mutable std::unique_ptr<function> implementation = nullptr;
+
+        struct lazy_body {
+            lex::token_cursor start;  // The body's opening brace
+            const lazy_state *state;  // What it is parsed and validated against, kept alive by the root
+        };
+
+        // A body left as tokens by a lazy parse, until get_implementation() parses it
+        mutable std::optional<lazy_body> lazy;
 
         function_prototype(function_prototype&&) noexcept = default;
         function_prototype(variable_type return_type, std::string_view method_name, method_params params, std::unique_ptr<function> implementation = nullptr)
@@ -419,6 +426,13 @@ namespace ast::nodes {
 
         ~function_prototype() = default;
 
+        bool has_body() const {
+            return implementation || lazy;
+        }
+
+        // The implementation, if there is one, parsing and validating a lazy body the first time it is asked for
+        const function* get_implementation() const;
+
         CG_CUSTOMGEN(llvm::Function*);
     };
 
@@ -449,14 +463,19 @@ namespace ast::nodes {
         NODENAME("ROOT");
         CHILDREN(program_level_statements);
 
+        // Every expression in the tree, held by pointer so lazy bodies parsed after the root has moved can
+        // still find it. Declared first, so it outlives everything referring to its nodes.
+        std::unique_ptr<util::arena> arena = std::make_unique<util::arena>();
+
         std::vector<std::unique_ptr<program_level_stmt>> program_level_statements;
 
+        // The declarations of a lazy parse, which bodies still left as tokens are parsed and validated against
+        std::shared_ptr<lazy_state> lazy_context;
+
         root() noexcept = default;
         root(root&&) noexcept = default;
         ~root() = default;
 
-
-
         CG_BASICGEN();
     };
 }
@@ -3,29 +3,6 @@
 using namespace ast;
 using namespace nodes;
 
-const std::unordered_map<bin_op_type, uint16_t> pm::binop_prec {
-    { bin_op_type::acc,   1 },
-    { bin_op_type::l_or,  2  },
-    { bin_op_type::l_and, 3  },
-    { bin_op_type::l_xor, 3  },
-    { bin_op_type::b_or,  4  },
-    { bin_op_type::b_xor, 5  },
-    { bin_op_type::b_and, 6  },
-    { bin_op_type::eq,    7  },
-    { bin_op_type::neq,   7  },
-    { bin_op_type::lt,    8  },
-    { bin_op_type::gt,    8  },
-    { bin_op_type::lte,   8  },
-    { bin_op_type::gte,   8  },
-    { bin_op_type::add,   10 },
-    { bin_op_type::sub,   10 },
-    { bin_op_type::mul,   20 },
-    { bin_op_type::div,   20 },
-    { bin_op_type::mod,   20 },
-    { bin_op_type::shl,   20 },
-    { bin_op_type::shr,   20 },
-};
-
 const std::unordered_map<std::string_view, bin_op_type> pm::binop_type_map {
     { "||", bin_op_type::l_or  },
     { "&&", bin_op_type::l_and },
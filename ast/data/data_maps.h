@@ -1,9 +1,93 @@
 #pragma once
+#include <array>
+#include <optional>
 #include <unordered_map>
 #include "abstract_data.h"
+#include "../../lexer/lex.h"
 
 namespace ast::pm {
-    const extern std::unordered_map<nodes::bin_op_type, uint16_t> binop_prec;
+    struct binary_operator {
+        nodes::bin_op_type type;
+        uint8_t precedence; // 0 for tokens which are not binary operators
+    };
+
+    template <typename T>
+    using token_table = std::array<T, static_cast<size_t>(lex::token_id::count)>;
+
+    /**
+     *  Operator Tables: Token ID to Operator
+     *  -------------------------------------
+     *  The operator a token stands for in an expression, indexed directly by its
+     *  token_id, so the expression parser never hashes a token's spelling.
+     *  Access binds tightest, so s.a + 1 reads as (s.a) + 1.
+     */
+    constexpr token_table<binary_operator> BINARY_OPERATORS = [] {
+        using enum lex::token_id;
+        using nodes::bin_op_type;
+
+        token_table<binary_operator> table {};
+        const auto set = [&table](const lex::token_id id, const bin_op_type type, const uint8_t precedence) {
+            table[static_cast<size_t>(id)] = { type, precedence };
+        };
+
+        set(pipe_pipe, bin_op_type::l_or,  2);
+        set(amp_amp,   bin_op_type::l_and, 3);
+        set(pipe,      bin_op_type::b_or,  4);
+        set(caret,     bin_op_type::b_xor, 5);
+        set(amp,       bin_op_type::b_and, 6);
+        set(eq_eq,     bin_op_type::eq,    7);
+        set(bang_eq,   bin_op_type::neq,   7);
+        set(lt,        bin_op_type::lt,    8);
+        set(gt,        bin_op_type::gt,    8);
+        set(lt_eq,     bin_op_type::lte,   8);
+        set(gt_eq,     bin_op_type::gte,   8);
+        set(plus,      bin_op_type::add,   10);
+        set(minus,     bin_op_type::sub,   10);
+        set(star,      bin_op_type::mul,   20);
+        set(slash,     bin_op_type::div,   20);
+        set(percent,   bin_op_type::mod,   20);
+        set(shl,       bin_op_type::shl,   20);
+        set(shr,       bin_op_type::shr,   20);
+        set(dot,       bin_op_type::acc,   30);
+        set(arrow,     bin_op_type::accdf, 30);
+
+        return table;
+    }();
+
+    constexpr token_table<std::optional<nodes::un_op_type>> UNARY_OPERATORS = [] {
+        using enum lex::token_id;
+        using nodes::un_op_type;
+
+        token_table<std::optional<un_op_type>> table {};
+
+        table[static_cast<size_t>(star)]  = un_op_type::deref;
+        table[static_cast<size_t>(amp)]   = un_op_type::addr_of;
+        table[static_cast<size_t>(bang)]  = un_op_type::log_not;
+        table[static_cast<size_t>(minus)] = un_op_type::negate;
+        table[static_cast<size_t>(tilde)] = un_op_type::bit_not;
+
+        return table;
+    }();
+
+    // The operator a compound assignment applies, e.g. add for +=; nullopt for a plain =
+    constexpr token_table<std::optional<nodes::bin_op_type>> ASSIGNMENT_OPERATORS = [] {
+        using enum lex::token_id;
+        using nodes::bin_op_type;
+
+        token_table<std::optional<bin_op_type>> table {};
+
+        table[static_cast<size_t>(plus_assign)]    = bin_op_type::add;
+        table[static_cast<size_t>(minus_assign)]   = bin_op_type::sub;
+        table[static_cast<size_t>(star_assign)]    = bin_op_type::mul;
+        table[static_cast<size_t>(slash_assign)]   = bin_op_type::div;
+        table[static_cast<size_t>(percent_assign)] = bin_op_type::mod;
+        table[static_cast<size_t>(amp_assign)]     = bin_op_type::b_and;
+        table[static_cast<size_t>(pipe_assign)]    = bin_op_type::b_or;
+        table[static_cast<size_t>(caret_assign)]   = bin_op_type::b_xor;
+
+        return table;
+    }();
+
     const extern std::unordered_map<std::string_view, nodes::bin_op_type> binop_type_map;
     const extern std::unordered_map<std::string_view, nodes::un_op_type> unop_type_map;
     const extern std::unordered_map<std::string_view, nodes::assn_type> assign_type_map;
@@ -1,4 +1,7 @@
 #include "ast_nodes.h"
+
+#include <vector>
+
 #include "../util.h"
 
 using namespace ast::nodes;
@@ -31,32 +34,49 @@ variable_type get_accessor_type(const bin_op &self) {
     if (type.is_intrinsic())
         throw std::runtime_error("Cannot access member of intrinsic type!");
 
-    auto struct_name = std::get<std::string_view>(type.type);
-    auto &struct_decl = ast::struct_types.at(struct_name);
-
     auto as_ref = dynamic_cast<const var_ref*>(self.right.get());
 
     if (!as_ref)
         throw std::runtime_error("Expected variable reference!");
 
-    auto member_name = as_ref->var_name;
-
-    for (const auto &member : struct_decl) {
-        if (member.var_name == member_name)
-            return member.type.pointer_to().change_var_ref(true);
-    }
+    // The validator looks the member up in its struct, and gives the reference the member's type
+    if (!as_ref->type)
+        throw std::runtime_error("Member not found!");
 
-    throw std::runtime_error("Member not found!");
+    return as_ref->type->pointer_to().change_var_ref(true);
 }
 
 variable_type bin_op::get_type() const {
     if (type == bin_op_type::acc)
         return get_accessor_type(*this);
 
-    if (left->get_type().is_intrinsic() && right->get_type().is_intrinsic())
-        return left->get_type();
+    if (result_type)
+        return *result_type;
 
-    throw std::runtime_error("Unimplemented!");
+    // Arithmetic takes the type of its left operand, so a chain such as a + b + c is followed down its left
+    // operands in a loop, then each right operand is checked on the way back up
+    std::vector<const bin_op*> chain { this };
+
+    while (true) {
+        const auto *next = dynamic_cast<const bin_op*>(chain.back()->left.get());
+
+        if (!next || next->type == bin_op_type::acc || next->result_type)
+            break;
+
+        chain.push_back(next);
+    }
+
+    const auto type = chain.back()->left->get_type();
+
+    if (!type.is_intrinsic())
+        throw std::runtime_error("Unimplemented!");
+
+    for (const auto *op : chain) {
+        if (!op->right->get_type().is_intrinsic())
+            throw std::runtime_error("Unimplemented!");
+    }
+
+    return type;
 }
 
 variable_type match::get_type() const {
@@ -68,6 +88,9 @@ variable_type assignment::get_type() const {
 }
 
 variable_type literal::get_type() const {
+    if (suffix)
+        return { *suffix };
+
     switch (value.index()) {
         case UINT:
             return {intrinsic_type::u64 };
@@ -1,19 +1,30 @@
 #include "node_interfaces.h"
-#include <stack>
 #include <iostream>
+#include <utility>
+#include <vector>
 
 using namespace ast;
 
 void nodes::printable::print(const size_t depth) const {
-    std::cout << std::string(depth * 2, ' ') << node_name();
-    if (has_print_details()) {
-        std::cout << " ( ";
-        print_details();
-        std::cout << ")";
-    }
-    std::cout << '\n';
+    // Walked with an explicit stack rather than by recursion, so any depth of nesting can be printed
+    std::vector<std::pair<const printable*, size_t>> pending { { this, depth } };
+
+    while (!pending.empty()) {
+        const auto [node, node_depth] = pending.back();
+        pending.pop_back();
+
+        std::cout << std::string(node_depth * 2, ' ') << node->node_name();
+        if (node->has_print_details()) {
+            std::cout << " ( ";
+            node->print_details();
+            std::cout << ")";
+        }
+        std::cout << '\n';
+
+        // Pushed last to first, so they are printed first to last
+        const auto children = node->children().nodes;
 
-    for (const auto &node : children().nodes) {
-        node->print(depth + 1);
+        for (auto child = children.rbegin(); child != children.rend(); ++child)
+            pending.emplace_back(*child, node_depth + 1);
     }
-}
\ No newline at end of file
+}
@@ -7,6 +7,8 @@
 #include <vector>
 #include <optional>
 
+#include "../../util/arena.h"
+
 #ifdef ENABLE_LLVM
 
 #include <llvm/IR/Value.h>
@@ -69,8 +71,8 @@ namespace ast::nodes {
             return std::move(*this);
         }
 
-        template<typename T>
-        cg_container&& add_i(const std::unique_ptr<T> &node) {
+        template<typename T, typename D>
+        cg_container&& add_i(const std::unique_ptr<T, D> &node) {
             if (node)
                 add(*node);
             return std::move(*this);
@@ -169,6 +171,27 @@ namespace ast::nodes {
         virtual variable_type get_type() const = 0;
     };
 
+    // Frees nothing, since the arena a node was made in destroys it along with everything else in there
+    struct arena_deleter {
+        void operator()(const printable*) const noexcept {}
+    };
+
+    /**
+     *  Node Pointer: Arena-Owned Node Handle
+     *  -------------------------------------
+     *  Holds an expression the way a unique_ptr does, and is moved around the
+     *  same way, but the node itself belongs to the arena make_node put it in.
+     *  Letting go of a handle does nothing; the whole tree is freed in one go
+     *  with its arena, with no recursion however deeply it nests.
+     */
+    template <typename T>
+    using node_ptr = std::unique_ptr<T, arena_deleter>;
+
+    template <typename T, typename... Args>
+    node_ptr<T> make_node(util::arena &arena, Args&&... args) {
+        return node_ptr<T>(arena.make<T>(std::forward<Args>(args)...));
+    }
+
     /**
      *  Statement: Abstract Node Interface
      *  -----------------------------
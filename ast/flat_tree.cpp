@@ -0,0 +1,525 @@
+#include "flat_tree.h"
+
+#include <format>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <typeindex>
+#include <unordered_map>
+
+using namespace ast;
+using namespace ast::flat;
+
+namespace {
+    enum class payload_kind {
+        none, name, literal, op
+    };
+
+    payload_kind payload_of(const node_kind kind, const uint8_t flags) {
+        switch (kind) {
+            case node_kind::struct_declaration:
+            case node_kind::function_prototype:
+            case node_kind::type_instance:
+            case node_kind::method_call:
+            case node_kind::initialization:
+            case node_kind::var_ref:
+            case node_kind::initializer_list:
+            case node_kind::struct_initializer:
+                return payload_kind::name;
+            case node_kind::literal:
+                return payload_kind::literal;
+            case node_kind::un_op:
+            case node_kind::bin_op:
+                return payload_kind::op;
+            case node_kind::assignment:
+                return flags & COMPOUND ? payload_kind::op : payload_kind::none;
+            default:
+                return payload_kind::none;
+        }
+    }
+
+    // Indexed by node_kind
+    constexpr std::string_view KIND_NAMES[] {
+        "empty", "root", "struct_declaration", "function_prototype", "function", "type_instance", "scope_block",
+        "return_op", "if_statement", "loop", "for_loop", "expression_root", "match", "match_case", "method_call",
+        "initialization", "var_ref", "un_op", "bin_op", "assignment", "literal", "cast", "load", "expression_shield",
+        "initializer_list", "array_initializer", "struct_initializer"
+    };
+
+    static_assert(std::size(KIND_NAMES) == static_cast<size_t>(node_kind::struct_initializer) + 1);
+
+    // 64-bit FNV-1a, fed one field at a time so that padding never reaches it
+    struct hasher {
+        uint64_t value = 0xCBF29CE484222325;
+
+        void add_bytes(const void *data, const size_t size) {
+            for (size_t i = 0; i < size; i++) {
+                value ^= static_cast<const uint8_t*>(data)[i];
+                value *= 0x100000001B3;
+            }
+        }
+
+        template <typename T>
+        void add(const T scalar) {
+            static_assert(std::is_scalar_v<T>);
+            add_bytes(&scalar, sizeof(T));
+        }
+
+        void add(const std::string_view text) {
+            add(text.size());
+            add_bytes(text.data(), text.size());
+        }
+    };
+
+    void hash_type(hasher &hash, const nodes::variable_type &type) {
+        hash.add(type.type.index());
+
+        if (const auto *intrinsic = std::get_if<nodes::intrinsic_type>(&type.type))
+            hash.add(*intrinsic);
+        else
+            hash.add(std::get<std::string_view>(type.type));
+
+        hash.add(type.is_var_ref);
+        hash.add(type.is_const);
+        hash.add(type.is_volatile);
+        hash.add(type.array_length);
+        hash.add(type.pointer_depth);
+    }
+
+    // Unlike variable_type's ==, which ignores whether a type is a reference
+    bool same_type(const nodes::variable_type &lhs, const nodes::variable_type &rhs) {
+        return lhs.type == rhs.type && lhs.is_var_ref == rhs.is_var_ref
+            && lhs.is_const == rhs.is_const && lhs.is_volatile == rhs.is_volatile
+            && lhs.array_length == rhs.array_length && lhs.pointer_depth == rhs.pointer_depth;
+    }
+
+    template <typename T>
+    const nodes::printable* node_of(const T &node) {
+        if constexpr (nodes::is_specialization<T, std::unique_ptr>)
+            return node.get();
+        else
+            return &node;
+    }
+
+    // One lookup on the node's dynamic type in place of a dynamic_cast to each type in turn, or empty for a
+    // type that cannot be flattened
+    node_kind kind_of(const nodes::printable &node) {
+        static const std::unordered_map<std::type_index, node_kind> kinds {
+            { typeid(nodes::root), node_kind::root },
+            { typeid(nodes::struct_declaration), node_kind::struct_declaration },
+            { typeid(nodes::function_prototype), node_kind::function_prototype },
+            { typeid(nodes::function), node_kind::function },
+            { typeid(nodes::type_instance), node_kind::type_instance },
+            { typeid(nodes::scope_block), node_kind::scope_block },
+            { typeid(nodes::return_op), node_kind::return_op },
+            { typeid(nodes::if_statement), node_kind::if_statement },
+            { typeid(nodes::loop), node_kind::loop },
+            { typeid(nodes::for_loop), node_kind::for_loop },
+            { typeid(nodes::expression_root), node_kind::expression_root },
+            { typeid(nodes::match), node_kind::match },
+            { typeid(nodes::match_case), node_kind::match_case },
+            { typeid(nodes::method_call), node_kind::method_call },
+            { typeid(nodes::initialization), node_kind::initialization },
+            { typeid(nodes::var_ref), node_kind::var_ref },
+            { typeid(nodes::un_op), node_kind::un_op },
+            { typeid(nodes::bin_op), node_kind::bin_op },
+            { typeid(nodes::assignment), node_kind::assignment },
+            { typeid(nodes::literal), node_kind::literal },
+            { typeid(nodes::cast), node_kind::cast },
+            { typeid(nodes::load), node_kind::load },
+            { typeid(nodes::expression_shield), node_kind::expression_shield },
+            { typeid(nodes::initializer_list), node_kind::initializer_list },
+            { typeid(nodes::array_initializer), node_kind::array_initializer },
+            { typeid(nodes::struct_initializer), node_kind::struct_initializer },
+        };
+
+        const auto kind = kinds.find(typeid(node));
+        return kind != kinds.end() ? kind->second : node_kind::empty;
+    }
+
+    // Appends the node itself, and lists the children still to be flattened below it in order
+    node_id add_node(tree &flat, const nodes::printable *node, std::vector<const nodes::printable*> &children) {
+        const auto add = [&children](const auto &...slots) {
+            (children.push_back(node_of(slots)), ...);
+        };
+
+        const auto add_all = [&children](const auto &list) {
+            for (const auto &slot : list)
+                children.push_back(node_of(slot));
+        };
+
+        const auto type_of = [&flat](const std::optional<nodes::variable_type> &type) {
+            return type ? flat.add_type(*type) : NONE;
+        };
+
+        if (!node)
+            return flat.open(node_kind::empty);
+
+        switch (kind_of(*node)) {
+            case node_kind::root: {
+                const auto *root = static_cast<const nodes::root*>(node);
+                add_all(root->program_level_statements);
+                return flat.open(node_kind::root);
+            }
+
+            case node_kind::struct_declaration: {
+                const auto *decl = static_cast<const nodes::struct_declaration*>(node);
+                add_all(decl->fields);
+                return flat.open(node_kind::struct_declaration, 0, flat.add_name(decl->struct_name));
+            }
+
+            case node_kind::function_prototype: {
+                const auto *prototype = static_cast<const nodes::function_prototype*>(node);
+                add(prototype->implementation);
+                add_all(prototype->params.data);
+
+                return flat.open(node_kind::function_prototype, prototype->params.is_var_args ? VAR_ARGS : 0,
+                                 flat.add_name(prototype->fn_name), flat.add_type(prototype->return_type));
+            }
+
+            case node_kind::function: {
+                const auto *function = static_cast<const nodes::function*>(node);
+                add(function->body);
+                return flat.open(node_kind::function);
+            }
+
+            case node_kind::type_instance: {
+                const auto *instance = static_cast<const nodes::type_instance*>(node);
+                return flat.open(node_kind::type_instance, 0, flat.add_name(instance->var_name), flat.add_type(instance->type));
+            }
+
+            case node_kind::scope_block: {
+                const auto *block = static_cast<const nodes::scope_block*>(node);
+                add_all(block->statements);
+                return flat.open(node_kind::scope_block);
+            }
+
+            case node_kind::return_op: {
+                const auto *return_op = static_cast<const nodes::return_op*>(node);
+                add(return_op->val);
+                return flat.open(node_kind::return_op);
+            }
+
+            case node_kind::if_statement: {
+                const auto *if_stmt = static_cast<const nodes::if_statement*>(node);
+                add(if_stmt->condition, if_stmt->body);
+                children.push_back(if_stmt->else_body ? &*if_stmt->else_body : nullptr);
+
+                return flat.open(node_kind::if_statement);
+            }
+
+            case node_kind::for_loop: {
+                const auto *for_loop = static_cast<const nodes::for_loop*>(node);
+                add(for_loop->init, for_loop->condition, for_loop->update, for_loop->body);
+                return flat.open(node_kind::for_loop);
+            }
+
+            case node_kind::loop: {
+                const auto *loop = static_cast<const nodes::loop*>(node);
+                add(loop->condition, loop->body);
+                return flat.open(node_kind::loop, loop->pre_eval ? PRE_EVAL : 0);
+            }
+
+            case node_kind::expression_root: {
+                const auto *expr = static_cast<const nodes::expression_root*>(node);
+                add(expr->expr);
+                return flat.open(node_kind::expression_root);
+            }
+
+            case node_kind::match: {
+                const auto *match = static_cast<const nodes::match*>(node);
+                add(match->match_expr, match->default_case);
+                add_all(match->cases);
+
+                return flat.open(node_kind::match);
+            }
+
+            case node_kind::match_case: {
+                const auto *match_case = static_cast<const nodes::match_case*>(node);
+                add(match_case->match_expr, match_case->body);
+                return flat.open(node_kind::match_case);
+            }
+
+            case node_kind::method_call: {
+                const auto *call = static_cast<const nodes::method_call*>(node);
+                add_all(call->arguments);
+                return flat.open(node_kind::method_call, 0, flat.add_name(call->method_name), flat.add_type(call->return_type));
+            }
+
+            case node_kind::initialization: {
+                const auto *init = static_cast<const nodes::initialization*>(node);
+                return flat.open(node_kind::initialization, 0,
+                                 flat.add_name(init->instance.var_name), flat.add_type(init->instance.type));
+            }
+
+            case node_kind::var_ref: {
+                const auto *ref = static_cast<const nodes::var_ref*>(node);
+                return flat.open(node_kind::var_ref, 0, flat.add_name(ref->var_name), type_of(ref->type));
+            }
+
+            case node_kind::un_op: {
+                const auto *op = static_cast<const nodes::un_op*>(node);
+                add(op->value);
+                return flat.open(node_kind::un_op, 0, static_cast<uint32_t>(op->type));
+            }
+
+            case node_kind::bin_op: {
+                const auto *op = static_cast<const nodes::bin_op*>(node);
+                add(op->left, op->right);
+                return flat.open(node_kind::bin_op, 0, static_cast<uint32_t>(op->type), type_of(op->result_type));
+            }
+
+            case node_kind::assignment: {
+                const auto *assn = static_cast<const nodes::assignment*>(node);
+                add(assn->lhs, assn->rhs);
+
+                return assn->op ?
+                    flat.open(node_kind::assignment, COMPOUND, static_cast<uint32_t>(*assn->op)) :
+                    flat.open(node_kind::assignment);
+            }
+
+            case node_kind::literal: {
+                const auto *literal = static_cast<const nodes::literal*>(node);
+                return flat.open(node_kind::literal, 0, flat.add_literal({ literal->value, literal->type_size, literal->suffix }));
+            }
+
+            case node_kind::cast: {
+                const auto *cast = static_cast<const nodes::cast*>(node);
+                add(cast->expr);
+                return flat.open(node_kind::cast, 0, NONE, flat.add_type(cast->cast_type));
+            }
+
+            case node_kind::load: {
+                const auto *load = static_cast<const nodes::load*>(node);
+                add(load->expr);
+                return flat.open(node_kind::load);
+            }
+
+            case node_kind::expression_shield: {
+                const auto *shield = static_cast<const nodes::expression_shield*>(node);
+                add(shield->expr);
+                return flat.open(node_kind::expression_shield);
+            }
+
+            case node_kind::initializer_list: {
+                const auto *list = static_cast<const nodes::initializer_list*>(node);
+                add_all(list->values);
+                return flat.open(node_kind::initializer_list, 0, flat.add_name(list->struct_hint));
+            }
+
+            case node_kind::array_initializer: {
+                const auto *array = static_cast<const nodes::array_initializer*>(node);
+                add_all(array->values);
+                return flat.open(node_kind::array_initializer, 0, NONE, flat.add_type(array->array_type));
+            }
+
+            case node_kind::struct_initializer: {
+                const auto *init = static_cast<const nodes::struct_initializer*>(node);
+                add_all(init->values);
+                return flat.open(node_kind::struct_initializer, 0, flat.add_name(init->struct_type));
+            }
+
+            default:
+                break;
+        }
+
+        throw std::runtime_error("Cannot flatten a node of type " + std::string(node->node_name()));
+    }
+}
+
+node_id tree::open(const node_kind kind, const uint8_t flags, const uint32_t payload, const uint32_t type) {
+    const auto id = static_cast<node_id>(kinds.size());
+
+    kinds.push_back(kind);
+    node_flags.push_back(flags);
+    ends.push_back(NONE);
+    payloads.push_back(payload);
+    types_of.push_back(type);
+
+    return id;
+}
+
+void tree::close(const node_id id) {
+    ends[id] = static_cast<node_id>(kinds.size());
+}
+
+uint32_t tree::add_name(const std::string_view name) {
+    const auto [existing, added] = name_ids.emplace(name, static_cast<uint32_t>(names.size()));
+
+    if (added)
+        names.push_back(name);
+
+    return existing->second;
+}
+
+uint32_t tree::add_type(const nodes::variable_type &type) {
+    hasher hash;
+    hash_type(hash, type);
+
+    const auto [first, last] = type_ids.equal_range(hash.value);
+
+    for (auto existing = first; existing != last; ++existing) {
+        if (same_type(types[existing->second], type))
+            return existing->second;
+    }
+
+    const auto id = static_cast<uint32_t>(types.size());
+
+    types.push_back(type);
+    type_ids.emplace(hash.value, id);
+
+    return id;
+}
+
+uint32_t tree::add_literal(literal_data literal) {
+    literals.push_back(std::move(literal));
+    return static_cast<uint32_t>(literals.size() - 1);
+}
+
+uint64_t tree::hash(const node_id id) const {
+    hasher hash;
+
+    for (node_id node = id; node < ends[id]; node++) {
+        hash.add(kinds[node]);
+        hash.add(node_flags[node]);
+
+        // With the nodes in pre-order, the size of each subtree is enough to pin down the shape
+        hash.add(ends[node] - node);
+
+        switch (payload_of(kinds[node], node_flags[node])) {
+            case payload_kind::name:
+                hash.add(names[payloads[node]]);
+                break;
+            case payload_kind::literal: {
+                const auto &[value, type_size, suffix] = literals[payloads[node]];
+
+                hash.add(value.index());
+                std::visit([&hash](const auto &v) { hash.add(v); }, value);
+                hash.add(type_size);
+                hash.add(suffix ? static_cast<int>(*suffix) : -1);
+                break;
+            }
+            case payload_kind::op:
+                hash.add(payloads[node]);
+                break;
+            case payload_kind::none:
+                break;
+        }
+
+        if (const auto *node_type = type(node)) {
+            hash.add(true);
+            hash_type(hash, *node_type);
+        } else {
+            hash.add(false);
+        }
+    }
+
+    return hash.value;
+}
+
+tree tree::subtree(const node_id id) const {
+    tree copy;
+
+    for (node_id node = id; node < ends[id]; node++) {
+        auto payload = payloads[node];
+
+        switch (payload_of(kinds[node], node_flags[node])) {
+            case payload_kind::name:
+                payload = copy.add_name(names[payload]);
+                break;
+            case payload_kind::literal:
+                payload = copy.add_literal(literals[payload]);
+                break;
+            default:
+                break;
+        }
+
+        const auto copied = copy.open(kinds[node], node_flags[node], payload,
+                                      types_of[node] != NONE ? copy.add_type(types[types_of[node]]) : NONE);
+
+        copy.ends[copied] = ends[node] - id;
+    }
+
+    return copy;
+}
+
+tree flat::flatten(const nodes::root &root) {
+    tree flat;
+
+    // The nodes still to be added, and markers for the nodes to close once all of their children are in
+    std::vector<std::pair<const nodes::printable*, node_id>> pending { { &root, NONE } };
+    std::vector<const nodes::printable*> children;
+
+    while (!pending.empty()) {
+        const auto [node, closing] = pending.back();
+        pending.pop_back();
+
+        if (closing != NONE) {
+            flat.close(closing);
+            continue;
+        }
+
+        children.clear();
+        const auto id = add_node(flat, node, children);
+
+        pending.emplace_back(nullptr, id);
+
+        // Pushed last to first, so they are added first to last
+        for (auto child = children.rbegin(); child != children.rend(); ++child)
+            pending.emplace_back(*child, NONE);
+    }
+
+    return flat;
+}
+
+void flat::print(const tree &flat) {
+    // The ends of the subtrees the current node is nested in, innermost last
+    std::vector<node_id> open_ends;
+
+    for (node_id id = 0; id < flat.size(); id++) {
+        while (!open_ends.empty() && open_ends.back() <= id)
+            open_ends.pop_back();
+
+        const auto kind = flat.kind(id);
+        std::string details;
+
+        switch (payload_of(kind, flat.flags(id))) {
+            case payload_kind::name:
+                details = flat.name(id);
+                break;
+            case payload_kind::literal: {
+                const auto &[value, type_size, suffix] = flat.literal(id);
+                details = nodes::literal { value, type_size, suffix }.get_type_name();
+                break;
+            }
+            case payload_kind::op:
+                details = kind == node_kind::un_op ?
+                    pm::find_key(pm::unop_type_map, static_cast<nodes::un_op_type>(flat.payload(id))).value_or("?") :
+                    pm::find_key(pm::binop_type_map, static_cast<nodes::bin_op_type>(flat.payload(id))).value_or("?");
+                break;
+            case payload_kind::none:
+                break;
+        }
+
+        if (kind == node_kind::function_prototype && flat.flags(id) & VAR_ARGS)
+            details += " VAR_ARGS";
+        else if (kind == node_kind::loop && flat.flags(id) & PRE_EVAL)
+            details += "PRE_EVAL";
+
+        std::cout << std::string(open_ends.size() * 2, ' ') << KIND_NAMES[static_cast<size_t>(kind)];
+
+        if (!details.empty())
+            std::cout << " ( " << details << " )";
+
+        if (const auto *type = flat.type(id))
+            std::cout << " : " << type->type_str();
+
+        // Program level statements are disjoint, so hashing each of them reads every node once
+        if (open_ends.size() == 1)
+            std::cout << std::format(" #{:016x}", flat.hash(id));
+
+        std::cout << '\n';
+        open_ends.push_back(flat.end(id));
+    }
+}
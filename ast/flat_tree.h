@@ -0,0 +1,157 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "data/ast_nodes.h"
+
+namespace ast::flat {
+    using node_id = uint32_t;
+
+    // In place of a payload or type a node does not have, such as the type of an unresolved var_ref
+    inline constexpr uint32_t NONE = UINT32_MAX;
+
+    // The children of each kind of node, in order. Optional ones are an empty node when missing, so every
+    // child keeps its position.
+    enum class node_kind : uint8_t {
+        empty,
+
+        root,                   // program level statements...
+        struct_declaration,     // type_instance fields...
+        function_prototype,     // function or empty, initialization params...
+        function,               // scope_block
+        type_instance,
+
+        scope_block,            // statements...
+        return_op,              // value or empty
+        if_statement,           // condition, scope_block, else scope_block or empty
+        loop,                   // condition, scope_block
+        for_loop,               // init, condition, update, scope_block
+        expression_root,        // expression
+
+        match,                  // expression, default scope_block or empty, match_cases...
+        match_case,             // expression, scope_block
+        method_call,            // arguments...
+        initialization,
+        var_ref,
+        un_op,                  // value
+        bin_op,                 // left, right
+        assignment,             // lhs, rhs
+        literal,
+        cast,                   // value
+        load,                   // value
+        expression_shield,      // value
+        initializer_list,       // values...
+        array_initializer,      // values...
+        struct_initializer,     // values...
+    };
+
+    // Flags, whose meaning depends on the kind of node
+    inline constexpr uint8_t VAR_ARGS = 1; // function_prototype: takes variadic arguments
+    inline constexpr uint8_t PRE_EVAL = 1; // loop: checks its condition before the first iteration
+    inline constexpr uint8_t COMPOUND = 1; // assignment: its payload is the operator applied, as in +=
+
+    struct literal_data {
+        nodes::literal::lit_variant value;
+        uint8_t type_size;
+        std::optional<nodes::intrinsic_type> suffix;
+    };
+
+    /**
+     *  Tree: Flat Index-Based AST
+     *  --------------------------
+     *  The same tree as a nodes::root, held as parallel arrays indexed by a
+     *  32-bit node_id instead of as objects linked by pointers. Nodes are laid
+     *  out in pre-order, so the children of a node directly follow it, every
+     *  subtree is one contiguous range of ids, and end(id) is one past the last
+     *  node of the subtree at id. A pass over the whole tree is then a scan of
+     *  dense arrays, and a subtree can be hashed or copied as a range.
+     *
+     *  A node is its kind, its flags, its end, a payload and a type: fourteen
+     *  bytes. The payload is an index into names for a named node, an index
+     *  into literals for a literal, or the operator of an un_op, bin_op or
+     *  compound assignment. The type is an index into types, which holds each
+     *  distinct type once: the type of an initialization, type_instance or
+     *  var_ref, the return type of a method_call or function_prototype, the
+     *  target of a cast or array_initializer, or a bin_op's validated type.
+     *
+     *  Names and string literals are views into the source code, which has to
+     *  outlive the tree just as it does the nodes::root the tree came from.
+     */
+    class tree {
+    public:
+        struct child_iterator {
+            const tree *owner;
+            node_id id;
+
+            node_id operator*() const { return id; }
+            child_iterator& operator++() { id = owner->ends[id]; return *this; }
+
+            friend bool operator==(const child_iterator lhs, const child_iterator rhs) { return lhs.id == rhs.id; }
+        };
+
+        struct child_range {
+            child_iterator first, last;
+
+            child_iterator begin() const { return first; }
+            child_iterator end() const { return last; }
+        };
+
+        size_t size() const { return kinds.size(); }
+
+        node_kind kind(const node_id id) const { return kinds[id]; }
+        uint8_t flags(const node_id id) const { return node_flags[id]; }
+        node_id end(const node_id id) const { return ends[id]; }
+        uint32_t payload(const node_id id) const { return payloads[id]; }
+
+        child_range children(const node_id id) const {
+            return { { this, id + 1 }, { this, ends[id] } };
+        }
+
+        std::string_view name(const node_id id) const { return names[payloads[id]]; }
+        const literal_data& literal(const node_id id) const { return literals[payloads[id]]; }
+
+        // The node's type, or nullptr if it has none
+        const nodes::variable_type* type(const node_id id) const {
+            return types_of[id] != NONE ? &types[types_of[id]] : nullptr;
+        }
+
+        // A hash of the subtree's structure and contents, equal for equal subtrees of any two trees
+        uint64_t hash(node_id id) const;
+
+        // A tree of its own holding a copy of the subtree at id, with only the names, types and literals it uses
+        tree subtree(node_id id) const;
+
+        // Appends a node, whose subtree holds every node appended until it is closed
+        node_id open(node_kind kind, uint8_t flags = 0, uint32_t payload = NONE, uint32_t type = NONE);
+        void close(node_id id);
+
+        uint32_t add_name(std::string_view name);
+        uint32_t add_type(const nodes::variable_type &type);
+        uint32_t add_literal(literal_data literal);
+
+    private:
+        std::vector<node_kind> kinds;
+        std::vector<uint8_t> node_flags;
+        std::vector<node_id> ends;
+        std::vector<uint32_t> payloads;
+        std::vector<uint32_t> types_of;
+
+        std::vector<std::string_view> names;
+        std::vector<nodes::variable_type> types;
+        std::vector<literal_data> literals;
+
+        std::unordered_map<std::string_view, uint32_t> name_ids;
+        std::unordered_multimap<uint64_t, uint32_t> type_ids;
+    };
+
+    // Flattens a whole tree. Bodies a lazy parse has not reached yet are left empty.
+    tree flatten(const nodes::root &root);
+
+    // Prints one line per node, indented by depth like nodes::printable::print, with the hash of each program
+    // level statement, so statements with the same contents print the same hash
+    void print(const tree &flat);
+}
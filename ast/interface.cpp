@@ -2,28 +2,148 @@
 #include "data/ast_nodes.h"
 #include "parser_methods/program.h"
 #include "parser_methods/expression.h"
+#include "precompiled.h"
+#include "lazy_state.h"
+#include "validator/validator.hpp"
+#include "../lexer/lex_stream.h"
+
+#include <future>
 
 using namespace ast;
 
-nodes::root ast::parse(const std::vector<lex::lex_token> &tokens) {
+void load_interfaces(parser_context &ctx, nodes::root &root, const std::span<const std::string_view> interfaces) {
+    for (const auto blob : interfaces)
+        pci::load(blob, root, ctx);
+}
+
+void parse_into(parser_context &ctx, nodes::root &root, const lex::token_stream &tokens) {
+    auto ptr = tokens.begin();
+    const auto end = tokens.end();
+
+    while (ptr < end) {
+        if (auto stmt = pm::parse_program_level_stmt(ctx, ptr, end); stmt != nullptr)
+            root.program_level_statements.emplace_back(std::move(stmt));
+    }
+}
+
+size_t body_size(const parser_context::deferred_body &body) {
+    return body.start.closer()->index - body.start.index;
+}
+
+void parse_body(const parser_context &outer, const parser_context::deferred_body &body, util::arena &arena) {
+    parser_context ctx { .arena = &arena, .outer = &outer };
+
+    auto ptr = body.start;
+    const auto end = *body.start.closer() + 1;
+
+    body.prototype->implementation = std::make_unique<nodes::function>(
+        pm::parse_function(ctx, ptr, end, body.prototype)
+    );
+}
+
+void parse_bodies(const parser_context &ctx, util::arena &arena, util::thread_pool &pool) {
+    const auto &bodies = ctx.deferred_bodies;
+    size_t total = 0;
+
+    for (const auto &body : bodies)
+        total += body_size(body);
+
+    if (pool.size() <= 1 || total < PARALLEL_PARSE_THRESHOLD) {
+        for (const auto &body : bodies)
+            parse_body(ctx, body, arena);
+
+        return;
+    }
+
+    // A few chunks of neighbouring bodies per worker, so stealing can even out bodies of very different sizes.
+    // Each fills an arena of its own, which the root's adopts once they are all done.
+    const auto chunk_size = total / (pool.size() * 4) + 1;
+    std::vector<std::future<util::arena>> chunks;
+
+    for (size_t first = 0, last = 0; first < bodies.size(); first = last) {
+        size_t size = 0;
+
+        while (last < bodies.size() && size < chunk_size)
+            size += body_size(bodies[last++]);
+
+        chunks.emplace_back(pool.submit([&ctx, &bodies, first, last] {
+            util::arena chunk_arena;
+
+            for (size_t i = first; i < last; i++)
+                parse_body(ctx, bodies[i], chunk_arena);
+
+            return chunk_arena;
+        }));
+    }
+
+    // The chunks point into ctx and the tokens, so every one has to finish before any error leaves,
+    // and the error of the earliest chunk is the first in the file
+    for (const auto &chunk : chunks)
+        pool.wait(chunk);
+
+    for (auto &chunk : chunks)
+        arena.adopt(chunk.get());
+}
+
+nodes::root ast::parse(const lex::token_stream &tokens, const std::span<const std::string_view> interfaces,
+                       util::thread_pool &pool) {
     nodes::root root {};
+    parser_context ctx { .arena = root.arena.get(), .defer_bodies = true };
+
+    load_interfaces(ctx, root, interfaces);
+    parse_into(ctx, root, tokens);
+    parse_bodies(ctx, *root.arena, pool);
 
-    scope_stack.clear();
-    scope_stack.emplace_back();
+    return root;
+}
 
-    struct_types.clear();
+nodes::root ast::parse_lazy(const lex::token_stream &tokens, const std::span<const std::string_view> interfaces) {
+    nodes::root root {};
+    auto state = std::make_shared<lazy_state>(lazy_state { .parser = { .arena = root.arena.get(), .defer_bodies = true } });
+    auto &ctx = state->parser;
 
-    function_prototypes.clear();
-    unfinished_method_calls.clear();
-    current_function = nullptr;
+    load_interfaces(ctx, root, interfaces);
+    parse_into(ctx, root, tokens);
 
-    auto ptr = tokens.cbegin();
-    const auto end = tokens.cend();
+    for (const auto &[prototype, start] : ctx.deferred_bodies)
+        prototype->lazy = { start, state.get() };
 
-    while (ptr < end) {
-        if (auto stmt = pm::parse_program_level_stmt(ptr, end); stmt != nullptr)
-            root.program_level_statements.emplace_back(std::move(stmt));
+    ctx.deferred_bodies.clear();
+    root.lazy_context = std::move(state);
+
+    return root;
+}
+
+const nodes::function* nodes::function_prototype::get_implementation() const {
+    if (!lazy)
+        return implementation.get();
+
+    const auto [start, state] = *lazy;
+
+    parser_context ctx { .arena = state->parser.arena, .outer = &state->parser };
+    auto ptr = start;
+
+    // Left as a lazy body until it has parsed and validated, so a body with an error reports it every time
+    try {
+        implementation = std::make_unique<function>(pm::parse_function(ctx, ptr, *start.closer() + 1, this));
+        val::validate_lazy_body(this, state->validated);
+    } catch (...) {
+        implementation.reset();
+        throw;
     }
 
+    lazy.reset();
+    return implementation.get();
+}
+
+nodes::root ast::parse(lex::lex_stream &stream, const std::span<const std::string_view> interfaces) {
+    nodes::root root {};
+    parser_context ctx { .arena = root.arena.get() };
+
+    load_interfaces(ctx, root, interfaces);
+
+    while (auto declaration = stream.next())
+        parse_into(ctx, root, *declaration);
+
     return root;
-}
\ No newline at end of file
+}
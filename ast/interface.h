@@ -1,13 +1,51 @@
 #pragma once
 
+#include <span>
+#include <string_view>
 #include <vector>
 #include "util.h"
 #include "data/ast_nodes.h"
+#include "../util/thread_pool.h"
 
 namespace lex {
-    struct lex_token;
+    struct token_stream;
+    class lex_stream;
 }
 
 namespace ast {
-    nodes::root parse(const std::vector<lex::lex_token> &tokens);
+    // Below this many tokens of function bodies, a file's bodies are parsed faster on one core
+    inline constexpr size_t PARALLEL_PARSE_THRESHOLD = 1 << 16;
+
+    /**
+     *  Parse: Two-Pass Parse of a Token Stream
+     *  ---------------------------------------
+     *  The first pass parses every declaration, and skips each braced function
+     *  body by its closer. The bodies are parsed in a second pass, which spreads
+     *  them over the pool once there are enough of them, since no body depends
+     *  on another. Bodies therefore see every struct in the file. The error
+     *  reported is the first in the file, as with a sequential parse.
+     *
+     *  Interfaces are precompiled interface blobs, whose declarations come before
+     *  everything parsed. Each call parses with its own parser_context, so
+     *  separate calls may run concurrently.
+     */
+    nodes::root parse(const lex::token_stream &tokens, std::span<const std::string_view> interfaces = {},
+                      util::thread_pool &pool = util::thread_pool::shared());
+
+    /**
+     *  Parse Lazy: Declarations Now, Bodies on Demand
+     *  ----------------------------------------------
+     *  Parses like parse(), except that function bodies are left as tokens on
+     *  their prototypes rather than parsed, so a body codegen never reaches is
+     *  never parsed or validated. get_implementation() parses and validates a
+     *  body the first time it is called, against the declarations the root
+     *  keeps, so the root has to be validated before any body is asked for. A
+     *  body that fails stays unparsed, and fails again on the next call. The
+     *  tokens have to outlive the root.
+     */
+    nodes::root parse_lazy(const lex::token_stream &tokens, std::span<const std::string_view> interfaces = {});
+
+    // Parses declarations as the stream produces them, overlapping parsing with lexing. Bodies are parsed
+    // in place, since only a window of the stream's tokens is alive at a time.
+    nodes::root parse(lex::lex_stream &stream, std::span<const std::string_view> interfaces = {});
 }
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "parser_context.h"
+#include "validator/validator.hpp"
+
+namespace ast {
+    /**
+     *  Lazy State: What Lazy Bodies Are Checked Against
+     *  ------------------------------------------------
+     *  Everything a body left as tokens by parse_lazy needs once it is finally
+     *  parsed: the parser's declarations of its file, and the validator's once
+     *  validate() has run on the root. Owned by the root, so a body is always
+     *  parsed and validated against its own root, whatever else has been
+     *  parsed or validated since.
+     */
+    struct lazy_state {
+        parser_context parser;
+        val::declarations validated;
+    };
+}
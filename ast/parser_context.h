@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "data/abstract_data.h"
+#include "../lexer/lex.h"
+
+namespace ast::nodes {
+    struct struct_declaration;
+    struct function_prototype;
+}
+
+namespace ast {
+    /**
+     *  Parser Context: State of a Single Parse
+     *  ---------------------------------------
+     *  Everything the parser learns while it works through a file: the
+     *  variables in scope, and the structs and functions declared so far. Each
+     *  call to ast::parse makes its own and passes it through every pm::
+     *  function, so the parser holds no state outside of it.
+     *
+     *  Thread safety: a context is unsynchronized and must only be used by one
+     *  thread at a time. Parses with separate contexts share nothing mutable,
+     *  so any number of them may run concurrently in one process. The
+     *  declarations it points to are owned by the root being parsed into.
+     *
+     *  A function body parsed apart from its file gets a context of its own,
+     *  whose outer context is the file's. Any number of bodies may read the
+     *  same outer context at once, as long as nothing writes to it meanwhile.
+     */
+    struct parser_context {
+        struct deferred_body {
+            nodes::function_prototype *prototype;
+            lex::token_cursor start; // The body's opening brace
+        };
+
+        std::vector<std::unordered_map<std::string_view, nodes::variable_type>> scope_stack =
+            std::vector<std::unordered_map<std::string_view, nodes::variable_type>>(1);
+
+        std::unordered_map<std::string_view, const nodes::struct_declaration*> struct_types;
+        std::unordered_map<std::string_view, nodes::function_prototype*> function_prototypes;
+
+        const nodes::function_prototype *current_function = nullptr;
+
+        // Where the expressions parsed are allocated, normally the arena of the root being parsed into
+        util::arena *arena = nullptr;
+
+        // The context of the file a body being parsed on its own belongs to, for its declarations
+        const parser_context *outer = nullptr;
+
+        // When set, braced function bodies are skipped over by their closers and collected here to
+        // be parsed afterwards, once every declaration in the file is known
+        bool defer_bodies = false;
+        std::vector<deferred_body> deferred_bodies;
+
+        // An operator pm::parse_expr_tree has read but not yet applied, or a parenthesized group it is in
+        struct pending_operator {
+            enum class kind_t : uint8_t { unary, binary, assignment, group };
+
+            kind_t kind;
+            lex::token_cursor token;     // The operator, or the group's opening parenthesis
+            lex::token_cursor outer_end; // For a group, where the expression around it ends
+        };
+
+        // Scratch stacks for pm::parse_expr_tree, kept here so their storage is reused from one
+        // expression to the next. An expression nested inside another, such as a call argument,
+        // works above the part of the stacks its enclosing expression is using.
+        std::vector<nodes::node_ptr<nodes::expression>> operand_stack;
+        std::vector<pending_operator> operator_stack;
+
+        // The type of the innermost variable in scope with the given name
+        std::optional<nodes::variable_type> get_var_type(std::string_view var_name) const;
+
+        // The struct with the given name, declared in this context or its outer one
+        const nodes::struct_declaration* find_struct(std::string_view name) const;
+    };
+}
@@ -6,20 +6,22 @@
 
 using namespace ast;
 
-std::vector<nodes::type_instance> pm::parse_split_type_inst(lex_cptr &ptr, const lex_cptr end) {
-    return parse_split(ptr, end, ",", pm::parse_type_instance);
+std::vector<nodes::type_instance> pm::parse_split_type_inst(parser_context &ctx, lex_cptr &ptr, const lex_cptr end) {
+    return parse_split(ctx, ptr, end, lex::token_id::comma, pm::parse_type_instance);
 }
 
-std::unique_ptr<nodes::struct_declaration> pm::parse_struct_decl(lex_cptr &ptr, const lex_cptr end) {
-    assert_token_val(ptr, "struct");
+std::unique_ptr<nodes::struct_declaration> pm::parse_struct_decl(parser_context &ctx, lex_cptr &ptr, const lex_cptr end) {
+    assert_token_id(ptr, lex::token_id::struct_);
 
-    scope_stack.emplace_back();
+    ctx.scope_stack.emplace_back();
 
     auto name = assert_token_type(ptr, lex::lex_type::IDENTIFIER)->span;
-    auto types = parse_between(ptr, "{", parse_split_type_inst);
+    auto types = parse_between(ctx, ptr, lex::token_id::l_brace, parse_split_type_inst);
 
-    struct_types.emplace(name, types);
-    scope_stack.pop_back();
+    ctx.scope_stack.pop_back();
 
-    return std::make_unique<nodes::struct_declaration>(name, std::move(types));
+    auto decl = std::make_unique<nodes::struct_declaration>(name, std::move(types));
+    ctx.struct_types.emplace(name, decl.get());
+
+    return decl;
 }
\ No newline at end of file
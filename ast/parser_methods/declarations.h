@@ -4,6 +4,6 @@
 #include "../util.h"
 
 namespace ast::pm {
-    std::unique_ptr<nodes::struct_declaration> parse_struct_decl(lex_cptr &ptr, const lex_cptr end);
-    std::vector<nodes::type_instance> parse_split_type_inst(lex_cptr &ptr, const lex_cptr end);
+    std::unique_ptr<nodes::struct_declaration> parse_struct_decl(parser_context &ctx, lex_cptr &ptr, const lex_cptr end);
+    std::vector<nodes::type_instance> parse_split_type_inst(parser_context &ctx, lex_cptr &ptr, const lex_cptr end);
 }
@@ -1,14 +1,12 @@
 #include "expression.h"
 
 #include <memory>
-#include <stack>
 #include <stdexcept>
 
-#include <charconv>
-
 #include "operator.h"
 #include "statement.h"
 #include "../../lexer/lex.h"
+#include "../../lexer/source_location.h"
 #include "../util.h"
 #include "program.h"
 #include "../data/data_maps.h"
@@ -16,156 +14,233 @@
 using namespace ast;
 using namespace ast::pm;
 
-std::unique_ptr<nodes::expression> pm::parse_expression(lex_cptr &ptr, const lex_cptr end) {
-    if (auto un_op = find_element(unop_type_map,ptr->span))
-        return parse_unop(ptr, end);
+nodes::node_ptr<nodes::expression> pm::parse_expression(parser_context &ctx, lex_cptr &ptr, const lex_cptr end) {
+    if (UNARY_OPERATORS[static_cast<size_t>(ptr.id())])
+        return parse_unop(ctx, ptr, end);
 
-    if (auto literal = parse_literal(ptr, end))
-        return std::make_unique<nodes::literal>(std::move(literal.value()));
+    if (peek(ptr, end)->id == lex::token_id::l_paren)
+        return parse_between(ctx, ptr, parse_expr_tree);
 
-    if (peek(ptr, end)->span == "(")
-        return parse_between(ptr, parse_expr_tree);
+    return parse_primary(ctx, ptr, end);
+}
+
+nodes::node_ptr<nodes::expression> pm::parse_primary(parser_context &ctx, lex_cptr &ptr, const lex_cptr end) {
+    if (auto literal = parse_literal(ptr, end))
+        return nodes::make_node<nodes::literal>(*ctx.arena, std::move(literal.value()));
 
-    if (peek(ptr, end)->span == "{")
-        return std::make_unique<nodes::initializer_list>(parse_initializer_list(ptr, end));
+    if (peek(ptr, end)->id == lex::token_id::l_brace)
+        return nodes::make_node<nodes::initializer_list>(*ctx.arena, parse_initializer_list(ctx, ptr, end));
 
-    if (peek(ptr, end)->span == "match")
-        return std::make_unique<nodes::match>(parse_match(ptr, end));
+    if (peek(ptr, end)->id == lex::token_id::match)
+        return nodes::make_node<nodes::match>(*ctx.arena, parse_match(ctx, ptr, end));
 
-    if (is_variable_identifier(ptr))
-        return std::make_unique<nodes::initialization>(parse_initialization(ptr, end));
+    if (is_variable_identifier(ctx, ptr))
+        return nodes::make_node<nodes::initialization>(*ctx.arena, parse_initialization(ctx, ptr, end));
 
-    if (try_peek_type(ptr, end, lex::lex_type::IDENTIFIER) && try_peek_val(ptr, end, "(", 1))
-        return parse_method_call(ptr, end);
+    if (try_peek_type(ptr, end, lex::lex_type::IDENTIFIER) && try_peek_id(ptr, end, lex::token_id::l_paren, 1))
+        return parse_method_call(ctx, ptr, end);
 
-    if (try_peek_type(ptr, end, lex::lex_type::IDENTIFIER) && try_peek_val(ptr, end, "[", 1))
-        return std::make_unique<nodes::bin_op>(parse_array_access(ptr, end));
+    if (try_peek_type(ptr, end, lex::lex_type::IDENTIFIER) && try_peek_id(ptr, end, lex::token_id::l_bracket, 1))
+        return nodes::make_node<nodes::bin_op>(*ctx.arena, parse_array_access(ctx, ptr, end));
 
     if (try_peek_type(ptr, end, lex::lex_type::IDENTIFIER))
-        return std::make_unique<nodes::var_ref>(parse_variable(ptr, end));
+        return nodes::make_node<nodes::var_ref>(*ctx.arena, parse_variable(ctx, ptr, end));
 
     return nullptr;
 }
 
-std::unique_ptr<nodes::expression> pm::parse_expr_tree(lex_cptr &ptr, const lex_cptr end) {
-    std::stack<std::unique_ptr<nodes::expression>> expr_stack;
-    std::stack<nodes::bin_op_type> binop_stack;
-
-    const auto combine_back = [&expr_stack, &binop_stack] {
-        nodes::bin_op_type top_op = binop_stack.top();
-        binop_stack.pop();
-        std::unique_ptr<nodes::expression> r_expr = std::move(expr_stack.top());
-        expr_stack.pop();
-        std::unique_ptr<nodes::expression> l_expr = std::move(expr_stack.top());
-        expr_stack.pop();
-
-        expr_stack.emplace(
-        std::make_unique<nodes::bin_op>(
-               top_op,
-                std::move(l_expr),
-                std::move(r_expr)
-            )
-        );
+namespace {
+    using pending_operator = parser_context::pending_operator;
+    using kind_t = pending_operator::kind_t;
+
+    // Leaves the scratch stacks as an expression found them, even when it fails to parse
+    struct stack_guard {
+        parser_context &ctx;
+        size_t operands, operators;
+
+        ~stack_guard() {
+            ctx.operand_stack.resize(operands);
+            ctx.operator_stack.resize(operators);
+        }
     };
 
-    expr_stack.emplace(parse_expression(ptr, end));
+    // Applies the operator on top of the stack to the operands on top of theirs
+    void reduce(parser_context &ctx) {
+        auto &operands = ctx.operand_stack;
+        const auto op = ctx.operator_stack.back();
+        const auto index = static_cast<size_t>(op.token.id());
 
-    while (ptr < end) {
-        if (peek(ptr, end)->type == lex::lex_type::ASSN_SYMBOL) {
-            auto assn_type = parse_assn(end, ptr);
-            auto lhs = std::move(expr_stack.top());
-            auto rhs = parse_expr_tree(ptr, end);
+        ctx.operator_stack.pop_back();
 
-            expr_stack.pop();
+        auto rhs = std::move(operands.back());
+        operands.pop_back();
 
-            return std::make_unique<nodes::assignment>(
-                std::move(lhs),
-                std::move(rhs),
-                assn_type
-            );
+        if (op.kind == kind_t::unary) {
+            if (!rhs)
+                throw lex::source_error("Expected value after operator", op.token->span);
+
+            operands.push_back(nodes::make_node<nodes::un_op>(*ctx.arena, *UNARY_OPERATORS[index], std::move(rhs)));
+            return;
         }
 
-        auto bin_op = parse_binop(ptr, end);
+        auto lhs = std::move(operands.back());
 
-        if (bin_op == std::nullopt)
-            break;
-
-        while (!binop_stack.empty() && *find_element(binop_prec, *bin_op) <= *find_element(binop_prec, binop_stack.top()))
-            combine_back();
+        if (op.kind == kind_t::assignment)
+            operands.back() = nodes::make_node<nodes::assignment>(*ctx.arena, std::move(lhs), std::move(rhs), ASSIGNMENT_OPERATORS[index]);
+        else
+            operands.back() = nodes::make_node<nodes::bin_op>(*ctx.arena, BINARY_OPERATORS[index].type, std::move(lhs), std::move(rhs));
+    }
 
-        expr_stack.emplace(parse_expression(ptr, end));
-        binop_stack.emplace(*bin_op);
+    // Reduces operators down to, but not including, the first that is not of the given kind
+    void reduce_all(parser_context &ctx, const size_t base, const kind_t kind) {
+        while (ctx.operator_stack.size() > base && ctx.operator_stack.back().kind == kind)
+            reduce(ctx);
     }
+}
+
+/*
+ *  Operator precedence parsing with explicit operand and operator stacks, so
+ *  neither long chains like a = b = c nor deeply parenthesized arithmetic
+ *  cost any native stack.
+ */
+nodes::node_ptr<nodes::expression> pm::parse_expr_tree(parser_context &ctx, lex_cptr &ptr, const lex_cptr end) {
+    auto &operands = ctx.operand_stack;
+    auto &operators = ctx.operator_stack;
+
+    const stack_guard guard { ctx, operands.size(), operators.size() };
+    const auto base = operators.size();
+
+    // Where the innermost open group ends, or the whole expression when none is open
+    auto group_end = end;
+    size_t open_groups = 0;
+
+    while (true) {
+        // Prefix operators and opening parentheses, up to the operand itself
+        while (ptr < group_end) {
+            if (UNARY_OPERATORS[static_cast<size_t>(ptr.id())]) {
+                operators.push_back({ kind_t::unary, ptr++ });
+            } else if (ptr.id() == lex::token_id::l_paren) {
+                const auto closer = ptr.closer();
+
+                if (!closer)
+                    raise({ parse_error_kind::no_closer, ptr->span });
+
+                operators.push_back({ kind_t::group, ptr++, group_end });
+                group_end = *closer;
+                open_groups++;
+            } else {
+                break;
+            }
+        }
+
+        operands.push_back(parse_primary(ctx, ptr, group_end));
+        reduce_all(ctx, base, kind_t::unary);
+
+        // Infix operators, closing groups as their ends are reached
+        while (true) {
+            const bool more = ptr < group_end;
+
+            if (more && ptr.type() == lex::lex_type::ASSN_SYMBOL) {
+                // Assignment is right-associative, so earlier assignments wait for this one's value
+                reduce_all(ctx, base, kind_t::binary);
+                operators.push_back({ kind_t::assignment, ptr++ });
+                break;
+            }
+
+            if (const auto precedence = more ? BINARY_OPERATORS[static_cast<size_t>(ptr.id())].precedence : 0; precedence != 0) {
+                while (operators.size() > base && operators.back().kind == kind_t::binary &&
+                       BINARY_OPERATORS[static_cast<size_t>(operators.back().token.id())].precedence >= precedence)
+                    reduce(ctx);
 
-    while (!binop_stack.empty())
-        combine_back();
+                operators.push_back({ kind_t::binary, ptr++ });
+                break;
+            }
 
-    return std::move(expr_stack.top());
+            if (!open_groups) {
+                while (operators.size() > base)
+                    reduce(ctx);
+
+                // The symbol which ended the expression, such as a ';', belongs to it
+                if (ptr < end && ptr.type() == lex::lex_type::EXPR_SYMBOL)
+                    ++ptr;
+
+                auto expr = std::move(operands.back());
+                operands.pop_back();
+
+                return expr;
+            }
+
+            // Anything left before the closing parenthesis is not part of the group
+            while (operators.back().kind != kind_t::group)
+                reduce(ctx);
+
+            ptr = group_end + 1;
+            group_end = operators.back().outer_end;
+            operators.pop_back();
+            open_groups--;
+
+            reduce_all(ctx, base, kind_t::unary);
+        }
+    }
 }
 
-std::unique_ptr<nodes::expression> pm::parse_unop(lex_cptr &ptr, const lex_cptr end) {
-    const auto operator_type = assert_token_type(ptr, lex::lex_type::EXPR_SYMBOL)->span;
-    auto expr = parse_expression(ptr, end);
+nodes::node_ptr<nodes::expression> pm::parse_unop(parser_context &ctx, lex_cptr &ptr, const lex_cptr end) {
+    const auto op = assert_token_type(ptr, lex::lex_type::EXPR_SYMBOL);
+    auto expr = parse_expression(ctx, ptr, end);
 
     if (!expr)
-        throw std::runtime_error("Expected value after operator");
-
-    auto unop = *find_element(unop_type_map, operator_type);
+        throw lex::source_error("Expected value after operator", op->span);
 
-    return std::make_unique<nodes::un_op>(
-            unop,
+    return nodes::make_node<nodes::un_op>(
+            *ctx.arena,
+            *UNARY_OPERATORS[static_cast<size_t>(op.id())],
             std::move(expr)
     );
 }
 
-std::optional<nodes::bin_op_type> pm::parse_binop(lex_cptr &ptr, const lex_cptr) {
-    auto op = test_token_type(ptr, lex::lex_type::EXPR_SYMBOL);
+std::optional<nodes::literal> pm::parse_literal(lex_cptr &ptr, const lex_cptr end) {
+    const auto token = peek(ptr, end);
 
-    if (!op)
+    if (!lex::is_literal(token->type))
         return std::nullopt;
 
-    return find_element(binop_type_map,(*op)->span);
-}
+    consume(ptr, end);
 
-std::optional<nodes::bin_op_type> pm::parse_assn(const ast::lex_cptr, ast::lex_cptr &ptr) {
-    auto type = assert_token_type(ptr, lex::lex_type::ASSN_SYMBOL)->span;
+    if (token->type == lex::lex_type::STRING_LITERAL)
+        return nodes::literal { token.string_value() };
 
-    if (type.size() == 1)
-        return std::nullopt;
+    // Every other literal was decoded by the lexer
+    const auto &[value, suffix] = *token.literal();
+    const auto suffix_type = suffix != lex::token_id::none ?
+        find_element(intrin_map, lex::spelling(suffix)) :
+        std::nullopt;
 
-    auto op = type.substr(0, 1);
-    auto bin_op = find_element(binop_type_map, op);
+    if (const auto *c = std::get_if<char>(&value))
+        return nodes::literal { *c };
 
-    if (!bin_op)
-        throw std::runtime_error("Invalid assignment operator");
+    if (const auto *d = std::get_if<double>(&value))
+        return nodes::literal { *d, suffix_type ? lex::primitive_bits(suffix) : uint8_t { 32 }, suffix_type };
 
-    return bin_op;
-}
+    const auto integer = std::get<uint64_t>(value);
 
-std::optional<nodes::literal> pm::parse_literal(lex_cptr &ptr, const lex_cptr end) {
-    int i = 0;
-    double d = 0;
-
-    switch (peek(ptr, end)->type) {
-        case lex::lex_type::INT_LITERAL:
-            std::from_chars(peek(ptr, end)->span.data(), peek(ptr, end)->span.data() + peek(ptr, end)->span.size(), i);
-            consume(ptr, end);
-            return nodes::literal { i };
-        case lex::lex_type::FLOAT_LITERAL:
-            std::from_chars(peek(ptr, end)->span.data(), peek(ptr, end)->span.data() + peek(ptr, end)->span.size(), d);
-            consume(ptr, end);
-            return nodes::literal { d };
-        case lex::lex_type::STRING_LITERAL:
-            return nodes::literal { consume(ptr, end)->span };
-        case lex::lex_type::CHAR_LITERAL:
-            return nodes::literal { consume(ptr, end)->span.front() };
-        default:
-            return std::nullopt;
+    if (suffix_type) {
+        const auto bits = lex::primitive_bits(suffix);
+
+        if (suffix >= lex::token_id::u8)
+            return nodes::literal { integer, bits, suffix_type };
+
+        return nodes::literal { static_cast<int64_t>(integer), bits, suffix_type };
     }
+
+    // Unsuffixed literals stay 32 bits wide unless their value needs more
+    if (integer > INT64_MAX)
+        return nodes::literal { integer, 64 };
+
+    return nodes::literal { static_cast<int64_t>(integer), static_cast<uint8_t>(integer > INT32_MAX ? 64 : 32) };
 }
 
-nodes::type_instance pm::parse_type_instance(lex_cptr &ptr, const lex_cptr end) {
-    if (test_token_val(ptr, "...")) {
+nodes::type_instance pm::parse_type_instance(parser_context &ctx, lex_cptr &ptr, const lex_cptr end) {
+    if (test_token_id(ptr, lex::token_id::ellipsis)) {
         return nodes::type_instance {
             nodes::variable_type {
                 nodes::intrinsic_type::infer_type,
@@ -174,7 +249,7 @@ nodes::type_instance pm::parse_type_instance(lex_cptr &ptr, const lex_cptr end)
         };
     }
 
-    auto val_type = pm::parse_var_type(ptr, end);
+    auto val_type = pm::parse_var_type(ctx, ptr, end);
     auto type = test_token_type(ptr, lex::lex_type::IDENTIFIER);
 
     return nodes::type_instance {
@@ -183,11 +258,12 @@ nodes::type_instance pm::parse_type_instance(lex_cptr &ptr, const lex_cptr end)
     };
 }
 
-std::unique_ptr<nodes::method_call> pm::parse_method_call(lex_cptr &ptr, const lex_cptr end) {
+nodes::node_ptr<nodes::method_call> pm::parse_method_call(parser_context &ctx, lex_cptr &ptr, const lex_cptr end) {
     auto method_name = consume(ptr, end)->span;
-    auto expr_list = parse_between(ptr, "(", parse_expression_list);
+    auto expr_list = parse_between(ctx, ptr, lex::token_id::l_paren, parse_expression_list);
 
-    auto call = std::make_unique<nodes::method_call>(
+    auto call = nodes::make_node<nodes::method_call>(
+            *ctx.arena,
             method_name,
             std::move(expr_list)
     );
@@ -195,23 +271,24 @@ std::unique_ptr<nodes::method_call> pm::parse_method_call(lex_cptr &ptr, const l
     return call;
 }
 
-nodes::bin_op pm::parse_array_access(lex_cptr &ptr, const lex_cptr end) {
+nodes::bin_op pm::parse_array_access(parser_context &ctx, lex_cptr &ptr, const lex_cptr end) {
     const auto var_name = assert_token_type(ptr, lex::lex_type::IDENTIFIER)->span;
-    auto array_index = parse_between(ptr, "[", parse_expr_tree);
+    auto array_index = parse_between(ctx, ptr, lex::token_id::l_bracket, parse_expr_tree);
 
     return nodes::bin_op {
             nodes::bin_op_type::acc,
-            std::make_unique<nodes::var_ref>(
+            nodes::make_node<nodes::var_ref>(
+                    *ctx.arena,
                     var_name,
-                    get_var_type(var_name)
+                    ctx.get_var_type(var_name)
             ),
             std::move(array_index)
     };
 }
 
-nodes::var_ref pm::parse_variable(ast::lex_cptr &ptr, const ast::lex_cptr end) {
+nodes::var_ref pm::parse_variable(parser_context &ctx, ast::lex_cptr &ptr, const ast::lex_cptr end) {
     auto name = assert_token_type(ptr, lex::lex_type::IDENTIFIER)->span;
-    auto type = get_var_type(name);
+    auto type = ctx.get_var_type(name);
 
     return nodes::var_ref {
             name,
@@ -219,51 +296,51 @@ nodes::var_ref pm::parse_variable(ast::lex_cptr &ptr, const ast::lex_cptr end) {
     };
 }
 
-nodes::match pm::parse_match(ast::lex_cptr &ptr, const ast::lex_cptr end) {
+nodes::match pm::parse_match(parser_context &ctx, ast::lex_cptr &ptr, const ast::lex_cptr end) {
     nodes::match match;
 
-    assert_token_val(ptr, "match");
-    match.match_expr = parse_expression(ptr, end);
+    assert_token_id(ptr, lex::token_id::match);
+    match.match_expr = parse_expression(ctx, ptr, end);
 
-    assert_token_val(ptr, "{");
+    assert_token_id(ptr, lex::token_id::l_brace);
 
-    while (peek(ptr, end)->span != "}") {
-        if (test_token_val(ptr, "default")) {
-            match.default_case = std::make_unique<nodes::scope_block>(parse_body(ptr, end));
+    while (peek(ptr, end)->id != lex::token_id::r_brace) {
+        if (test_token_id(ptr, lex::token_id::default_)) {
+            match.default_case = std::make_unique<nodes::scope_block>(parse_body(ctx, ptr, end));
             break;
         }
 
-        assert_token_val(ptr, "case");
+        assert_token_id(ptr, lex::token_id::case_);
 
-        auto match_expr = parse_expr_tree(ptr, end);
-        auto body = parse_body(ptr, end);
+        auto match_expr = parse_expr_tree(ctx, ptr, end);
+        auto body = parse_body(ctx, ptr, end);
 
         match.cases.emplace_back(nodes::match_case {
             std::move(match_expr),
             std::move(body)
         });
-        if (!test_token_val(ptr, ","))
+        if (!test_token_id(ptr, lex::token_id::comma))
             break;
     }
 
-    assert_token_val(ptr, "}");
+    assert_token_id(ptr, lex::token_id::r_brace);
 
     return match;
 }
 
-nodes::initializer_list pm::parse_initializer_list(ast::lex_cptr &ptr, const ast::lex_cptr end) {
+nodes::initializer_list pm::parse_initializer_list(parser_context &ctx, ast::lex_cptr &ptr, const ast::lex_cptr end) {
     auto struct_hint = test_token_type(ptr, lex::lex_type::IDENTIFIER);
 
     return nodes::initializer_list {
-            parse_between(ptr, parse_expression_list),
+            parse_between(ctx, ptr, parse_expression_list),
             struct_hint ? (*struct_hint)->span : ""
     };
 }
 
-nodes::initialization pm::parse_initialization(lex_cptr &ptr, const lex_cptr end) {
-    auto type_inst = parse_type_instance(ptr, end);
+nodes::initialization pm::parse_initialization(parser_context &ctx, lex_cptr &ptr, const lex_cptr end) {
+    auto type_inst = parse_type_instance(ctx, ptr, end);
 
-    scope_stack.back().emplace(type_inst.var_name, type_inst.type);
+    ctx.scope_stack.back().emplace(type_inst.var_name, type_inst.type);
 
     return nodes::initialization {
             std::move(type_inst)
@@ -15,29 +15,28 @@ namespace ast::nodes {
 }
 
 namespace ast::pm {
-    nodes::type_instance parse_type_instance(lex_cptr &ptr, lex_cptr end);
+    nodes::type_instance parse_type_instance(parser_context &ctx, lex_cptr &ptr, lex_cptr end);
 
-    std::unique_ptr<nodes::expression> parse_unop(lex_cptr &ptr, const lex_cptr end);
+    nodes::node_ptr<nodes::expression> parse_unop(parser_context &ctx, lex_cptr &ptr, const lex_cptr end);
 
-    std::optional<nodes::bin_op_type> parse_binop(lex_cptr &ptr, const lex_cptr);
+    nodes::node_ptr<nodes::method_call> parse_method_call(parser_context &ctx, lex_cptr &ptr, const lex_cptr end);
 
-    std::optional<nodes::bin_op_type> parse_assn(const ast::lex_cptr, ast::lex_cptr &ptr);
+    nodes::var_ref parse_variable(parser_context &ctx, lex_cptr &ptr, lex_cptr end);
 
-    std::unique_ptr<nodes::method_call> parse_method_call(lex_cptr &ptr, const lex_cptr end);
-
-    nodes::var_ref parse_variable(lex_cptr &ptr, lex_cptr end);
-
-    nodes::bin_op parse_array_access(lex_cptr &ptr, const lex_cptr end);
+    nodes::bin_op parse_array_access(parser_context &ctx, lex_cptr &ptr, const lex_cptr end);
 
     std::optional<nodes::literal> parse_literal(lex_cptr &ptr, lex_cptr end);
 
-    nodes::match parse_match(lex_cptr &ptr, lex_cptr end);
+    nodes::match parse_match(parser_context &ctx, lex_cptr &ptr, lex_cptr end);
+
+    nodes::initializer_list parse_initializer_list(parser_context &ctx, lex_cptr &ptr, const ast::lex_cptr end);
 
-    nodes::initializer_list parse_initializer_list(lex_cptr &ptr, const ast::lex_cptr end);
+    nodes::initialization parse_initialization(parser_context &ctx, lex_cptr &ptr, const lex_cptr end);
 
-    nodes::initialization parse_initialization(lex_cptr &ptr, const lex_cptr end);
+    nodes::node_ptr<nodes::expression> parse_expression(parser_context &ctx, lex_cptr &ptr, const lex_cptr end);
 
-    std::unique_ptr<nodes::expression> parse_expression(lex_cptr &ptr, const lex_cptr end);
+    // An operand which is neither prefixed by an operator nor parenthesized
+    nodes::node_ptr<nodes::expression> parse_primary(parser_context &ctx, lex_cptr &ptr, const lex_cptr end);
 
-    std::unique_ptr<nodes::expression> parse_expr_tree(lex_cptr &ptr, const lex_cptr end);
+    nodes::node_ptr<nodes::expression> parse_expr_tree(parser_context &ctx, lex_cptr &ptr, const lex_cptr end);
 }
@@ -9,7 +9,7 @@ namespace ast::pm {
         return std::nullopt;
     };
 
-    nodes::bin_op create_bin_op(std::unique_ptr<nodes::expression> left, std::unique_ptr<nodes::expression> right, nodes::bin_op_type type) {
+    nodes::bin_op create_bin_op(util::arena &arena, nodes::node_ptr<nodes::expression> left, nodes::node_ptr<nodes::expression> right, nodes::bin_op_type type) {
         const auto l_type = left->get_type();
         const auto r_type = right->get_type();
 
@@ -27,14 +27,15 @@ namespace ast::pm {
         return nodes::bin_op {
             type,
             std::move(left),
-            std::make_unique<nodes::cast>(
+            nodes::make_node<nodes::cast>(
+            arena,
             std::move(right),
             l_type
             )
         };
     }
 
-    nodes::assignment create_assignment(std::unique_ptr<nodes::expression> left, std::unique_ptr<nodes::expression> right, std::optional<nodes::bin_op_type> additional_operator) {
+    nodes::assignment create_assignment(nodes::node_ptr<nodes::expression> left, nodes::node_ptr<nodes::expression> right, std::optional<nodes::bin_op_type> additional_operator) {
         auto l_type = left->get_type();
         auto r_type = right->get_type();
 
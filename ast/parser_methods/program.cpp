@@ -1,30 +1,38 @@
 #include "program.h"
 
-#include <charconv>
-
 #include "expression.h"
 #include "../../lexer/lex.h"
+#include "../../lexer/source_location.h"
 #include "statement.h"
 #include "declarations.h"
 
 using namespace ast;
 
-std::unique_ptr<nodes::program_level_stmt> pm::parse_program_level_stmt(ast::lex_cptr &ptr, ast::lex_cptr end) {
-    if (test_token_val(ptr, "_libc") || peek(ptr, end)->span == "fn") {
-        return parse_function_prototype(ptr, end);
-    } else if (peek(ptr, end)->span == "struct") {
-        return parse_struct_decl(ptr, end);
-    } else if (test_token_val(ptr, ";")) {
-        return nullptr;
+std::unique_ptr<nodes::program_level_stmt> pm::parse_program_level_stmt(parser_context &ctx, ast::lex_cptr &ptr, ast::lex_cptr end) {
+    const auto token = *peek(ptr, end);
+
+    switch (token.id) {
+        case lex::token_id::libc:
+            consume(ptr, end);
+            [[fallthrough]];
+        case lex::token_id::fn:
+            return parse_function_prototype(ctx, ptr, end);
+        case lex::token_id::struct_:
+            return parse_struct_decl(ctx, ptr, end);
+        case lex::token_id::semicolon:
+            consume(ptr, end);
+            return nullptr;
+        default:
+            break;
     }
 
-    throw std::runtime_error("Unknown program level statement");
+    throw lex::source_error("Unknown program level statement", token.span);
 }
 
-ast::nodes::method_params pm::parse_method_params(lex_cptr &ptr, const lex_cptr end) {
+ast::nodes::method_params pm::parse_method_params(parser_context &ctx, lex_cptr &ptr, const lex_cptr end) {
     ast::nodes::method_params method_params;
 
-    for (auto param : parse_split_type_inst(ptr, end)) {
+    for (auto param : parse_split_type_inst(ctx, ptr, end)) {
         if (param.var_name == "...") {
             method_params.is_var_args = true;
             break;
@@ -36,18 +44,18 @@ ast::nodes::method_params pm::parse_method_params(lex_cptr &ptr, const lex_cptr
     return method_params;
 }
 
-std::vector<std::unique_ptr<nodes::expression>> pm::parse_expression_list(lex_cptr &ptr, const lex_cptr end) {
-    return parse_split(ptr, end, ",", parse_expr_tree);
+std::vector<nodes::node_ptr<nodes::expression>> pm::parse_expression_list(parser_context &ctx, lex_cptr &ptr, const lex_cptr end) {
+    return parse_split(ctx, ptr, end, lex::token_id::comma, parse_expr_tree);
 }
 
-std::unique_ptr<nodes::function_prototype> pm::parse_function_prototype(ast::lex_cptr &ptr, ast::lex_cptr end) {
-    assert_token_val(ptr, "fn");
+std::unique_ptr<nodes::function_prototype> pm::parse_function_prototype(parser_context &ctx, ast::lex_cptr &ptr, ast::lex_cptr end) {
+    assert_token_id(ptr, lex::token_id::fn);
 
     const auto function_name = assert_token_type(ptr, lex::lex_type::IDENTIFIER)->span;
-    auto params = parse_between(ptr, "(", parse_method_params);
+    auto params = parse_between(ctx, ptr, lex::token_id::l_paren, parse_method_params);
 
-    auto ret_type = test_token_val(ptr, "->") ?
-                    parse_var_type(ptr, end) :
+    auto ret_type = test_token_id(ptr, lex::token_id::arrow) ?
+                    parse_var_type(ctx, ptr, end) :
                     nodes::variable_type::void_type();
 
     auto prototype = std::make_unique<nodes::function_prototype>(
@@ -57,32 +65,40 @@ std::unique_ptr<nodes::function_prototype> pm::parse_function_prototype(ast::lex
         nullptr
     );
 
-    function_prototypes.emplace(function_name, prototype.get());
+    ctx.function_prototypes.emplace(function_name, prototype.get());
+
+    if (test_token_id(ptr, lex::token_id::semicolon))
+        return prototype;
+
+    if (const auto closer = ptr.closer(); ctx.defer_bodies && ptr->id == lex::token_id::l_brace && closer) {
+        ctx.deferred_bodies.push_back({ prototype.get(), ptr });
+        ptr = *closer + 1;
 
-    if (!test_token_val(ptr, ";")) {
-        prototype->implementation = std::make_unique<nodes::function>(
-                parse_function(ptr, end, prototype.get())
-        );
+        return prototype;
     }
 
+    prototype->implementation = std::make_unique<nodes::function>(
+            parse_function(ctx, ptr, end, prototype.get())
+    );
+
     return prototype;
 }
 
-nodes::function pm::parse_function(lex_cptr &ptr, const lex_cptr end, const nodes::function_prototype *prototype) {
-    scope_stack.emplace_back();
-    current_function = prototype;
+nodes::function pm::parse_function(parser_context &ctx, lex_cptr &ptr, const lex_cptr end, const nodes::function_prototype *prototype) {
+    ctx.scope_stack.emplace_back();
+    ctx.current_function = prototype;
 
     for (const auto &param : prototype->params.data)
-        scope_stack.back().emplace(param.instance.var_name, param.instance.type);
+        ctx.scope_stack.back().emplace(param.instance.var_name, param.instance.type);
 
-    auto body = parse_body(ptr, end);
+    auto body = parse_body(ctx, ptr, end);
     auto &code_expressions = body.statements;
 
     if (code_expressions.empty() || dynamic_cast<nodes::return_op*>(code_expressions.back().get()) == nullptr) {
         if (prototype->fn_name == "main" && prototype->return_type != nodes::variable_type::void_type()) {
             code_expressions.emplace_back(
                 std::make_unique<nodes::return_op>(
-                std::make_unique<nodes::literal>(0)
+                nodes::make_node<nodes::literal>(*ctx.arena, 0)
                 )
             );
         } else {
@@ -90,8 +106,8 @@ nodes::function pm::parse_function(lex_cptr &ptr, const lex_cptr end, const node
         }
     }
 
-    current_function = nullptr;
-    scope_stack.pop_back();
+    ctx.current_function = nullptr;
+    ctx.scope_stack.pop_back();
 
     return nodes::function {
         std::move(body),
@@ -99,42 +115,45 @@ nodes::function pm::parse_function(lex_cptr &ptr, const lex_cptr end, const node
     };
 }
 
-nodes::scope_block pm::parse_body(lex_cptr &ptr, lex_cptr end) {
+nodes::scope_block pm::parse_body(parser_context &ctx, lex_cptr &ptr, lex_cptr end) {
     nodes::scope_block::scope_stmts stmts;
 
-    scope_stack.emplace_back();
+    ctx.scope_stack.emplace_back();
 
-    if (test_token_val(ptr, "{")) {
-        while (!test_token_val(ptr, "}"))
-            stmts.emplace_back(parse_statement(ptr, end));
+    if (test_token_id(ptr, lex::token_id::l_brace)) {
+        while (!test_token_id(ptr, lex::token_id::r_brace))
+            stmts.emplace_back(parse_statement(ctx, ptr, end));
     } else {
-        stmts.emplace_back(parse_statement(ptr, end));
+        stmts.emplace_back(parse_statement(ctx, ptr, end));
     }
 
-    scope_stack.pop_back();
+    ctx.scope_stack.pop_back();
 
     return nodes::scope_block { std::move(stmts) };
 }
 
-nodes::variable_type pm::parse_var_type(lex_cptr &ptr, lex_cptr end) {
-    const auto is_volatile = test_token_val(ptr, "volatile").has_value();
-    const auto is_const = !test_token_val(ptr, "mut").has_value();
-    const auto type = assert_token(ptr, is_variable_identifier)->span;
+nodes::variable_type pm::parse_var_type(parser_context &ctx, lex_cptr &ptr, lex_cptr end) {
+    const auto is_volatile = test_token_id(ptr, lex::token_id::volatile_).has_value();
+    const auto is_const = !test_token_id(ptr, lex::token_id::mut).has_value();
+    if (!is_variable_identifier(ctx, ptr))
+        raise({ parse_error_kind::condition_not_met, ptr->span });
+
+    const auto type = (ptr++)->span;
     int array_length = 0;
     uint8_t pointer_count = 0;
 
-    if (test_token_val(ptr, "[")) {
+    if (test_token_id(ptr, lex::token_id::l_bracket)) {
         if (auto len = test_token_type(ptr, lex::lex_type::INT_LITERAL))
-            std::from_chars((*len)->span.data(), (*len)->span.data() + (*len)->span.size(), array_length);
+            array_length = static_cast<int>(std::get<uint64_t>(len->literal()->value));
         else
             array_length = -1;
 
         pointer_count++;
 
-        assert_token_val(ptr, "]");
+        assert_token_id(ptr, lex::token_id::r_bracket);
     }
 
-    while (test_token_val(ptr, "*"))
+    while (test_token_id(ptr, lex::token_id::star))
         pointer_count++;
 
     if (auto intrinsicType = find_element(ast::pm::intrin_map, type)) {
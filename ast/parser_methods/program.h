@@ -6,14 +6,14 @@
 #include "../data/ast_nodes.h"
 
 namespace ast::pm {
-    std::unique_ptr<nodes::program_level_stmt> parse_program_level_stmt(lex_cptr& ptr, lex_cptr end);
+    std::unique_ptr<nodes::program_level_stmt> parse_program_level_stmt(parser_context &ctx, lex_cptr& ptr, lex_cptr end);
 
-    std::unique_ptr<nodes::function_prototype> parse_function_prototype(lex_cptr &ptr, lex_cptr end);
-    nodes::function parse_function(lex_cptr& ptr, const lex_cptr end, const nodes::function_prototype *prototype);
-    nodes::scope_block parse_body(lex_cptr& ptr, lex_cptr end);
-    nodes::variable_type parse_var_type(lex_cptr& ptr, lex_cptr end);
-    std::unique_ptr<nodes::struct_declaration> parse_struct_decl(lex_cptr& ptr, const lex_cptr end);
+    std::unique_ptr<nodes::function_prototype> parse_function_prototype(parser_context &ctx, lex_cptr &ptr, lex_cptr end);
+    nodes::function parse_function(parser_context &ctx, lex_cptr& ptr, const lex_cptr end, const nodes::function_prototype *prototype);
+    nodes::scope_block parse_body(parser_context &ctx, lex_cptr& ptr, lex_cptr end);
+    nodes::variable_type parse_var_type(parser_context &ctx, lex_cptr& ptr, lex_cptr end);
+    std::unique_ptr<nodes::struct_declaration> parse_struct_decl(parser_context &ctx, lex_cptr& ptr, const lex_cptr end);
 
-    ast::nodes::method_params parse_method_params(lex_cptr& ptr, const lex_cptr end);
-    std::vector<std::unique_ptr<nodes::expression>> parse_expression_list(lex_cptr& ptr, const lex_cptr end);
+    ast::nodes::method_params parse_method_params(parser_context &ctx, lex_cptr& ptr, const lex_cptr end);
+    std::vector<nodes::node_ptr<nodes::expression>> parse_expression_list(parser_context &ctx, lex_cptr& ptr, const lex_cptr end);
 }
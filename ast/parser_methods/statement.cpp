@@ -7,76 +7,79 @@
 #include "operator.h"
 #include "program.h"
 #include "../../lexer/lex.h"
+#include "../../lexer/source_location.h"
 
 using namespace ast;
 
-std::unique_ptr<nodes::statement> pm::parse_statement(lex_cptr &ptr, lex_cptr end) {
+std::unique_ptr<nodes::statement> pm::parse_statement(parser_context &ctx, lex_cptr &ptr, lex_cptr end) {
     if (ptr == end)
         return nullptr;
 
-    auto next = peek(ptr, end)->span;
+    switch (peek(ptr, end)->id) {
+        case lex::token_id::if_:
+            return std::make_unique<nodes::if_statement>(parse_if_statement(ctx, ptr, end));
+        case lex::token_id::while_:
+        case lex::token_id::do_:
+            return std::make_unique<nodes::loop>(parse_loop(ctx, ptr, end));
+        case lex::token_id::for_:
+            return std::make_unique<nodes::for_loop>(parse_for_loop(ctx, ptr, end));
+        case lex::token_id::return_:
+            if (++ptr == end)
+                return std::make_unique<nodes::return_op>();
 
-    if (next == "if") {
-        return std::make_unique<nodes::if_statement>(parse_if_statement(ptr, end));
-    } else if (next == "while" || next == "do") {
-        return std::make_unique<nodes::loop>(parse_loop(ptr, end));
-    } else if (next == "for") {
-        return std::make_unique<nodes::for_loop>(parse_for_loop(ptr, end));
-    } else if (next == "return") {
-        if (++ptr == end)
-            return std::make_unique<nodes::return_op>();
-
-        return std::make_unique<nodes::return_op>(parse_expr_tree(ptr, end));
+            return std::make_unique<nodes::return_op>(parse_expr_tree(ctx, ptr, end));
+        default:
+            break;
     }
 
     return std::make_unique<nodes::expression_root>(
-        parse_expr_tree(ptr, end)
+        parse_expr_tree(ctx, ptr, end)
     );
 }
 
-nodes::if_statement pm::parse_if_statement(lex_cptr &ptr, lex_cptr end) {
-    assert_token_val(ptr, "if");
+nodes::if_statement pm::parse_if_statement(parser_context &ctx, lex_cptr &ptr, lex_cptr end) {
+    assert_token_id(ptr, lex::token_id::if_);
 
     return nodes::if_statement {
-        parse_between(ptr, "(", parse_expr_tree),
-        parse_body(ptr, end),
-        test_token_val(ptr, "else") ?
-            std::make_optional<nodes::scope_block>(parse_body(ptr, end)) :
+        parse_between(ctx, ptr, lex::token_id::l_paren, parse_expr_tree),
+        parse_body(ctx, ptr, end),
+        test_token_id(ptr, lex::token_id::else_) ?
+            std::make_optional<nodes::scope_block>(parse_body(ctx, ptr, end)) :
             std::nullopt
     };
 }
 
-nodes::loop pm::parse_loop(lex_cptr &ptr, lex_cptr end) {
-    if (test_token_val(ptr, "do")) {
-        auto stmts = parse_body(ptr, end);
-        assert_token_val(ptr, "while");
-        auto condition = parse_between(ptr, "(", parse_expr_tree);
-        assert_token_val(ptr, ";");
+nodes::loop pm::parse_loop(parser_context &ctx, lex_cptr &ptr, lex_cptr end) {
+    if (test_token_id(ptr, lex::token_id::do_)) {
+        auto stmts = parse_body(ctx, ptr, end);
+        assert_token_id(ptr, lex::token_id::while_);
+        auto condition = parse_between(ctx, ptr, lex::token_id::l_paren, parse_expr_tree);
+        assert_token_id(ptr, lex::token_id::semicolon);
 
         return nodes::loop {
             false,
             std::move(condition),
             std::move(stmts)
         };
-    } else if (test_token_val(ptr, "while")) {
+    } else if (test_token_id(ptr, lex::token_id::while_)) {
         return nodes::loop {
             true,
-            parse_between(ptr, "(", parse_expr_tree),
-            parse_body(ptr, end)
+            parse_between(ctx, ptr, lex::token_id::l_paren, parse_expr_tree),
+            parse_body(ctx, ptr, end)
         };
     } else {
-        throw std::runtime_error("Expected 'do' or 'while'");
+        throw lex::source_error("Expected 'do' or 'while'", ptr->span);
     }
 }
 
-nodes::for_loop pm::parse_for_loop(lex_cptr &ptr, lex_cptr end) {
-    assert_token_val(ptr, "for");
-    assert_token_val(ptr, "(");
+nodes::for_loop pm::parse_for_loop(parser_context &ctx, lex_cptr &ptr, lex_cptr end) {
+    assert_token_id(ptr, lex::token_id::for_);
+    assert_token_id(ptr, lex::token_id::l_paren);
 
     return nodes::for_loop {
-        parse_until(ptr, end, ";", parse_expr_tree),
-        parse_until(ptr, end, ";", parse_expr_tree),
-        parse_until(ptr, end, ")", parse_expr_tree),
-        parse_body(ptr, end)
+        parse_until(ctx, ptr, end, lex::token_id::semicolon, parse_expr_tree),
+        parse_until(ctx, ptr, end, lex::token_id::semicolon, parse_expr_tree),
+        parse_until(ctx, ptr, end, lex::token_id::r_paren, parse_expr_tree),
+        parse_body(ctx, ptr, end)
     };
 }
\ No newline at end of file
@@ -0,0 +1,300 @@
+#include "precompiled.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "interface.h"
+#include "util.h"
+#include "../lexer/lex.h"
+
+using namespace ast;
+
+namespace {
+    constexpr char MAGIC[4] = { 'O', 'N', 'P', 'I' };
+
+    // Bumped whenever the layout or the meaning of a record changes, which makes every existing blob stale
+    constexpr uint32_t VERSION = 1;
+
+    constexpr uint32_t INTERFACE_FLAG = 1;
+
+    // Stored in place of an intrinsic_type for types named by a struct
+    constexpr uint8_t NAMED_TYPE = 0xFF;
+
+    struct string_ref {
+        uint32_t offset, length;
+    };
+
+    struct blob_header {
+        char magic[4];
+        uint32_t version;
+        uint64_t source_hash;
+        uint32_t flags;
+        uint32_t struct_count, prototype_count, member_count;
+        uint32_t string_size;
+        uint32_t reserved;
+    };
+
+    struct type_record {
+        string_ref name;
+        int32_t array_length;
+        uint8_t intrinsic, pointer_depth, is_const, is_volatile;
+    };
+
+    struct member_record {
+        type_record type;
+        string_ref name;
+    };
+
+    struct struct_record {
+        string_ref name;
+        uint32_t first_member, member_count;
+    };
+
+    struct prototype_record {
+        type_record return_type;
+        string_ref name;
+        uint32_t first_param, param_count, is_var_args;
+    };
+
+    // Records are copied out rather than cast in place, so a blob needs no particular alignment
+    template <typename T>
+    T read(const std::string_view blob, const size_t offset) {
+        static_assert(std::is_trivially_copyable_v<T>);
+
+        T record;
+        std::memcpy(&record, blob.data() + offset, sizeof(T));
+        return record;
+    }
+
+    template <typename T>
+    void append(std::string &blob, const std::vector<T> &records) {
+        static_assert(std::is_trivially_copyable_v<T>);
+
+        blob.append(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(T));
+    }
+
+    [[noreturn]] void throw_corrupt() {
+        throw std::runtime_error("Corrupt precompiled interface");
+    }
+
+    class blob_writer {
+    public:
+        void add(const nodes::struct_declaration &decl) {
+            const auto first = static_cast<uint32_t>(members.size());
+
+            for (const auto &field : decl.fields)
+                members.push_back(member(field));
+
+            structs.push_back({ intern(decl.struct_name), first, static_cast<uint32_t>(decl.fields.size()) });
+        }
+
+        void add(const nodes::function_prototype &prototype) {
+            const auto first = static_cast<uint32_t>(members.size());
+
+            for (const auto &param : prototype.params.data)
+                members.push_back(member(param.instance));
+
+            prototypes.push_back({
+                type(prototype.return_type), intern(prototype.fn_name),
+                first, static_cast<uint32_t>(prototype.params.data.size()), prototype.params.is_var_args
+            });
+        }
+
+        std::string finish(const uint64_t hash, const bool interface) {
+            if (!interface) {
+                structs.clear();
+                prototypes.clear();
+                members.clear();
+                strings.clear();
+            }
+
+            blob_header header {};
+            std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+            header.version = VERSION;
+            header.source_hash = hash;
+            header.flags = interface ? INTERFACE_FLAG : 0;
+            header.struct_count = static_cast<uint32_t>(structs.size());
+            header.prototype_count = static_cast<uint32_t>(prototypes.size());
+            header.member_count = static_cast<uint32_t>(members.size());
+            header.string_size = static_cast<uint32_t>(strings.size());
+
+            std::string blob { reinterpret_cast<const char*>(&header), sizeof(header) };
+            append(blob, structs);
+            append(blob, prototypes);
+            append(blob, members);
+            blob += strings;
+
+            return blob;
+        }
+
+    private:
+        string_ref intern(const std::string_view text) {
+            if (const auto existing = interned.find(text); existing != interned.end())
+                return existing->second;
+
+            const string_ref ref { static_cast<uint32_t>(strings.size()), static_cast<uint32_t>(text.size()) };
+
+            strings += text;
+            interned.emplace(text, ref);
+
+            return ref;
+        }
+
+        type_record type(const nodes::variable_type &var_type) {
+            type_record record {
+                {}, var_type.array_length, NAMED_TYPE,
+                var_type.pointer_depth, var_type.is_const, var_type.is_volatile
+            };
+
+            if (const auto *intrinsic = std::get_if<nodes::intrinsic_type>(&var_type.type))
+                record.intrinsic = static_cast<uint8_t>(*intrinsic);
+            else
+                record.name = intern(std::get<std::string_view>(var_type.type));
+
+            return record;
+        }
+
+        member_record member(const nodes::type_instance &instance) {
+            return { type(instance.type), intern(instance.var_name) };
+        }
+
+        std::vector<struct_record> structs;
+        std::vector<prototype_record> prototypes;
+        std::vector<member_record> members;
+
+        // Keys point into the code being built from
+        std::string strings;
+        std::unordered_map<std::string_view, string_ref> interned;
+    };
+}
+
+uint64_t pci::content_hash(const std::string_view code) {
+    // 64-bit FNV-1a
+    uint64_t hash = 0xCBF29CE484222325;
+
+    for (const char c : code) {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 0x100000001B3;
+    }
+
+    return hash;
+}
+
+bool pci::is_current(const std::string_view blob, const uint64_t hash) {
+    if (blob.size() < sizeof(blob_header))
+        return false;
+
+    const auto header = read<blob_header>(blob, 0);
+
+    const auto expected_size = sizeof(blob_header)
+        + static_cast<size_t>(header.struct_count) * sizeof(struct_record)
+        + static_cast<size_t>(header.prototype_count) * sizeof(prototype_record)
+        + static_cast<size_t>(header.member_count) * sizeof(member_record)
+        + header.string_size;
+
+    return std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0
+        && header.version == VERSION
+        && header.source_hash == hash
+        && blob.size() == expected_size;
+}
+
+bool pci::is_interface(const std::string_view blob) {
+    return read<blob_header>(blob, 0).flags & INTERFACE_FLAG;
+}
+
+std::string pci::build(const std::string_view code) {
+    blob_writer writer;
+    bool interface = true;
+
+    try {
+        const auto tokens = lex::lex(code);
+        const auto root = ast::parse(tokens);
+
+        for (const auto &stmt : root.program_level_statements) {
+            if (const auto *decl = dynamic_cast<const nodes::struct_declaration*>(stmt.get()))
+                writer.add(*decl);
+            else if (const auto *prototype = dynamic_cast<const nodes::function_prototype*>(stmt.get()); prototype && !prototype->implementation)
+                writer.add(*prototype);
+            else
+                interface = false;
+        }
+    } catch (const std::runtime_error&) {
+        // Left for the textual include to report, with its location
+        interface = false;
+    }
+
+    return writer.finish(content_hash(code), interface);
+}
+
+void pci::load(const std::string_view blob, nodes::root &root, parser_context &ctx) {
+    const auto header = read<blob_header>(blob, 0);
+
+    const size_t structs_at = sizeof(blob_header);
+    const size_t prototypes_at = structs_at + header.struct_count * sizeof(struct_record);
+    const size_t members_at = prototypes_at + header.prototype_count * sizeof(prototype_record);
+    const auto strings = blob.substr(members_at + header.member_count * sizeof(member_record));
+
+    const auto text = [&](const string_ref ref) {
+        if (ref.offset > strings.size() || ref.length > strings.size() - ref.offset)
+            throw_corrupt();
+
+        return strings.substr(ref.offset, ref.length);
+    };
+
+    const auto type = [&](const type_record &record) -> nodes::variable_type {
+        std::variant<nodes::intrinsic_type, std::string_view> base;
+
+        if (record.intrinsic == NAMED_TYPE)
+            base = text(record.name);
+        else if (record.intrinsic <= static_cast<uint8_t>(nodes::intrinsic_type::infer_type))
+            base = static_cast<nodes::intrinsic_type>(record.intrinsic);
+        else
+            throw_corrupt();
+
+        return { base, static_cast<bool>(record.is_const), static_cast<bool>(record.is_volatile),
+                 record.pointer_depth, record.array_length };
+    };
+
+    const auto members = [&](const uint32_t first, const uint32_t count) {
+        if (first > header.member_count || count > header.member_count - first)
+            throw_corrupt();
+
+        std::vector<nodes::type_instance> instances;
+        instances.reserve(count);
+
+        for (uint32_t i = first; i < first + count; i++) {
+            const auto record = read<member_record>(blob, members_at + i * sizeof(member_record));
+            instances.emplace_back(type(record.type), text(record.name));
+        }
+
+        return instances;
+    };
+
+    for (uint32_t i = 0; i < header.struct_count; i++) {
+        const auto record = read<struct_record>(blob, structs_at + i * sizeof(struct_record));
+        const auto name = text(record.name);
+
+        auto decl = std::make_unique<nodes::struct_declaration>(name, members(record.first_member, record.member_count));
+
+        ctx.struct_types.emplace(name, decl.get());
+        root.program_level_statements.emplace_back(std::move(decl));
+    }
+
+    for (uint32_t i = 0; i < header.prototype_count; i++) {
+        const auto record = read<prototype_record>(blob, prototypes_at + i * sizeof(prototype_record));
+
+        nodes::method_params params;
+        params.is_var_args = record.is_var_args;
+
+        for (auto &param : members(record.first_param, record.param_count))
+            params.data.emplace_back(std::move(param));
+
+        auto prototype = std::make_unique<nodes::function_prototype>(type(record.return_type), text(record.name), std::move(params));
+
+        ctx.function_prototypes.emplace(prototype->fn_name, prototype.get());
+        root.program_level_statements.emplace_back(std::move(prototype));
+    }
+}
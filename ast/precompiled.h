@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "parser_context.h"
+#include "data/ast_nodes.h"
+
+namespace ast::pci {
+    /**
+     *  Precompiled Interface: Serialized Declarations of a Library File
+     *  ----------------------------------------------------------------
+     *  A flat blob holding the struct declarations and function prototypes of
+     *  a file, with every name interned into one string table, so including it
+     *  needs neither the lexer nor the parser. Blobs are stored as name.onpi
+     *  next to the file they were built from, and are keyed by a hash of its
+     *  contents, so editing the file makes its blob stale.
+     *
+     *  Only a file made of nothing but declarations is an interface. A blob is
+     *  written for any other file too, marked as such, so it is not parsed
+     *  again just to find that out.
+     *
+     *  Layout: header, struct records, prototype records, member records (the
+     *  fields and parameters they index into), then the string table.
+     */
+    uint64_t content_hash(std::string_view code);
+
+    // Whether blob is well-formed and was built from code with the given hash by this compiler
+    bool is_current(std::string_view blob, uint64_t hash);
+
+    // Whether a current blob holds declarations, rather than marking a file that must be included as text
+    bool is_interface(std::string_view blob);
+
+    // Parses code on its own, without preprocessing, and serializes its declarations
+    std::string build(std::string_view code);
+
+    // Appends the declarations in a current interface blob to root and registers them with the parse of ctx.
+    // The nodes point into blob, which has to outlive them.
+    void load(std::string_view blob, nodes::root &root, parser_context &ctx);
+}
@@ -5,17 +5,11 @@
 #include <stdexcept>
 
 #include "../lexer/lex.h"
+#include "../lexer/source_location.h"
 
 using namespace ast;
 
-std::vector<std::unordered_map<std::string_view, ast::nodes::variable_type>> ast::scope_stack;
-std::unordered_map<std::string_view, std::vector<ast::nodes::type_instance>> ast::struct_types;
-std::unordered_map<std::string_view, ast::nodes::function_prototype*> ast::function_prototypes;
-std::vector<ast::nodes::method_call*> ast::unfinished_method_calls;
-
-ast::nodes::function_prototype const* ast::current_function = nullptr;
-
-std::optional<ast::nodes::variable_type> ast::get_var_type(std::string_view var_name) {
+std::optional<nodes::variable_type> ast::parser_context::get_var_type(const std::string_view var_name) const {
     for (auto it = scope_stack.rbegin(); it != scope_stack.rend(); ++it) {
         auto find = it->find(var_name);
         if (find != it->end())
@@ -25,59 +19,131 @@ std::optional<ast::nodes::variable_type> ast::get_var_type(std::string_view var_
     return std::nullopt;
 }
 
+const nodes::struct_declaration* ast::parser_context::find_struct(const std::string_view name) const {
+    if (const auto find = struct_types.find(name); find != struct_types.end())
+        return find->second;
+
+    return outer ? outer->find_struct(name) : nullptr;
+}
+
 void ast::throw_unexpected(const lex::lex_token& token, const std::string_view expected) {
-    throw std::runtime_error(std::format("Unexpected token: {}, {}", token.span, expected));
+    throw lex::source_error(std::format("Unexpected token: {}, {}", token.span, expected), token.span);
 }
 
 void ast::throw_unclosed(const lex::lex_token& token, const std::string_view expected) {
-    throw std::runtime_error(std::format("Unclosed token: {}, {}", token.span, expected));
+    throw lex::source_error(std::format("Unclosed token: {}, {}", token.span, expected), token.span);
+}
+
+std::string ast::describe(const parse_error& error) {
+    switch (error.kind) {
+        case parse_error_kind::wrong_type:
+            return std::format("Unexpected token: {}, Wrong Type!", error.found);
+        case parse_error_kind::wrong_value:
+            return error.expected.empty()
+                ? std::format("Unexpected token: {}, Wrong Value!", error.found)
+                : std::format("Unexpected token: {}, Wrong Value! Expected: {}", error.found, error.expected);
+        case parse_error_kind::condition_not_met:
+            return std::format("Unexpected token: {}, Condition not met!", error.found);
+        case parse_error_kind::end_of_input:
+            return "Unexpected end of input!";
+        case parse_error_kind::never_found:
+            return std::format("Expected but never found: {}", error.expected);
+        case parse_error_kind::no_closer:
+            return "Tried to parse between a token with no closer";
+        case parse_error_kind::wrong_opener:
+            return std::format("Expected: {}, got: {}", error.expected, error.found);
+    }
+
+    return "Unknown parse error";
 }
 
-lex_cptr ast::assert_token_type(lex_cptr& ptr, const lex::lex_type type) {
+void ast::raise(const parse_error& error) {
+    switch (error.kind) {
+        case parse_error_kind::wrong_type:
+        case parse_error_kind::wrong_value:
+        case parse_error_kind::condition_not_met:
+            throw lex::source_error(describe(error), error.found);
+        default:
+            throw std::runtime_error(describe(error));
+    }
+}
+
+parse_result<lex_cptr> ast::expect_token_type(lex_cptr& ptr, const lex::lex_type type) {
     if (ptr->type != type)
-        throw_unexpected(*ptr, "Wrong Type!");
+        return std::unexpected(parse_error { parse_error_kind::wrong_type, ptr->span });
 
     return ptr++;
 }
 
-lex_cptr ast::assert_token_type(lex_cptr& ptr, const std::span<const lex::lex_type> types) {
-    if (std::ranges::find(types, ptr->type) != types.end())
-        throw_unexpected(*ptr, "Wrong Type!");
+parse_result<lex_cptr> ast::expect_token_type(lex_cptr& ptr, const std::span<const lex::lex_type> types) {
+    if (std::ranges::find(types, ptr->type) == types.end())
+        return std::unexpected(parse_error { parse_error_kind::wrong_type, ptr->span });
 
     return ptr++;
 }
 
-lex_cptr ast::assert_token_val(lex_cptr& ptr, const std::string_view val) {
+parse_result<lex_cptr> ast::expect_token_val(lex_cptr& ptr, const std::string_view val) {
     if (ptr->span != val)
-        throw_unexpected(*ptr, std::format("Wrong Value! Expected: {}", val));
+        return std::unexpected(parse_error { parse_error_kind::wrong_value, ptr->span, val });
 
     return ptr++;
 }
 
-lex_cptr ast::assert_token_val(lex_cptr& ptr, const std::span<const std::string_view> vals) {
-    if (std::ranges::find(vals, ptr->span) != vals.end())
-        throw_unexpected(*ptr, "Wrong Value!");
+parse_result<lex_cptr> ast::expect_token_val(lex_cptr& ptr, const std::span<const std::string_view> vals) {
+    if (std::ranges::find(vals, ptr->span) == vals.end())
+        return std::unexpected(parse_error { parse_error_kind::wrong_value, ptr->span });
 
     return ptr++;
 }
 
-lex_cptr ast::assert_token(lex_cptr& ptr, const parse_pred pred) {
+parse_result<lex_cptr> ast::expect_token_id(lex_cptr& ptr, const lex::token_id id) {
+    if (ptr->id != id)
+        return std::unexpected(parse_error { parse_error_kind::wrong_value, ptr->span, lex::spelling(id) });
+
+    return ptr++;
+}
+
+parse_result<lex_cptr> ast::expect_token(lex_cptr& ptr, const parse_pred pred) {
     if (!pred(ptr))
-        throw_unexpected(*ptr, "Condition not met!");
+        return std::unexpected(parse_error { parse_error_kind::condition_not_met, ptr->span });
 
     return ptr++;
 }
 
+lex_cptr ast::assert_token_type(lex_cptr& ptr, const lex::lex_type type) {
+    return unwrap(expect_token_type(ptr, type));
+}
+
+lex_cptr ast::assert_token_type(lex_cptr& ptr, const std::span<const lex::lex_type> types) {
+    return unwrap(expect_token_type(ptr, types));
+}
+
+lex_cptr ast::assert_token_val(lex_cptr& ptr, const std::string_view val) {
+    return unwrap(expect_token_val(ptr, val));
+}
+
+lex_cptr ast::assert_token_val(lex_cptr& ptr, const std::span<const std::string_view> vals) {
+    return unwrap(expect_token_val(ptr, vals));
+}
+
+lex_cptr ast::assert_token_id(lex_cptr& ptr, const lex::token_id id) {
+    return unwrap(expect_token_id(ptr, id));
+}
+
+lex_cptr ast::assert_token(lex_cptr& ptr, const parse_pred pred) {
+    return unwrap(expect_token(ptr, pred));
+}
+
 lex_cptr ast::consume(lex_cptr &ptr, const lex_cptr end) {
     if (ptr == end)
-        throw std::runtime_error("Unexpected end of input!");
+        raise({ parse_error_kind::end_of_input });
 
     return ptr++;
 }
 
 lex_cptr ast::peek(const lex_cptr ptr, const lex_cptr end, size_t offset) {
     if (ptr + offset >= end)
-        throw std::runtime_error("Unexpected end of input!");
+        raise({ parse_error_kind::end_of_input });
 
     return ptr + offset;
 }
@@ -90,6 +156,10 @@ bool ast::try_peek_val(const lex_cptr ptr, const lex_cptr end, const std::string
     return (ptr + offset) <= end && (ptr + offset)->span == val;
 }
 
+bool ast::try_peek_id(const lex_cptr ptr, const lex_cptr end, const lex::token_id id, const size_t offset) {
+    return (ptr + offset) <= end && (ptr + offset)->id == id;
+}
+
 std::optional<lex_cptr> ast::test_token_val(lex_cptr &ptr, const std::string_view val) {
     if (ptr->span != val)
         return std::nullopt;
@@ -98,7 +168,7 @@ std::optional<lex_cptr> ast::test_token_val(lex_cptr &ptr, const std::string_vie
 }
 
 std::optional<lex_cptr> ast::test_token_val(lex_cptr &ptr, const std::span<const std::string_view> vals) {
-    if (std::ranges::find(vals, ptr->span) != vals.end())
+    if (std::ranges::find(vals, ptr->span) == vals.end())
         return std::nullopt;
 
     return ptr++;
@@ -112,14 +182,21 @@ std::optional<lex_cptr> ast::test_token_type(lex_cptr &ptr, const lex::lex_type
 }
 
 std::optional<lex_cptr> ast::test_token_type(lex_cptr &ptr, const std::span<const lex::lex_type> types) {
-    if (std::ranges::find(types, ptr->type) != types.end())
+    if (std::ranges::find(types, ptr->type) == types.end())
+        return std::nullopt;
+
+    return ptr++;
+}
+
+std::optional<lex_cptr> ast::test_token_id(lex_cptr &ptr, const lex::token_id id) {
+    if (ptr->id != id)
         return std::nullopt;
 
     return ptr++;
 }
 
 std::optional<lex_cptr> ast::find_by_tok_val(const lex_cptr start, const lex_cptr end, const std::string_view val) {
-    auto find = std::find_if(start, end, [val](const lex::lex_token& token) {
+    auto find = std::find_if(start, end, [val](const lex::lex_token token) {
         return token.span == val;
     });
 
@@ -130,7 +207,7 @@ std::optional<lex_cptr> ast::find_by_tok_val(const lex_cptr start, const lex_cpt
 }
 
 std::optional<lex_cptr> ast::find_by_tok_type(const lex_cptr start, const lex_cptr end, const lex::lex_type type) {
-    auto find = std::find_if(start, end, [type](const lex::lex_token& token) {
+    auto find = std::find_if(start, end, [type](const lex::lex_token token) {
         return token.type == type;
     });
 
@@ -140,7 +217,32 @@ std::optional<lex_cptr> ast::find_by_tok_type(const lex_cptr start, const lex_cp
     return find;
 }
 
-bool ast::is_variable_identifier(const lex_cptr token) {
+std::optional<lex_cptr> ast::find_by_tok_id(const lex_cptr start, const lex_cptr end, const lex::token_id id) {
+    auto find = std::find_if(start, end, [id](const lex::lex_token token) {
+        return token.id == id;
+    });
+
+    if (find == end)
+        return std::nullopt;
+
+    return find;
+}
+
+std::optional<lex_cptr> ast::find_top_level(lex_cptr start, const lex_cptr end, const lex::token_id id) {
+    while (start < end) {
+        if (start.id() == id)
+            return start;
+
+        if (const auto closer = start.closer())
+            start = *closer + 1;
+        else
+            ++start;
+    }
+
+    return std::nullopt;
+}
+
+bool ast::is_variable_identifier(const parser_context &ctx, const lex_cptr token) {
     return token->type == lex::lex_type::PRIMITIVE
-        || struct_types.contains(token->span);
+        || ctx.find_struct(token->span);
 }
\ No newline at end of file
@@ -1,47 +1,99 @@
 #pragma once
 
+#include <expected>
 #include <optional>
 #include <span>
 #include <stdexcept>
+#include <string>
 #include <vector>
 #include <unordered_map>
 
 #include "util.h"
+#include "parser_context.h"
 #include "data/abstract_data.h"
 #include "data/ast_nodes.h"
-
-namespace lex {
-    struct lex_token;
-    enum class lex_type;
-}
+#include "../lexer/lex.h"
 
 namespace ast {
-    using lex_cptr = std::vector<lex::lex_token>::const_iterator;
+    using lex_cptr = lex::token_cursor;
+
+    enum class parse_error_kind {
+        wrong_type, wrong_value, condition_not_met,
+        end_of_input, never_found, no_closer, wrong_opener
+    };
+
+    /**
+     *  Parse Error: Deferred Diagnostic
+     *  --------------------------------
+     *  What a parse expected and the token it found instead, as views into the
+     *  source and the lexer's spelling table. Producing one allocates nothing,
+     *  so a speculative parse can fail and rewind cheaply; the message is only
+     *  formatted by raise, once a failure is known to be final.
+     */
+    struct parse_error {
+        parse_error_kind kind;
+        std::string_view found;     // Span of the offending token, empty if there is none
+        std::string_view expected;  // Spelling that was expected, empty if there is no single one
+    };
 
     template <typename T>
-    using parse_fn = T(*)(lex_cptr&, lex_cptr);
+    using parse_result = std::expected<T, parse_error>;
 
     template <typename T>
-    using loop_fn = std::optional<T>(*)(lex_cptr&);
-    using parse_pred = bool(*)(lex_cptr);
+    constexpr bool is_parse_result = false;
 
-    extern std::vector<std::unordered_map<std::string_view, ast::nodes::variable_type>> scope_stack;
-    extern std::unordered_map<std::string_view, std::vector<ast::nodes::type_instance>> struct_types;
-    extern std::unordered_map<std::string_view, ast::nodes::function_prototype*> function_prototypes;
+    template <typename T>
+    constexpr bool is_parse_result<std::expected<T, parse_error>> = true;
 
-    extern std::vector<ast::nodes::method_call*> unfinished_method_calls;
+    std::string describe(const parse_error& error);
 
-    extern ast::nodes::function_prototype const* current_function;
+    // Formats the error and throws it, pointing at the offending token when there is one
+    [[noreturn]] void raise(const parse_error& error);
 
-    std::optional<ast::nodes::variable_type> get_var_type(std::string_view var_name);
+    template <typename T>
+    T unwrap(parse_result<T> result) {
+        if (!result)
+            raise(result.error());
+
+        return std::move(*result);
+    }
+
+    // Fails in the way T allows: with the error itself when T is a parse_result, or by raising it otherwise
+    template <typename T>
+    T fail(const parse_error& error) {
+        if constexpr (is_parse_result<T>)
+            return std::unexpected(error);
+        else
+            raise(error);
+    }
+
+    template <typename T>
+    using parse_fn = T(*)(parser_context&, lex_cptr&, lex_cptr);
+
+    template <typename T>
+    using result_fn = parse_result<T>(*)(parser_context&, lex_cptr&, lex_cptr);
+
+    template <typename T>
+    using loop_fn = std::optional<T>(*)(lex_cptr&);
+    using parse_pred = bool(*)(lex_cptr);
 
     void throw_unexpected(const lex::lex_token& token, std::string_view expected = "No explanation given.");
     void throw_unclosed(const lex::lex_token& token, std::string_view expected = "No explanation given.");
 
+    // Each expect_token_* consumes the token if it matches, and otherwise leaves ptr and returns why not.
+    // The assert_token_* forms raise the error instead.
+    parse_result<lex_cptr> expect_token_type(lex_cptr& ptr, lex::lex_type type);
+    parse_result<lex_cptr> expect_token_type(lex_cptr& ptr, std::span<const lex::lex_type> types);
+    parse_result<lex_cptr> expect_token_val(lex_cptr& ptr, std::string_view val);
+    parse_result<lex_cptr> expect_token_val(lex_cptr& ptr, std::span<const std::string_view> vals);
+    parse_result<lex_cptr> expect_token_id(lex_cptr& ptr, lex::token_id id);
+    parse_result<lex_cptr> expect_token(lex_cptr& ptr, parse_pred pred);
+
     lex_cptr assert_token_type(lex_cptr& ptr, lex::lex_type type);
     lex_cptr assert_token_type(lex_cptr& ptr, std::span<const lex::lex_type> types);
     lex_cptr assert_token_val(lex_cptr& ptr, std::string_view val);
     lex_cptr assert_token_val(lex_cptr& ptr, std::span<const std::string_view> vals);
+    lex_cptr assert_token_id(lex_cptr& ptr, lex::token_id id);
 
     lex_cptr assert_token(lex_cptr& ptr, parse_pred pred);
 
@@ -58,40 +110,65 @@ namespace ast {
 
     bool try_peek_type(lex_cptr ptr, lex_cptr end, lex::lex_type type, size_t offset = 0);
     bool try_peek_val(lex_cptr ptr, lex_cptr end, std::string_view val, size_t offset = 0);
+    bool try_peek_id(lex_cptr ptr, lex_cptr end, lex::token_id id, size_t offset = 0);
 
     std::optional<lex_cptr> test_token_val(lex_cptr &ptr, std::string_view val);
     std::optional<lex_cptr> test_token_val(lex_cptr &ptr, std::span<const std::string_view> vals);
     std::optional<lex_cptr> test_token_type(lex_cptr &ptr, lex::lex_type type);
     std::optional<lex_cptr> test_token_type(lex_cptr &ptr, std::span<const lex::lex_type> types);
+    std::optional<lex_cptr> test_token_id(lex_cptr &ptr, lex::token_id id);
 
     std::optional<lex_cptr> find_by_tok_val(lex_cptr start, lex_cptr end, std::string_view val);
     std::optional<lex_cptr> find_by_tok_type(lex_cptr start, lex_cptr end, lex::lex_type type);
+    std::optional<lex_cptr> find_by_tok_id(lex_cptr start, lex_cptr end, lex::token_id id);
+
+    // Like find_by_tok_id, but steps over every bracketed group by its closer link, so only tokens at
+    // the nesting depth of start are matched. Splitting a list with it touches each top-level token once.
+    std::optional<lex_cptr> find_top_level(lex_cptr start, lex_cptr end, lex::token_id id);
 
-    bool is_variable_identifier(lex_cptr token);
+    bool is_variable_identifier(const parser_context &ctx, lex_cptr token);
+
+    // The combinators below fail through fail<T>, so a fn returning a parse_result has any structural
+    // error returned to it rather than thrown, and a fn returning a plain node raises it as before
 
     template <typename T, typename lex_cptr>
-    T parse_until(lex_cptr &ptr, lex_cptr end, std::string_view until, const parse_fn<T> fn,
+    T parse_until(parser_context &ctx, lex_cptr &ptr, lex_cptr end, lex::token_id until, const parse_fn<T> fn,
                                       const bool assert_contains = true) {
-        const auto terminate = find_by_tok_val(ptr, end, until)
-            .or_else([assert_contains, end, &until] -> std::optional<lex_cptr> {
-                if (assert_contains)
-                    throw std::runtime_error("Expected but never found: {}" + std::string(until));
-                return end;
-            }).value();
+        auto terminate = find_top_level(ptr, end, until);
+
+        if (!terminate) {
+            if (assert_contains)
+                return fail<T>({ parse_error_kind::never_found, {}, lex::spelling(until) });
+
+            terminate = end;
+        }
+
+        auto ret_node = fn(ctx, ptr, *terminate);
 
-        auto ret_node = fn(ptr, terminate);
-        ptr = terminate + 1;
+        if constexpr (is_parse_result<T>) {
+            if (!ret_node)
+                return ret_node;
+        }
+
+        ptr = *terminate + 1;
 
         return ret_node;
     }
 
     template <typename T, typename lex_cptr>
-    T parse_between(lex_cptr& ptr, const parse_fn<T> fn) {
-        if (!ptr->closer)
-            throw std::runtime_error("Tried to parse between a token with no closer");
+    T parse_between(parser_context &ctx, lex_cptr& ptr, const parse_fn<T> fn) {
+        const auto closer = ptr.closer();
+
+        if (!closer)
+            return fail<T>({ parse_error_kind::no_closer, ptr->span });
 
-        const auto end = ptr->closer.value();
-        auto node = fn(++ptr, end);
+        const auto end = closer.value();
+        auto node = fn(ctx, ++ptr, end);
+
+        if constexpr (is_parse_result<T>) {
+            if (!node)
+                return node;
+        }
 
         ptr = end + 1;
 
@@ -99,36 +176,48 @@ namespace ast {
     }
 
     template <typename T, typename lex_cptr>
-    T parse_between(lex_cptr& ptr, std::string_view val, const parse_fn<T> fn) {
-        if (ptr->span != val)
-            throw std::runtime_error("Expected: {}" + std::string(ptr->span));
+    T parse_between(parser_context &ctx, lex_cptr& ptr, lex::token_id opener, const parse_fn<T> fn) {
+        if (ptr->id != opener)
+            return fail<T>({ parse_error_kind::wrong_opener, ptr->span, lex::spelling(opener) });
 
-        return parse_between(ptr, fn);
+        return parse_between(ctx, ptr, fn);
     }
 
     template <typename T, typename lex_cptr>
-    std::vector<T> parse_split(lex_cptr& ptr, const lex_cptr end, const std::string_view split_val, const parse_fn<T> fn) {
+    std::vector<T> parse_split(parser_context &ctx, lex_cptr& ptr, const lex_cptr end, const lex::token_id split_val, const parse_fn<T> fn) {
         std::vector<T> split;
 
         while (ptr < end) {
             split.emplace_back(
-                parse_until<T, lex_cptr>(ptr, end, split_val, fn, false)
+                parse_until<T, lex_cptr>(ctx, ptr, end, split_val, fn, false)
             );
         }
 
         return split;
     }
 
-    template <typename T, typename lex_cptr>
-    std::optional<T> try_parse(lex_cptr &ptr, const lex_cptr end, const parse_fn<T> fn) {
+    /**
+     *  Try Parse: Speculative Parse
+     *  ----------------------------
+     *  Runs each alternative in turn until one succeeds, rewinding ptr after
+     *  every one that fails. Failure is carried by the parse_result rather than
+     *  an exception, so trying an alternative costs no more than parsing it.
+     *  If every alternative fails, the error of the last is returned.
+     */
+    template <typename T, typename... Alternatives>
+    parse_result<T> try_parse(parser_context &ctx, lex_cptr &ptr, const lex_cptr end, const result_fn<T> fn, const Alternatives... alternatives) {
         const lex_cptr start_cache = ptr;
+        auto node = fn(ctx, ptr, end);
 
-        try {
-            return fn(ptr, end);
-        } catch (const std::runtime_error&) {
-            ptr = start_cache;
-            return std::nullopt;
-        }
+        if (node)
+            return node;
+
+        ptr = start_cache;
+
+        if constexpr (sizeof...(alternatives) > 0)
+            return try_parse<T>(ctx, ptr, end, alternatives...);
+        else
+            return node;
     }
 
     template <typename T, typename lex_cptr>
@@ -141,19 +230,6 @@ namespace ast {
         return nodes;
     }
 
-    template <typename T, typename lex_cptr>
-    T try_parse(lex_cptr &ptr, const lex_cptr end, const parse_fn<T> fn, auto... fn_va) {
-        if (auto node = try_parse(ptr, end, fn)) {
-            return node.value();
-        }
-
-        if constexpr (sizeof...(fn_va) == 0) {
-            throw std::runtime_error("No more functions to try!");
-        }
-
-        return ast::try_parse(ptr, fn_va...);
-    }
-
     template <typename T, typename lex_cptr>
     loop_fn<T> test_token_predicate(parse_pred pred) {
         return [pred](lex_cptr& ptr) -> std::optional<lex_cptr> {
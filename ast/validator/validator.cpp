@@ -1,51 +1,91 @@
 #include "validator.hpp"
 
+#include <stdexcept>
+#include <utility>
+
+#include "../../lexer/source_location.h"
+#include "../lazy_state.h"
+
 using namespace ast;
 
-std::unordered_map<std::string_view, nodes::function_prototype*> functions;
-std::unordered_map<std::string_view, nodes::struct_declaration*> struct_names;
+// The declarations of the root being validated, which the validator looks names up in and adds nodes to
+thread_local const val::declarations *decls;
+
+thread_local std::vector<std::unordered_map<std::string_view, nodes::variable_type>> scopes;
+
+thread_local const nodes::function_prototype* current_function;
+
+namespace {
+    // Makes decls the declarations being validated against for as long as it lives, with a fresh scope stack
+    class active_declarations {
+    public:
+        explicit active_declarations(const val::declarations &active)
+            : previous(std::exchange(decls, &active)), previous_scopes(std::exchange(scopes, { {} })),
+              previous_function(std::exchange(current_function, nullptr)) {}
+
+        ~active_declarations() {
+            decls = previous;
+            scopes = std::move(previous_scopes);
+            current_function = previous_function;
+        }
 
-std::vector<std::unordered_map<std::string_view, nodes::variable_type>> scopes;
+        active_declarations(const active_declarations&) = delete;
+        active_declarations& operator=(const active_declarations&) = delete;
 
-nodes::function_prototype* current_function;
+    private:
+        const val::declarations *previous;
+        std::vector<std::unordered_map<std::string_view, nodes::variable_type>> previous_scopes;
+        const nodes::function_prototype *previous_function;
+    };
+}
 
 void val::validate(ast::nodes::root &root) {
-    functions.clear();
+    // A lazy root keeps its declarations, since the bodies it has not parsed yet are validated with them later
+    declarations local;
+    auto &validated = root.lazy_context ? root.lazy_context->validated : local;
 
-    scopes.clear();
-    scopes.emplace_back();
+    validated = { .arena = root.arena.get() };
+    active_declarations active { validated };
 
     for (auto& stmt : root.program_level_statements) {
         if (auto *func = dynamic_cast<nodes::function_prototype*>(stmt.get()))
-            cache_function(func);
+            cache_function(validated, func);
         else if (auto *struct_decl = dynamic_cast<nodes::struct_declaration*>(stmt.get()))
-            cache_struct(struct_decl);
+            cache_struct(validated, struct_decl);
     }
 
-    for (auto& [_, func] : functions)
+    for (auto& [_, func] : validated.functions)
         if (func->implementation)
             validate_function(func);
 }
 
-static void val::cache_function(ast::nodes::function_prototype* func) {
-    auto find = functions.find(func->fn_name);
-    auto found = find != functions.end();
-    auto has_implementation = found && find->second->implementation != nullptr;
+static void val::cache_function(declarations &validated, ast::nodes::function_prototype* func) {
+    auto find = validated.functions.find(func->fn_name);
+    auto found = find != validated.functions.end();
+    auto has_implementation = found && find->second->has_body();
 
     if (!found || !has_implementation)
-        functions[func->fn_name] = func;
-    else if (func->implementation)
-        throw std::runtime_error("Function " + std::string(func->fn_name) + " already has an implementation");
+        validated.functions[func->fn_name] = func;
+    else if (func->has_body())
+        throw lex::source_error("Function " + std::string(func->fn_name) + " already has an implementation", func->fn_name);
 }
 
-static void val::cache_struct(ast::nodes::struct_declaration* func) {
-    if (struct_names.contains(func->struct_name))
-        throw std::runtime_error("Struct " + std::string(func->struct_name) + " already exists");
+static void val::cache_struct(declarations &validated, ast::nodes::struct_declaration* func) {
+    if (validated.struct_names.contains(func->struct_name))
+        throw lex::source_error("Struct " + std::string(func->struct_name) + " already exists", func->struct_name);
 
-    struct_names[func->struct_name] = func;
+    validated.struct_names[func->struct_name] = func;
 }
 
-static void val::validate_function(ast::nodes::function_prototype* func) {
+void val::validate_lazy_body(const ast::nodes::function_prototype *func, const declarations &validated) {
+    if (!validated.arena)
+        throw std::runtime_error("A lazily parsed body cannot be validated before its root is");
+
+    active_declarations active { validated };
+    validate_function(func);
+}
+
+static void val::validate_function(const ast::nodes::function_prototype* func) {
     scopes.emplace_back();
     current_function = func;
 
@@ -107,48 +147,80 @@ static void val::validate_statement(ast::nodes::statement* stmt) {
     }
 }
 
-static void val::validate_expression(std::unique_ptr<ast::nodes::expression> &tree) {
-    if (!tree)
-        return;
+static void val::validate_expression(ast::nodes::node_ptr<ast::nodes::expression> &tree) {
+    // Operands are validated before the expression using them, from an explicit stack rather than by
+    // recursion, so there is no limit to how deeply an expression may nest. The bool marks an expression
+    // whose operands are done.
+    std::vector<std::pair<ast::nodes::node_ptr<ast::nodes::expression>*, bool>> pending { { &tree, false } };
+
+    while (!pending.empty()) {
+        const auto [expr, operands_validated] = pending.back();
+        pending.pop_back();
+
+        if (!*expr)
+            continue;
+
+        const auto visit = [&](ast::nodes::node_ptr<ast::nodes::expression> &operand) {
+            pending.emplace_back(&operand, false);
+        };
+
+        if (!operands_validated) {
+            pending.emplace_back(expr, true);
+
+            // Pushed last to first, so they are validated first to last
+            if (auto *call = dynamic_cast<ast::nodes::method_call *>(expr->get())) {
+                for (auto arg = call->arguments.rbegin(); arg != call->arguments.rend(); ++arg)
+                    visit(*arg);
+            } else if (auto *b_op = dynamic_cast<ast::nodes::bin_op *>(expr->get())) {
+                visit(b_op->right);
+                visit(b_op->left);
+            } else if (auto *u_op = dynamic_cast<ast::nodes::un_op*>(expr->get())) {
+                if (u_op->type != ast::nodes::un_op_type::addr_of)
+                    visit(u_op->value);
+            } else if (auto *assn = dynamic_cast<ast::nodes::assignment*>(expr->get())) {
+                visit(assn->rhs);
+                visit(assn->lhs);
+            } else if (auto *root = dynamic_cast<ast::nodes::expression_root*>(expr->get())) {
+                visit(root->expr);
+            }
+
+            continue;
+        }
 
-    if (auto *call = dynamic_cast<ast::nodes::method_call *>(tree.get())) {
-        validate_method_call(call);
-    } else if (auto *b_op = dynamic_cast<ast::nodes::bin_op *>(tree.get())) {
-        validate_bin_op(b_op);
-    } else if (auto *u_op = dynamic_cast<ast::nodes::un_op*>(tree.get())) {
-        validate_un_op(u_op);
-    } else if (auto *assn = dynamic_cast<ast::nodes::assignment*>(tree.get())) {
-        validate_assn(assn);
-    } else if (auto *expr = dynamic_cast<ast::nodes::expression_root*>(tree.get())) {
-        validate_expression(expr->expr);
-    } else if (auto *init = dynamic_cast<ast::nodes::initialization*>(tree.get())) {
-        scopes.back().emplace(init->instance.var_name, init->instance.type);
+        if (auto *call = dynamic_cast<ast::nodes::method_call *>(expr->get())) {
+            validate_method_call(call);
+        } else if (auto *b_op = dynamic_cast<ast::nodes::bin_op *>(expr->get())) {
+            validate_bin_op(b_op);
+        } else if (auto *u_op = dynamic_cast<ast::nodes::un_op*>(expr->get())) {
+            validate_un_op(u_op);
+        } else if (auto *assn = dynamic_cast<ast::nodes::assignment*>(expr->get())) {
+            validate_assn(assn);
+        } else if (auto *init = dynamic_cast<ast::nodes::initialization*>(expr->get())) {
+            scopes.back().emplace(init->instance.var_name, init->instance.type);
+        }
     }
 }
 
 static void val::validate_method_call(ast::nodes::method_call *call) {
-    auto find = functions.find(call->method_name);
+    auto find = decls->functions.find(call->method_name);
 
-    if (find == functions.end())
-        throw std::runtime_error("Function " + std::string(call->method_name) + " not found");
+    if (find == decls->functions.end())
+        throw lex::source_error("Function " + std::string(call->method_name) + " not found", call->method_name);
 
     auto *func = find->second;
 
     if (call->arguments.size() < func->params.data.size())
-        throw std::runtime_error("Too few arguments for function " + std::string(call->method_name));
+        throw lex::source_error("Too few arguments for function " + std::string(call->method_name), call->method_name);
 
     for (size_t i = 0; i < func->params.data.size(); ++i) {
-        validate_expression(call->arguments[i]);
         cast_to(call->arguments[i], func->params.data[i].instance.type);
     }
 
     if (call->arguments.size() > func->params.data.size()) {
         if (!func->params.is_var_args)
-            throw std::runtime_error("Too many arguments for function " + std::string(call->method_name));
+            throw lex::source_error("Too many arguments for function " + std::string(call->method_name), call->method_name);
 
         for (size_t i = func->params.data.size(); i < call->arguments.size(); ++i) {
-            validate_expression(call->arguments[i]);
-
             if (!call->arguments[i]->get_type().is_pointer())
                 cast_to(call->arguments[i], nodes::variable_type{nodes::intrinsic_type::i32});
         }
@@ -158,9 +230,6 @@ static void val::validate_method_call(ast::nodes::method_call *call) {
 }
 
 static void val::validate_bin_op(ast::nodes::bin_op *op) {
-    validate_expression(op->left);
-    validate_expression(op->right);
-
     auto l_type = op->left->get_type();
     auto r_type = op->right->get_type();
 
@@ -171,6 +240,9 @@ static void val::validate_bin_op(ast::nodes::bin_op *op) {
 
     if (l_type.is_intrinsic() && r_type.is_intrinsic()
      || l_type.is_pointer() && r_type.is_pointer()) {
+        if (l_type.is_intrinsic())
+            op->result_type = l_type;
+
         if (l_type == r_type)
             return;
 
@@ -178,49 +250,47 @@ static void val::validate_bin_op(ast::nodes::bin_op *op) {
         return;
     }
 
-    throw std::runtime_error("Cannot perform operation on non-intrinsic types");
+    throw lex::source_error("Cannot perform operation on non-intrinsic types", location_of(op));
 }
 
 static void val::validate_un_op(ast::nodes::un_op *op) {
     if (op->type == ast::nodes::un_op_type::addr_of)
         return;
 
-    validate_expression(op->value);
-
     switch (op->type) {
         case ast::nodes::un_op_type::deref:
             create_load(op->value);
             break;
         case ast::nodes::un_op_type::negate:
-            op->value = std::make_unique<ast::nodes::bin_op>(
+            op->value = ast::nodes::make_node<ast::nodes::bin_op>(
+                    *decls->arena,
                     ast::nodes::bin_op_type::sub,
-                    std::make_unique<ast::nodes::literal>(0),
+                    ast::nodes::make_node<ast::nodes::literal>(*decls->arena, 0),
                     std::move(op->value)
             );
             break;
         case ast::nodes::un_op_type::bit_not:
-            op->value = std::make_unique<ast::nodes::bin_op>(
+            op->value = ast::nodes::make_node<ast::nodes::bin_op>(
+                    *decls->arena,
                     ast::nodes::bin_op_type::b_xor,
-                    std::make_unique<ast::nodes::literal>(-1),
+                    ast::nodes::make_node<ast::nodes::literal>(*decls->arena, -1),
                     std::move(op->value)
             );
             break;
         case ast::nodes::un_op_type::log_not:
-            op->value = std::make_unique<ast::nodes::bin_op>(
+            op->value = ast::nodes::make_node<ast::nodes::bin_op>(
+                    *decls->arena,
                     ast::nodes::bin_op_type::eq,
-                    std::make_unique<ast::nodes::literal>(0),
+                    ast::nodes::make_node<ast::nodes::literal>(*decls->arena, 0),
                     std::move(op->value)
             );
             break;
         default:
-            throw std::runtime_error("Invalid unary operation");
+            throw lex::source_error("Invalid unary operation", location_of(op));
     }
 }
 
 static void val::validate_assn(ast::nodes::assignment *assn) {
-    validate_expression(assn->lhs);
-    validate_expression(assn->rhs);
-
     if (auto *load = dynamic_cast<ast::nodes::load*>(assn->lhs.get()))
         assn->lhs = std::move(load->expr);
 
@@ -232,8 +302,6 @@ static void val::validate_assn(ast::nodes::assignment *assn) {
 }
 
 static void val::validate_access(ast::nodes::bin_op *access) {
-    validate_expression(access->left);
-
     auto l_type = access->left->get_type();
     auto r_access = dynamic_cast<ast::nodes::var_ref*>(access->right.get());
 
@@ -243,14 +311,14 @@ static void val::validate_access(ast::nodes::bin_op *access) {
     }
 
     if (!r_access)
-        throw std::runtime_error("Right side of access is not a field (var_ref)");
+        throw lex::source_error("Right side of access is not a field (var_ref)", location_of(access->right.get()));
 
     auto struct_name = std::get<std::string_view>(l_type.type);
 
-    if (!struct_names.contains(struct_name))
-        throw std::runtime_error("Struct " + std::string(struct_name) + " not found");
+    if (!decls->struct_names.contains(struct_name))
+        throw lex::source_error("Struct " + std::string(struct_name) + " not found", struct_name);
 
-    auto *struct_decl = struct_names.at(struct_name);
+    auto *struct_decl = decls->struct_names.at(struct_name);
 
     for (auto& field : struct_decl->fields) {
         if (field.var_name == r_access->var_name) {
@@ -259,10 +327,10 @@ static void val::validate_access(ast::nodes::bin_op *access) {
         }
     }
 
-    throw std::runtime_error("Field " + std::string(r_access->var_name) + " not found in struct " + std::string(struct_name));
+    throw lex::source_error("Field " + std::string(r_access->var_name) + " not found in struct " + std::string(struct_name), r_access->var_name);
 }
 
-static void val::cast_to(std::unique_ptr<ast::nodes::expression> &expr, ast::nodes::variable_type type) {
+static void val::cast_to(ast::nodes::node_ptr<ast::nodes::expression> &expr, ast::nodes::variable_type type) {
     auto pre_type = expr->get_type();
 
     if (pre_type == type)
@@ -273,42 +341,48 @@ static void val::cast_to(std::unique_ptr<ast::nodes::expression> &expr, ast::nod
     if (initializer) {
         if (initializer->struct_hint != "") {
             if (type.is_intrinsic() || std::get<std::string_view>(type.type) != initializer->struct_hint)
-                throw std::runtime_error("Struct initializer does not match type hint");
+                throw lex::source_error("Struct initializer does not match type hint", initializer->struct_hint);
 
-            expr = std::make_unique<ast::nodes::struct_initializer>(
-                    struct_names.at(initializer->struct_hint),
-                    std::move(initializer->values)
+            expr = ast::nodes::make_node<ast::nodes::struct_initializer>(
+                    *decls->arena,
+                    decls->struct_names.at(initializer->struct_hint),
+                    std::move(initializer->values),
+                    *decls->arena
             );
         } else if (!type.is_intrinsic()) {
-            expr = std::make_unique<ast::nodes::struct_initializer>(
-                    struct_names.at(std::get<std::string_view>(type.type)),
-                    std::move(initializer->values)
+            expr = ast::nodes::make_node<ast::nodes::struct_initializer>(
+                    *decls->arena,
+                    decls->struct_names.at(std::get<std::string_view>(type.type)),
+                    std::move(initializer->values),
+                    *decls->arena
             );
         } else if (type.is_pointer()) {
             type.array_length = initializer->values.size();
-            expr = std::make_unique<ast::nodes::array_initializer>(
+            expr = ast::nodes::make_node<ast::nodes::array_initializer>(
+                *decls->arena,
                 type,
-                std::move(initializer->values)
+                std::move(initializer->values),
+                *decls->arena
             );
         } else {
-            throw std::runtime_error("Cannot cast initializer list to a primitive type");
+            throw lex::source_error("Cannot cast initializer list to a primitive type", location_of(initializer));
         }
 
         return;
     }
 
     if (!type.is_intrinsic() && !type.is_pointer())
-        throw std::runtime_error("Cannot cast to non-intrinsic type");
+        throw lex::source_error("Cannot cast to non-intrinsic type", location_of(expr.get()));
 
-    expr = std::make_unique<ast::nodes::cast>(std::move(expr), type);
+    expr = ast::nodes::make_node<ast::nodes::cast>(*decls->arena, std::move(expr), type);
 }
-static void val::create_load(std::unique_ptr<ast::nodes::expression> &expr) {
+static void val::create_load(ast::nodes::node_ptr<ast::nodes::expression> &expr) {
     auto type = expr->get_type();
 
     if (!type.is_pointer() && !type.is_var_ref)
-        throw std::runtime_error("Cannot load non-pointer type");
+        throw lex::source_error("Cannot load non-pointer type", location_of(expr.get()));
 
-    expr = std::make_unique<ast::nodes::load>(std::move(expr));
+    expr = ast::nodes::make_node<ast::nodes::load>(*decls->arena, std::move(expr));
 }
 
 static std::optional<nodes::variable_type> val::find_variable(std::string_view name) {
@@ -321,3 +395,37 @@ static std::optional<nodes::variable_type> val::find_variable(std::string_view n
 
     return std::nullopt;
 }
+
+static std::string_view val::location_of(const ast::nodes::expression *expr) {
+    // The first name inside the expression, found by following its leftmost operand
+    while (expr) {
+        if (const auto *ref = dynamic_cast<const ast::nodes::var_ref*>(expr))
+            return ref->var_name;
+        if (const auto *call = dynamic_cast<const ast::nodes::method_call*>(expr))
+            return call->method_name;
+        if (const auto *init = dynamic_cast<const ast::nodes::initialization*>(expr))
+            return init->instance.var_name;
+
+        if (const auto *op = dynamic_cast<const ast::nodes::bin_op*>(expr))
+            expr = op->left.get();
+        else if (const auto *op = dynamic_cast<const ast::nodes::un_op*>(expr))
+            expr = op->value.get();
+        else if (const auto *assn = dynamic_cast<const ast::nodes::assignment*>(expr))
+            expr = assn->lhs.get();
+        else if (const auto *cast = dynamic_cast<const ast::nodes::cast*>(expr))
+            expr = cast->expr.get();
+        else if (const auto *load = dynamic_cast<const ast::nodes::load*>(expr))
+            expr = load->expr.get();
+        else if (const auto *shield = dynamic_cast<const ast::nodes::expression_shield*>(expr))
+            expr = shield->expr.get();
+        else if (const auto *list = dynamic_cast<const ast::nodes::initializer_list*>(expr))
+            expr = list->values.empty() ? nullptr : list->values.front().get();
+        else if (const auto *init = dynamic_cast<const ast::nodes::struct_initializer*>(expr))
+            expr = init->values.empty() ? nullptr : init->values.front().get();
+        else
+            break;
+    }
+
+    // Otherwise, such as for a literal, the function the expression is in
+    return current_function ? current_function->fn_name : std::string_view {};
+}
@@ -1,19 +1,34 @@
 #pragma once
 
+#include <string_view>
+#include <unordered_map>
+
 #include "../data/ast_nodes.h"
 
 namespace ast::val {
+    // The functions and structs a root declares, and the arena nodes the validator adds to its tree go into
+    struct declarations {
+        std::unordered_map<std::string_view, nodes::function_prototype*> functions;
+        std::unordered_map<std::string_view, nodes::struct_declaration*> struct_names;
+
+        util::arena *arena = nullptr;
+    };
+
+    // Validation keeps its state per thread, so separate roots may be validated concurrently
     void validate(ast::nodes::root& root);
 
-    static void cache_function(ast::nodes::function_prototype *func);
-    static void cache_struct(ast::nodes::struct_declaration *func);
+    // Validates a body parsed lazily against the declarations its root was validated with
+    void validate_lazy_body(const ast::nodes::function_prototype *func, const declarations &decls);
 
-    static void validate_function(ast::nodes::function_prototype *func);
+    static void cache_function(declarations &validated, ast::nodes::function_prototype *func);
+    static void cache_struct(declarations &validated, ast::nodes::struct_declaration *func);
+
+    static void validate_function(const ast::nodes::function_prototype *func);
     static void validate_statement(ast::nodes::statement *stmt);
 
     static void validate_block(ast::nodes::scope_block *block);
 
-    static void validate_expression(std::unique_ptr<ast::nodes::expression> &tree);
+    static void validate_expression(ast::nodes::node_ptr<ast::nodes::expression> &tree);
 
     static void validate_method_call(ast::nodes::method_call *call);
     static void validate_bin_op(ast::nodes::bin_op *op);
@@ -22,8 +37,10 @@ namespace ast::val {
     static void validate_assn(ast::nodes::assignment *assn);
     static void validate_access(ast::nodes::bin_op *access);
 
-    static void cast_to(std::unique_ptr<ast::nodes::expression> &expr, ast::nodes::variable_type type);
-    static void create_load(std::unique_ptr<ast::nodes::expression> &expr);
+    static void cast_to(ast::nodes::node_ptr<ast::nodes::expression> &expr, ast::nodes::variable_type type);
+    static void create_load(ast::nodes::node_ptr<ast::nodes::expression> &expr);
 
     static std::optional<nodes::variable_type> find_variable(std::string_view name);
+
+    static std::string_view location_of(const ast::nodes::expression *expr);
 }
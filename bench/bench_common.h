@@ -0,0 +1,47 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// What the benchmarks share: timing, and loading the repository's own sources as input
+namespace bench {
+    using bench_clock = std::chrono::steady_clock;
+
+    inline double seconds_since(const bench_clock::time_point start) {
+        return std::chrono::duration<double>(bench_clock::now() - start).count();
+    }
+
+    // A named set of source files, measured together
+    struct corpus {
+        std::string name;
+        std::vector<std::string> files;
+    };
+
+    inline std::string read_file(const std::filesystem::path& path) {
+        std::ifstream file { path, std::ios::binary };
+        std::stringstream buffer;
+        buffer << file.rdbuf();
+
+        return buffer.str();
+    }
+
+    // Every .on file directly inside root / dir, or none if there is no such directory
+    inline corpus load_directory(const std::filesystem::path& root, const std::string_view dir) {
+        corpus loaded { std::string { dir } };
+
+        if (!std::filesystem::is_directory(root / dir))
+            return loaded;
+
+        for (const auto &entry : std::filesystem::directory_iterator(root / dir)) {
+            if (entry.path().extension() == ".on")
+                loaded.files.push_back(read_file(entry.path()));
+        }
+
+        return loaded;
+    }
+}
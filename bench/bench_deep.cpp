@@ -0,0 +1,133 @@
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../ast/interface.h"
+#include "../ast/validator/validator.hpp"
+#include "../lexer/lex.h"
+
+#include "bench_common.h"
+
+#ifdef ENABLE_LLVM
+#include "../llvm-gen/basic_codegen.h"
+#endif
+
+/**
+ *  Deep Nesting Benchmark
+ *  ----------------------
+ *  Generates programs whose single expression nests to a given depth, in each
+ *  of the shapes that used to recurse once per level: chained assignments,
+ *  left and right nested parentheses, and long sums. Each is lexed, parsed,
+ *  validated and, when built with LLVM, generated, at doubling depths, and
+ *  the time per level of nesting is printed as JSON, so a cost that grows
+ *  faster than the depth shows up as a growing time per level. Optionally
+ *  writes the generated programs to a directory, to be fed to the frontend.
+ *
+ *  Usage: bench_deep [max depth] [output dir]
+ */
+
+namespace {
+    using namespace bench;
+
+    // Each shape is run at the maximum depth and at this many halvings of it
+    constexpr int DEPTH_STEPS = 4;
+
+    struct shape {
+        std::string_view name;
+        std::string (*expression)(size_t depth);
+    };
+
+    std::string repeat(const std::string_view piece, const size_t count) {
+        std::string repeated;
+        repeated.reserve(piece.size() * count);
+
+        for (size_t i = 0; i < count; i++)
+            repeated += piece;
+
+        return repeated;
+    }
+
+    constexpr shape SHAPES[] {
+        { "assign", [](const size_t depth) { return repeat("a = ", depth) + "1"; } },
+        { "paren", [](const size_t depth) { return repeat("(", depth) + "a" + repeat(") + a", depth); } },
+        { "rparen", [](const size_t depth) { return repeat("a + (", depth) + "a" + repeat(")", depth); } },
+        { "sum", [](const size_t depth) { return repeat("a + ", depth) + "a"; } }
+    };
+
+    std::string program(const shape& of, const size_t depth) {
+        return std::format("fn main() -> i32 {{\n    i32 a = 1;\n    i32 b = {};\n    return b;\n}}\n", of.expression(depth));
+    }
+
+    struct result {
+        double lex_seconds = 0, parse_seconds = 0, validate_seconds = 0, codegen_seconds = 0;
+    };
+
+    result run(const std::string_view code) {
+        result measured;
+
+        auto start = bench_clock::now();
+        auto tokens = lex::lex(code);
+        measured.lex_seconds = seconds_since(start);
+
+        start = bench_clock::now();
+        auto root = ast::parse(tokens);
+        measured.parse_seconds = seconds_since(start);
+
+        start = bench_clock::now();
+        ast::val::validate(root);
+        measured.validate_seconds = seconds_since(start);
+
+#ifdef ENABLE_LLVM
+        start = bench_clock::now();
+        auto ir = cg::generate_ir(root);
+        measured.codegen_seconds = seconds_since(start);
+#endif
+
+        return measured;
+    }
+
+    std::string to_json(const shape& of, const size_t depth, const result& measured) {
+        const auto per_level = [depth](const double seconds) {
+            return seconds / static_cast<double>(depth) * 1e9;
+        };
+
+        return std::format(
+            R"({{ "name": "{}", "depth": {}, "lex_ns": {:.1f}, "parse_ns": {:.1f}, "validate_ns": {:.1f}, "codegen_ns": {:.1f} }})",
+            of.name, depth, per_level(measured.lex_seconds), per_level(measured.parse_seconds),
+            per_level(measured.validate_seconds), per_level(measured.codegen_seconds)
+        );
+    }
+}
+
+int main(const int argc, char **argv) {
+    const size_t max_depth = argc > 1 ? std::stoul(argv[1]) : 200000;
+    const std::filesystem::path output = argc > 2 ? argv[2] : "";
+
+    if (!output.empty())
+        std::filesystem::create_directories(output);
+
+    std::vector<std::string> lines;
+
+    for (const auto &of : SHAPES) {
+        for (int step = DEPTH_STEPS - 1; step >= 0; step--) {
+            const auto depth = std::max<size_t>(max_depth >> step, 1);
+            const auto code = program(of, depth);
+
+            if (!output.empty())
+                std::ofstream { output / std::format("{}_{}.on", of.name, depth), std::ios::binary } << code;
+
+            lines.push_back(to_json(of, depth, run(code)));
+        }
+    }
+
+    std::cout << "{\n  \"benchmarks\": [\n";
+
+    for (size_t i = 0; i < lines.size(); i++)
+        std::cout << "    " << lines[i] << (i + 1 < lines.size() ? ",\n" : "\n");
+
+    std::cout << "  ]\n}\n";
+}
@@ -0,0 +1,138 @@
+#include <format>
+#include <iostream>
+#include <string>
+#include <unordered_set>
+
+#include "../ast/flat_tree.h"
+#include "../ast/interface.h"
+#include "../ast/validator/validator.hpp"
+#include "../lexer/lex.h"
+
+#include "bench_common.h"
+
+/**
+ *  Flat Tree Benchmark
+ *  -------------------
+ *  Generates a large program whose functions share a fixed number of
+ *  distinct bodies, flattens it, and checks the flat tree against it: that
+ *  every subtree's end is in bounds, that a second parse of the same code
+ *  hashes the same, that a copy of a subtree hashes the same as the subtree
+ *  and again as a copy of the copy, that the function bodies hash to exactly
+ *  as many values as there are distinct bodies, and that changing one
+ *  literal changes the hash of the whole tree. Prints the time to flatten
+ *  and to hash per node as JSON, and exits with 1 if any check fails.
+ *
+ *  Usage: bench_flat [functions] [distinct bodies]
+ */
+
+namespace {
+    using namespace bench;
+
+    // Every this many nodes, the subtree there is copied out and checked
+    constexpr ast::flat::node_id COPY_STRIDE = 97;
+
+    std::string program(const size_t functions, const size_t distinct, const size_t changed = SIZE_MAX) {
+        std::string code = "struct P { i32 a, i32 b }\n"
+                           "fn h(i32 a, i32 b) -> i32 {\n    return a - b;\n}\n";
+
+        for (size_t i = 0; i < functions; i++) {
+            const auto factor = i == changed ? distinct : i % distinct;
+
+            code += std::format(
+                "fn g{}(i32 a, i32 b) -> i32 {{\n"
+                "    P p = {{a, b}};\n"
+                "    i32 x = a * {} + b - 3;\n"
+                "    if (x > 10) {{ x = x - 1; }} else {{ x += p.a; }}\n"
+                "    for (i32 k = 0; k < 4; k += 1) {{ x = h(x, k * 2); }}\n"
+                "    return x + p.b;\n"
+                "}}\n", i, factor);
+        }
+
+        return code;
+    }
+
+    struct parsed {
+        lex::token_stream tokens;
+        ast::nodes::root root;
+    };
+
+    parsed parse(const std::string_view code) {
+        auto tokens = lex::lex(code);
+        auto root = ast::parse(tokens);
+        ast::val::validate(root);
+
+        return { std::move(tokens), std::move(root) };
+    }
+
+    bool check(const bool passed, const std::string_view what) {
+        if (!passed)
+            std::cerr << "check failed: " << what << '\n';
+
+        return passed;
+    }
+}
+
+int main(const int argc, char **argv) {
+    using namespace ast::flat;
+
+    const size_t functions = argc > 1 ? std::stoul(argv[1]) : 20000;
+    const size_t distinct = argc > 2 ? std::stoul(argv[2]) : 64;
+
+    const auto code = program(functions, distinct);
+    const auto first = parse(code), second = parse(code);
+
+    auto start = bench_clock::now();
+    const auto flat = flatten(first.root);
+    const auto flatten_seconds = seconds_since(start);
+
+    bool passed = check(flat.size() > 0 && flat.kind(0) == node_kind::root && flat.end(0) == flat.size(),
+                        "the root spans the whole tree");
+
+    for (node_id id = 0; id < flat.size() && passed; id++)
+        passed = check(flat.end(id) > id && flat.end(id) <= flat.size(), "every end is in bounds");
+
+    start = bench_clock::now();
+    const auto root_hash = flat.hash(0);
+    const auto hash_seconds = seconds_since(start);
+
+    passed &= check(flatten(second.root).hash(0) == root_hash, "a second parse hashes the same");
+
+    size_t copies = 0;
+
+    for (node_id id = 0; id < flat.size() && passed; id += COPY_STRIDE, copies++) {
+        const auto copy = flat.subtree(id);
+
+        passed = check(copy.size() == flat.end(id) - id && copy.end(0) == copy.size(), "a copy has the subtree's size")
+              && check(copy.hash(0) == flat.hash(id), "a copy hashes the same as its subtree")
+              && check(copy.subtree(0).hash(0) == flat.hash(id), "a copy of a copy hashes the same");
+    }
+
+    std::unordered_set<uint64_t> bodies, prototypes;
+
+    for (const auto statement : flat.children(0)) {
+        if (flat.kind(statement) != node_kind::function_prototype || flat.name(statement) == "h")
+            continue;
+
+        prototypes.insert(flat.hash(statement));
+        bodies.insert(flat.hash(*flat.children(statement).begin()));
+    }
+
+    passed &= check(prototypes.size() == functions, "functions of different names hash differently");
+    passed &= check(bodies.size() == std::min(functions, distinct), "bodies hash the same exactly when they are equal");
+
+    const auto changed_code = program(functions, distinct, functions / 2);
+    const auto changed = parse(changed_code);
+
+    passed &= check(flatten(changed.root).hash(0) != root_hash, "changing a literal changes the hash");
+
+    const auto per_node = [&flat](const double seconds) {
+        return seconds / static_cast<double>(flat.size()) * 1e9;
+    };
+
+    std::cout << std::format(
+        "{{ \"name\": \"flat_tree\", \"nodes\": {}, \"copies\": {}, \"distinct_bodies\": {}, \"flatten_ns\": {:.1f}, \"hash_ns\": {:.1f}, \"passed\": {} }}\n",
+        flat.size(), copies, bodies.size(), per_node(flatten_seconds), per_node(hash_seconds), passed
+    );
+
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,248 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <iostream>
+#include <new>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../lexer/lex.h"
+
+#include "bench_common.h"
+
+/**
+ *  Lexer Benchmark
+ *  ---------------
+ *  Runs lex::lex over the repository's own sources and over synthetic inputs
+ *  that each stress one part of the lexer, and prints the throughput of each
+ *  as JSON. Every allocation made while lexing is counted, so regressions in
+ *  the token storage show up as well as regressions in speed.
+ *
+ *  Usage: bench_lexer [source dir] [synthetic MiB]
+ */
+
+namespace {
+    std::atomic<size_t> allocations = 0;
+}
+
+void* operator new(const size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+
+    if (void *ptr = std::malloc(size ? size : 1))
+        return ptr;
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+    std::free(ptr);
+}
+
+namespace {
+    using namespace bench;
+
+    // Every corpus is lexed until it has had at least this long and this many runs
+    constexpr auto MIN_DURATION = std::chrono::milliseconds { 500 };
+    constexpr size_t MIN_RUNS = 5;
+
+    struct result {
+        size_t bytes = 0, tokens = 0, runs = 0;
+        size_t allocations = 0;
+        double seconds = 0;
+    };
+
+    template <typename Gen>
+    std::string repeat_until(const size_t size, Gen&& generate) {
+        std::string code;
+        code.reserve(size + 256);
+
+        while (code.size() < size)
+            generate(code);
+
+        return code;
+    }
+
+    std::string random_identifier(std::mt19937& rng) {
+        static constexpr std::string_view head = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ_";
+        static constexpr std::string_view tail = "abcdefghijklmnopqrstuvwxyz0123456789_";
+
+        std::string name(1, head[rng() % head.size()]);
+        const auto length = 2 + rng() % 14;
+
+        while (name.size() < length)
+            name += tail[rng() % tail.size()];
+
+        return name;
+    }
+
+    std::string identifier_heavy(const size_t size) {
+        std::mt19937 rng { 1 };
+
+        return repeat_until(size, [&](std::string& code) {
+            code += "fn " + random_identifier(rng) + "(i32 " + random_identifier(rng) + ") -> i32 {\n";
+
+            for (int line = 0; line < 8; line++)
+                code += std::format("    i32 {} = {}.{};\n",
+                    random_identifier(rng), random_identifier(rng), random_identifier(rng));
+
+            code += "}\n";
+        });
+    }
+
+    std::string operator_heavy(const size_t size) {
+        static constexpr std::string_view operators[] {
+            "+", "-", "*", "/", "%", "<<", ">>", "&", "|", "^", "&&", "||",
+            "==", "!=", "<=", ">=", "<", ">", "=", "+=", "-=", "->", "...", "++", "--"
+        };
+
+        std::mt19937 rng { 2 };
+
+        return repeat_until(size, [&](std::string& code) {
+            code += "x";
+
+            for (int term = 0; term < 16; term++) {
+                code += operators[rng() % std::size(operators)];
+                code += rng() % 4 ? "y" : "(z)";
+            }
+
+            code += ";\n";
+        });
+    }
+
+    std::string comment_heavy(const size_t size) {
+        std::mt19937 rng { 3 };
+
+        return repeat_until(size, [&](std::string& code) {
+            if (rng() % 2) {
+                code += "/* ";
+
+                for (int line = 0; line < 4; line++)
+                    code += std::format(" * {} {} {}\n", random_identifier(rng), random_identifier(rng), random_identifier(rng));
+
+                code += " */\n";
+            } else {
+                code += std::format("// {} {} {} {}\n",
+                    random_identifier(rng), random_identifier(rng), random_identifier(rng), random_identifier(rng));
+            }
+
+            code += "i32 a = b;\n";
+        });
+    }
+
+    std::string string_heavy(const size_t size) {
+        static constexpr std::string_view escapes[] { "\\n", "\\t", "\\\\", "\\0" };
+
+        std::mt19937 rng { 4 };
+
+        return repeat_until(size, [&](std::string& code) {
+            code += "printf(\"";
+
+            for (int word = 0; word < 6; word++) {
+                code += random_identifier(rng);
+                code += rng() % 4 ? std::string_view { " " } : escapes[rng() % std::size(escapes)];
+            }
+
+            code += "\", 'c', \"";
+            code += random_identifier(rng);
+            code += "\");\n";
+        });
+    }
+
+    // Localized string tables, with the occasional non-ASCII identifier
+    std::string unicode_heavy(const size_t size) {
+        static constexpr std::string_view words[] {
+            "größe", "café", "naïve", "ünïcödé", "страница", "ошибка", "ファイル", "保存", "错误", "مرحبا", "ελληνικά"
+        };
+
+        std::mt19937 rng { 5 };
+
+        return repeat_until(size, [&](std::string& code) {
+            code += std::format("char* {}_{} = \"", words[rng() % std::size(words)], rng() % 1000);
+
+            for (int word = 0; word < 8; word++)
+                code += std::format("{} ", words[rng() % std::size(words)]);
+
+            code += "\";\n";
+        });
+    }
+
+    result run(const corpus& input) {
+        result measured;
+
+        for (const auto &file : input.files)
+            measured.bytes += file.size();
+
+        // One warm-up run to fault in the sources and settle the allocator
+        for (const auto &file : input.files)
+            measured.tokens += lex::lex(file).size();
+
+        const auto start = bench_clock::now();
+        const auto allocations_before = allocations.load(std::memory_order_relaxed);
+
+        while (measured.runs < MIN_RUNS || bench_clock::now() - start < MIN_DURATION) {
+            for (const auto &file : input.files)
+                lex::lex(file);
+
+            measured.runs++;
+        }
+
+        measured.seconds = std::chrono::duration<double>(bench_clock::now() - start).count();
+        measured.allocations = allocations.load(std::memory_order_relaxed) - allocations_before;
+
+        return measured;
+    }
+
+    std::string to_json(const std::string_view name, const result& measured) {
+        const auto per_run = measured.seconds / static_cast<double>(measured.runs);
+
+        return std::format(
+            R"({{ "name": "{}", "bytes": {}, "tokens": {}, "runs": {}, "mb_per_s": {:.2f}, "tokens_per_s": {:.0f}, "allocs_per_token": {:.4f} }})",
+            name, measured.bytes, measured.tokens, measured.runs,
+            static_cast<double>(measured.bytes) / per_run / 1e6,
+            static_cast<double>(measured.tokens) / per_run,
+            measured.tokens ? static_cast<double>(measured.allocations) / static_cast<double>(measured.runs * measured.tokens) : 0.0
+        );
+    }
+}
+
+int main(const int argc, char **argv) {
+    const std::filesystem::path root = argc > 1 ? argv[1] : BENCH_SOURCE_DIR;
+    const size_t synthetic_size = (argc > 2 ? std::stoul(argv[2]) : 8) << 20;
+
+    std::vector<corpus> corpora {
+        load_directory(root, "test_code"),
+        load_directory(root, "lib"),
+        corpus { "identifier_heavy", { identifier_heavy(synthetic_size) } },
+        corpus { "operator_heavy", { operator_heavy(synthetic_size) } },
+        corpus { "comment_heavy", { comment_heavy(synthetic_size) } },
+        corpus { "string_heavy", { string_heavy(synthetic_size) } },
+        corpus { "unicode_heavy", { unicode_heavy(synthetic_size) } }
+    };
+
+    std::erase_if(corpora, [](const corpus& input) { return input.files.empty(); });
+
+    std::cout << "{\n  \"benchmarks\": [\n";
+
+    for (size_t i = 0; i < corpora.size(); i++) {
+        try {
+            std::cout << "    " << to_json(corpora[i].name, run(corpora[i]));
+        } catch (const std::exception &e) {
+            std::cerr << std::format("{}: {}\n", corpora[i].name, e.what());
+            return 1;
+        }
+
+        std::cout << (i + 1 < corpora.size() ? ",\n" : "\n");
+    }
+
+    std::cout << "  ]\n}\n";
+    return 0;
+}
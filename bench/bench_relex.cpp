@@ -0,0 +1,233 @@
+#include <bit>
+#include <filesystem>
+#include <format>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <variant>
+#include <vector>
+
+#include "../lexer/relex.h"
+
+#include "bench_common.h"
+
+/**
+ *  Re-Lexing Benchmark
+ *  -------------------
+ *  Applies chains of random edits to the repository's own sources and to a
+ *  large file built from them, re-lexing after each edit with lex::relex.
+ *  Every result is checked against lexing the edited source from scratch,
+ *  down to bracket links and decoded literals, and whether the two throw
+ *  must agree as well, with a rejected edit leaving the stream unchanged. Prints the average time of each as JSON, and exits
+ *  with 1 if any edit was re-lexed differently.
+ *
+ *  Usage: bench_relex [source dir] [edits per file] [large MiB]
+ */
+
+namespace {
+    using namespace bench;
+
+    // Edits are chained this many times before starting over from the original file
+    constexpr int CHAIN_LENGTH = 3;
+
+    // Pieces of code that edits insert, chosen to open and close brackets, comments and literals,
+    // and to split or complete multi-byte characters
+    constexpr std::string_view FRAGMENTS[] {
+        "{", "}", "(", ")", "[", "]", "\"", "'", "/*", "*/", "//", "\n", " ", "a", "1", ".", "..", "=", "+",
+        "x1", "\"s\"", "'c'", "fn g() { }", ";", "$", "0x1F", "1.5f32", "3u8", "\"a\\nb\"", "'\\n'", "\\",
+        "7i8", "1e5", "\xc3\xa9", "\xc3", "\xa9", "\xe5\x90\x8d", "\xe2\x82\xac"
+    };
+
+    struct result {
+        size_t edits = 0, rejected = 0, mismatches = 0;
+        double relex_seconds = 0, lex_seconds = 0;
+    };
+
+    bool same_literal(const lex::literal_value *lhs, const lex::literal_value *rhs) {
+        if (!lhs || !rhs)
+            return lhs == rhs;
+
+        if (lhs->suffix != rhs->suffix || lhs->value.index() != rhs->value.index())
+            return false;
+
+        return std::visit([rhs]<typename T>(const T& value) {
+            // Strings are compared through string_value, since their offsets into decoded may differ
+            if constexpr (std::is_same_v<T, lex::decoded_string>)
+                return true;
+            // Doubles are compared bit for bit, so a NaN still equals itself
+            else if constexpr (std::is_same_v<T, double>)
+                return std::bit_cast<uint64_t>(value) == std::bit_cast<uint64_t>(std::get<double>(rhs->value));
+            else
+                return value == std::get<T>(rhs->value);
+        }, lhs->value);
+    }
+
+    bool same_tokens(const lex::token_stream& lhs, const lex::token_stream& rhs) {
+        if (lhs.types != rhs.types || lhs.ids != rhs.ids || lhs.offsets != rhs.offsets || lhs.lengths != rhs.lengths)
+            return false;
+
+        for (size_t i = 0; i < lhs.size(); i++) {
+            if (lhs.types[i] == lex::lex_type::PUNCTUATOR && lhs.payloads[i] != rhs.payloads[i])
+                return false;
+
+            if (!same_literal(lhs.literal(i), rhs.literal(i)))
+                return false;
+
+            if (lhs.types[i] == lex::lex_type::STRING_LITERAL && lhs.string_value(i) != rhs.string_value(i))
+                return false;
+        }
+
+        return true;
+    }
+
+    template <typename Fn>
+    auto timed(double& seconds, Fn&& fn) {
+        const auto start = bench_clock::now();
+        auto value = fn();
+        seconds += seconds_since(start);
+
+        return value;
+    }
+
+    std::optional<lex::token_stream> try_lex(double& seconds, const std::string_view code) {
+        return timed(seconds, [code]() -> std::optional<lex::token_stream> {
+            try {
+                return lex::lex(code);
+            } catch (const std::exception&) {
+                return std::nullopt;
+            }
+        });
+    }
+
+    result run(const corpus& input, const size_t edits_per_file, std::mt19937& rng) {
+        result measured;
+        // Only the lexing of edited sources is measured
+        double untimed = 0;
+
+        for (const auto &file : input.files) {
+            for (size_t done = 0; done < edits_per_file;) {
+                // Each stream views the source it was lexed from, so a source lives as long as its stream
+                auto source = std::make_unique<std::string>(file);
+                auto tokens = try_lex(untimed, *source);
+
+                // A file which does not lex to begin with has nothing to re-lex
+                if (!tokens)
+                    break;
+
+                for (int link = 0; link < CHAIN_LENGTH && done < edits_per_file; link++) {
+                    done++;
+
+                    const auto offset = static_cast<uint32_t>(rng() % (source->size() + 1));
+                    const auto removed = std::min<uint32_t>(rng() % 4, source->size() - offset);
+
+                    std::string inserted;
+
+                    for (auto count = rng() % 3; count > 0; count--)
+                        inserted += FRAGMENTS[rng() % std::size(FRAGMENTS)];
+
+                    auto edited = std::make_unique<std::string>(*source);
+                    edited->replace(offset, removed, inserted);
+
+                    const auto full = try_lex(measured.lex_seconds, *edited);
+
+                    // An edit that does not lex has to leave the stream as it was
+                    const auto before = full ? std::nullopt : tokens;
+
+                    const auto relexed = timed(measured.relex_seconds, [&] {
+                        try {
+                            lex::relex(*tokens, *edited, { offset, removed, std::string_view { *edited }.substr(offset, inserted.size()) });
+                            return true;
+                        } catch (const std::exception&) {
+                            return false;
+                        }
+                    });
+
+                    measured.edits++;
+
+                    if (full.has_value() != relexed || !same_tokens(full ? *full : *before, *tokens)) {
+                        measured.mismatches++;
+                        std::cerr << std::format("{}: re-lexing differs after replacing {} bytes at {} with \"{}\"\n",
+                                                 input.name, removed, offset, inserted);
+                        break;
+                    }
+
+                    if (!relexed) {
+                        measured.rejected++;
+                        break;
+                    }
+
+                    source = std::move(edited);
+                }
+            }
+        }
+
+        return measured;
+    }
+
+    // The sources repeated until they reach size, so the cost of an edit can be told apart from the size of the file
+    corpus large_file(const std::vector<corpus>& corpora, const size_t size) {
+        std::string code;
+
+        while (code.size() < size) {
+            const auto before = code.size();
+
+            for (const auto &input : corpora) {
+                for (const auto &file : input.files)
+                    code += file + "\n";
+            }
+
+            if (code.size() == before)
+                break;
+        }
+
+        return corpus { "large_file", { std::move(code) } };
+    }
+
+    std::string to_json(const std::string_view name, const result& measured) {
+        const auto per_edit = [&measured](const double seconds) {
+            return measured.edits ? seconds / static_cast<double>(measured.edits) * 1e6 : 0.0;
+        };
+
+        return std::format(
+            R"({{ "name": "{}", "edits": {}, "rejected": {}, "mismatches": {}, "relex_us": {:.2f}, "lex_us": {:.2f} }})",
+            name, measured.edits, measured.rejected, measured.mismatches,
+            per_edit(measured.relex_seconds), per_edit(measured.lex_seconds)
+        );
+    }
+}
+
+int main(const int argc, char **argv) {
+    const std::filesystem::path root = argc > 1 ? argv[1] : BENCH_SOURCE_DIR;
+    const size_t edits_per_file = argc > 2 ? std::stoul(argv[2]) : 20000;
+    const size_t large_size = (argc > 3 ? std::stoul(argv[3]) : 4) << 20;
+
+    std::vector<corpus> corpora {
+        load_directory(root, "test_code"),
+        load_directory(root, "lib")
+    };
+
+    corpora.push_back(large_file(corpora, large_size));
+    std::erase_if(corpora, [](const corpus& input) { return input.files.empty() || input.files.front().empty(); });
+
+    // A fixed seed, so a mismatch can be reproduced
+    std::mt19937 rng { 42 };
+    bool all_match = true;
+
+    std::cout << "{\n  \"benchmarks\": [\n";
+
+    for (size_t i = 0; i < corpora.size(); i++) {
+        // The large file takes a full lex per edit to check against, so it gets fewer of them
+        const auto edits = corpora[i].name == "large_file" ? std::max<size_t>(edits_per_file / 100, 1) : edits_per_file;
+        const auto measured = run(corpora[i], edits, rng);
+
+        all_match &= measured.mismatches == 0;
+        std::cout << "    " << to_json(corpora[i].name, measured) << (i + 1 < corpora.size() ? ",\n" : "\n");
+    }
+
+    std::cout << "  ]\n}\n";
+    return all_match ? 0 : 1;
+}
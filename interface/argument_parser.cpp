@@ -50,6 +50,32 @@ arg_env in::parse_args(int argc, char **argv) {
             env.emit = OBJ;
         else if (arg == "-emit-exec")
             env.emit = EXEC;
+        else if (arg == "-stream-lex")
+            env.stream_lex = true;
+        else if (arg == "-lazy-bodies")
+            env.lazy_bodies = true;
+        else if (arg == "-print-flat")
+            env.print_flat = true;
+        else if (arg == "-I") {
+            if (!get_arg(args, i, arg)) {
+                std::cerr << "No include directory provided\n";
+                std::exit(1);
+            }
+
+            env.include_paths.emplace_back(arg);
+        }
+        else if (arg.starts_with("-I"))
+            env.include_paths.emplace_back(arg.substr(2));
+        else if (arg == "-D") {
+            if (!get_arg(args, i, arg)) {
+                std::cerr << "No macro definition provided\n";
+                std::exit(1);
+            }
+
+            env.defines.emplace_back(arg);
+        }
+        else if (arg.starts_with("-D"))
+            env.defines.emplace_back(arg.substr(2));
         else if (arg == "-o") {
             if (!get_arg(args, i, arg)) {
                 std::cerr << "No output file provided\n";
@@ -71,6 +97,9 @@ arg_env in::parse_args(int argc, char **argv) {
 
     env.input_file = arg;
 
+    // The bundled library is searched after any directory given on the command line
+    env.include_paths.emplace_back("lib");
+
     // Since the current suffix is .on, an object file is the same name minus the last n
     if (env.object_file == "")
         env.object_file = std::string { env.input_file.data(), env.input_file.size() - 1 };
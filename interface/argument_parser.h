@@ -1,6 +1,8 @@
 #pragma once
 
+#include <string>
 #include <string_view>
+#include <vector>
 
 namespace in {
     enum optimizer_level {
@@ -21,6 +23,21 @@ namespace in {
         emit_type emit = EXEC;
         std::string input_file;
         std::string object_file;
+
+        // Lex on a background thread while the parser consumes declarations
+        bool stream_lex = false;
+
+        // Parse and validate function bodies only once codegen reaches them; has no effect with stream_lex
+        bool lazy_bodies = false;
+
+        // Print the validated tree in its flat form, with a hash of each program level statement
+        bool print_flat = false;
+
+        // Directories searched for included files, in order, after the working directory
+        std::vector<std::string> include_paths;
+
+        // Macros given with -D, as NAME or NAME=VALUE
+        std::vector<std::string> defines;
     };
 
     extern arg_env parse_args(int argc, char** argv);
@@ -1,7 +1,9 @@
-#include <sstream>
-#include <fstream>
+#include <format>
 #include "file_reader.h"
 #include "../ast/interface.h"
+#include "../ast/flat_tree.h"
+#include "../lexer/lex_parallel.h"
+#include "../lexer/source_location.h"
 #include "../preprocess/preprocessor.hpp"
 #include "../ast/validator/validator.hpp"
 
@@ -21,60 +23,117 @@
 
 using namespace in;
 
-file_pipeline & file_pipeline::load_file() {
-    std::ifstream file { env.input_file };
+// Runs a pipeline stage, prefixing any diagnostic that points into the source with its file, line and column
+template <typename Fn>
+void with_locations(const file_pipeline& pipeline, Fn&& stage) {
+    try {
+        stage();
+    } catch (const lex::source_error& error) {
+        const auto file = pipeline.sources.find(error.where());
 
-    if (!file.is_open())
-        throw std::runtime_error("Failed to open file: " + env.input_file);
+        if (!file)
+            throw;
 
-    std::string line;
-    std::ostringstream code_stream;
+        // Only built now, so compiling without errors never scans for line starts
+        const lex::line_table lines { pipeline.sources.buffer(*file) };
+        const auto location = lines.locate(error.where());
 
-    while (!file.eof()){
-        std::getline(file, line);
-        code_stream << line << '\n';
+        throw std::runtime_error(std::format("{}:{}:{}: {}",
+            pipeline.sources.name(*file), location->line, location->column, error.what()));
     }
+}
+
+file_pipeline & file_pipeline::load_file() {
+    const auto file = sources.load(env.input_file);
+
+    if (!file)
+        throw std::runtime_error("Failed to open file: " + env.input_file);
 
-    this->code = code_stream.str();
-    file.close();
+    this->main_file = *file;
+    this->pieces = { { *file, 0, static_cast<uint32_t>(sources.buffer(*file).size()) } };
 
     return *this;
 }
 
 file_pipeline &file_pipeline::pre_process() {
-    pp::preprocess(this->code);
+    with_locations(*this, [this] {
+        pp::macro_table macros;
+
+        for (const auto &definition : env.defines)
+            pp::define_macro(macros, definition);
+
+        auto unit = pp::preprocess(this->main_file, this->sources, this->includes, std::move(macros));
+
+        this->pieces = std::move(unit.pieces);
+
+        for (const auto blob : unit.interfaces)
+            this->interfaces.push_back(sources.buffer(blob));
+    });
 
     return *this;
 }
 
 file_pipeline& file_pipeline::gen_lex() {
-    this->tokens = lex::lex(this->code);
+    with_locations(*this, [this] {
+        std::vector<lex::source_piece> lex_pieces;
+        lex_pieces.reserve(this->pieces.size());
+
+        for (const auto &[file, offset, length] : this->pieces)
+            lex_pieces.push_back({ sources.buffer(file), offset, length });
+
+        // In streaming mode the lexer only starts here, and gen_ast() consumes its output as it is produced.
+        // Chunked lexing works on one contiguous buffer, which is what a file without directives is.
+        if (env.stream_lex)
+            this->token_source = std::make_unique<lex::lex_stream>(std::move(lex_pieces));
+        else if (lex_pieces.size() == 1 && lex_pieces.front().length >= lex::PARALLEL_LEX_THRESHOLD)
+            this->tokens = lex::lex_parallel(lex_pieces.front().text());
+        else
+            this->tokens = lex::lex(lex_pieces);
+    });
+
     return *this;
 }
 
 file_pipeline& file_pipeline::gen_ast() {
-    this->ast = std::make_unique<ast::nodes::root>(ast::parse(this->tokens));
+    with_locations(*this, [this] {
+        // The stream is kept afterwards, since it owns the decoded text of string literals
+        if (this->token_source) {
+            this->ast = std::make_unique<ast::nodes::root>(ast::parse(*this->token_source, this->interfaces));
+        } else if (env.lazy_bodies) {
+            this->ast = std::make_unique<ast::nodes::root>(ast::parse_lazy(this->tokens, this->interfaces));
+        } else {
+            this->ast = std::make_unique<ast::nodes::root>(ast::parse(this->tokens, this->interfaces));
+        }
+    });
+
     return *this;
 }
 
 file_pipeline& file_pipeline::print_ast() {
-    ast->print();
+    if (env.print_flat)
+        ast::flat::print(ast::flat::flatten(*ast));
+    else
+        ast->print();
+
     std::cout.flush();
     return *this;
 }
 
 file_pipeline& file_pipeline::val_ast() {
-    ast::val::validate(*ast);
+    with_locations(*this, [this] { ast::val::validate(*ast); });
     return *this;
 }
 
 #ifdef ENABLE_LLVM
 
 file_pipeline& file_pipeline::gen_llvm() {
-    auto [new_module, new_context] = cg::generate_ir(*ast);
+    // Lazily parsed bodies are only parsed here, so their diagnostics can come from codegen too
+    with_locations(*this, [this] {
+        auto [new_module, new_context] = cg::generate_ir(*ast);
 
-    this->module.swap(new_module);
-    this->context.swap(new_context);
+        this->module.swap(new_module);
+        this->context.swap(new_context);
+    });
 
     return *this;
 }
@@ -10,8 +10,11 @@
 #include <memory>
 
 #include "../lexer/lex.h"
+#include "../lexer/lex_stream.h"
 #include "../ast/data/ast_nodes.h"
 #include "argument_parser.h"
+#include "source_manager.h"
+#include "../preprocess/preprocessor.hpp"
 
 #ifdef ENABLE_LLVM
 #include <llvm/IR/Module.h>
@@ -21,8 +24,15 @@ namespace in {
     struct file_pipeline {
         arg_env env;
 
-        std::string code;
-        std::vector<lex::lex_token> tokens;
+        // Declared before everything that points into the buffers it owns
+        source_manager sources;
+        file_id main_file = 0;
+
+        pp::include_cache includes;
+        pp::piece_table pieces;
+        std::vector<std::string_view> interfaces;
+        lex::token_stream tokens;
+        std::unique_ptr<lex::lex_stream> token_source; // Only set with -stream-lex
         std::unique_ptr<ast::nodes::root> ast;
 
 #ifdef ENABLE_LLVM
@@ -31,7 +41,8 @@ namespace in {
 #endif
 
         file_pipeline(int argc, char** argv)
-            : env(parse_args(argc, argv)) {}
+            : env(parse_args(argc, argv)),
+              includes({ env.include_paths.begin(), env.include_paths.end() }) {}
 
         file_pipeline& load_file();
         file_pipeline& pre_process();
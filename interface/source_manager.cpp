@@ -0,0 +1,153 @@
+#include "source_manager.h"
+
+#include <fstream>
+#include <functional>
+#include <sstream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace in;
+
+// Maps a regular file read-only, or returns nullopt if it cannot be mapped. An empty file maps to an empty view.
+std::optional<std::string_view> map_file(const std::filesystem::path& path) {
+#ifdef _WIN32
+    const HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                    OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+    if (file == INVALID_HANDLE_VALUE)
+        return std::nullopt;
+
+    LARGE_INTEGER size;
+
+    if (!GetFileSizeEx(file, &size) || GetFileType(file) != FILE_TYPE_DISK) {
+        CloseHandle(file);
+        return std::nullopt;
+    }
+
+    if (size.QuadPart == 0) {
+        CloseHandle(file);
+        return std::string_view {};
+    }
+
+    // The view keeps the mapping alive, so neither handle is needed once it exists
+    const HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+
+    if (!mapping)
+        return std::nullopt;
+
+    const void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+
+    if (!view)
+        return std::nullopt;
+
+    return std::string_view { static_cast<const char*>(view), static_cast<size_t>(size.QuadPart) };
+#else
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0)
+        return std::nullopt;
+
+    struct stat info {};
+
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+        close(fd);
+        return std::nullopt;
+    }
+
+    if (info.st_size == 0) {
+        close(fd);
+        return std::string_view {};
+    }
+
+    // The mapping outlives the descriptor
+    void *view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (view == MAP_FAILED)
+        return std::nullopt;
+
+    return std::string_view { static_cast<const char*>(view), static_cast<size_t>(info.st_size) };
+#endif
+}
+
+void unmap_file(const std::string_view text) {
+#ifdef _WIN32
+    UnmapViewOfFile(text.data());
+#else
+    munmap(const_cast<char*>(text.data()), text.size());
+#endif
+}
+
+source_manager::~source_manager() {
+    for (const auto &file : files) {
+        if (file.mapped && !file.text.empty())
+            unmap_file(file.text);
+    }
+}
+
+std::optional<file_id> source_manager::load(const std::filesystem::path& path) {
+    std::error_code error;
+    const auto canonical = std::filesystem::weakly_canonical(path, error).string();
+    const auto key = error ? path.string() : canonical;
+
+    if (const auto existing = loaded.find(key); existing != loaded.end())
+        return existing->second;
+
+    source_file file { path.string() };
+
+    if (const auto mapped = map_file(path)) {
+        file.text = *mapped;
+        file.mapped = true;
+    } else {
+        std::ifstream stream { path, std::ios::binary };
+
+        if (!stream.is_open() || std::filesystem::is_directory(path, error))
+            return std::nullopt;
+
+        std::ostringstream contents;
+        contents << stream.rdbuf();
+
+        file.owned = std::make_unique<std::string>(std::move(contents).str());
+        file.text = *file.owned;
+    }
+
+    const auto id = static_cast<file_id>(files.size());
+
+    files.push_back(std::move(file));
+    loaded.emplace(key, id);
+
+    return id;
+}
+
+file_id source_manager::add_buffer(std::string name, std::string text) {
+    const auto id = static_cast<file_id>(files.size());
+    auto owned = std::make_unique<std::string>(std::move(text));
+    const std::string_view view = *owned;
+
+    files.push_back(source_file { std::move(name), view, std::move(owned) });
+    return id;
+}
+
+std::optional<file_id> source_manager::find(const std::string_view where) const {
+    const std::less_equal<const char*> not_after;
+    const std::less<const char*> before;
+
+    for (file_id id = 0; id < files.size(); id++) {
+        const auto text = files[id].text;
+
+        if (not_after(text.data(), where.data()) && before(where.data(), text.data() + text.size()))
+            return id;
+    }
+
+    return std::nullopt;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace in {
+    using file_id = uint32_t;
+
+    /**
+     *  Source Manager: Owner of Every Source Buffer
+     *  --------------------------------------------
+     *  Maps each file read-only into memory and hands out a file_id for it, so
+     *  tokens and AST nodes can point straight into the mapped pages instead of
+     *  a copy. Buffers built during compilation, such as preprocessed output,
+     *  are registered the same way. Nothing is released before the manager is
+     *  destroyed, so every view it hands out stays valid for the whole compile.
+     *
+     *  Loading the same file twice returns the first mapping. A file that cannot
+     *  be mapped, such as a pipe, is read into memory instead.
+     */
+    class source_manager {
+    public:
+        source_manager() = default;
+        ~source_manager();
+
+        source_manager(const source_manager&) = delete;
+        source_manager& operator=(const source_manager&) = delete;
+
+        // The id of the file at path, mapping it on first use, or nullopt if it cannot be opened
+        std::optional<file_id> load(const std::filesystem::path& path);
+
+        // Takes ownership of a buffer built in memory, named for diagnostics
+        file_id add_buffer(std::string name, std::string text);
+
+        // The file whose buffer where points into, or nullopt if it points anywhere else
+        std::optional<file_id> find(std::string_view where) const;
+
+        std::string_view buffer(const file_id id) const { return files[id].text; }
+        const std::string& name(const file_id id) const { return files[id].name; }
+
+        size_t size() const { return files.size(); }
+
+    private:
+        struct source_file {
+            std::string name;
+            std::string_view text;
+
+            // Set for buffers which were not mapped, which text then points into
+            std::unique_ptr<std::string> owned;
+            bool mapped = false;
+        };
+
+        std::vector<source_file> files;
+        std::unordered_map<std::string, file_id> loaded;
+    };
+}
@@ -1,86 +1,341 @@
 #include "derive_lex.h"
 
+#include <algorithm>
+#include <charconv>
 #include <format>
+#include <memory>
 #include <stdexcept>
 
 #include "lex.h"
+#include "simd_scan.h"
+#include "source_location.h"
+#include "unicode.h"
 
 using namespace lex;
 
-std::optional<lex_token> lex::gen_numeric(const str_ptr start, const str_ptr end) {
-    lex_type type = lex_type::INT_LITERAL;
+// Runs one of the pointer-based scan kernels over an iterator range
+template <typename... Args>
+str_ptr run_kernel(const char* (*kernel)(const char*, const char*, Args...), const str_ptr start, const str_ptr end, Args... args) {
+    const char *base = std::to_address(start);
+    return start + (kernel(base, base + (end - start), args...) - base);
+}
 
-    auto ptr = start;
+derived_lex lex::derive_word(const str_ptr start, const str_ptr end) {
+    auto word_end = std::find_if_not(start, end, is_ident_char);
 
-    if (!isdigit(*ptr))
-        return std::nullopt;
+    // Runs of ASCII stay in the class table, only the non-ASCII characters in between are decoded
+    while (word_end != end && classify(*word_end) == char_class::unicode) {
+        const auto next = decode_utf8(std::to_address(word_end), std::to_address(end));
+
+        if (!next.length || !is_xid_continue(next.value))
+            break;
 
-    for (; ptr != end; ++ptr) {
-        if (*ptr == '.' && type == lex_type::INT_LITERAL)
-            type = lex_type::FLOAT_LITERAL;
-        else if (!isdigit(*ptr))
-            throw std::runtime_error(std::format("Invalid numerical literal: {}", std::string_view { ptr, end }));
+        word_end = std::find_if_not(word_end + next.length, end, is_ident_char);
     }
 
-    return lex_token { type, { start, end } };
+    const std::string_view word { start, word_end };
+
+    if (auto id = WORD_MAP.find(word))
+        return derived_lex { token_type(*id), word, word_end, *id };
+
+    return derived_lex { lex_type::IDENTIFIER, word, word_end };
 }
 
-std::optional<derived_lex> lex::derive_strlit(const str_ptr start, const str_ptr end) {
-    if (*start != '\"')
-        return std::nullopt;
+derived_lex lex::derive_numeric(const str_ptr start, const str_ptr end) {
+    const auto is_digit = [](const char c) { return classify(c) == char_class::digit; };
+    const auto is_exponent = [](const char c) { return c == 'e' || c == 'E'; };
 
-    auto find = start + 1;
+    // Digits, a base prefix and a type suffix are all word characters. Non-ASCII ones are kept
+    // too, so that they are reported as a bad suffix rather than silently starting a new token.
+    const auto is_word_char = [](const char c) { return is_ident_char(c) || classify(c) == char_class::unicode; };
+    auto ptr = std::find_if_not(start, end, is_word_char);
 
-    // stop when find == '\"' and find[-1] != '\\'
-    // or continue when find != '\"' or find[-1] == '\\'
+    if (radix_of({ start, ptr }) == 10) {
+        if (ptr != end && *ptr == '.' && ptr + 1 != end && is_digit(ptr[1]))
+            ptr = std::find_if_not(ptr + 1, end, is_word_char);
 
-    while (find != end && (*find != '\"' || find[-1] == '\\'))
-        ++find;
+        if (is_exponent(ptr[-1]) && end - ptr > 1 && (*ptr == '+' || *ptr == '-') && is_digit(ptr[1]))
+            ptr = std::find_if_not(ptr + 1, end, is_word_char);
+    }
 
-    if (find == end)
-        throw std::runtime_error("Unterminated string literal");
+    if (ptr != end && *ptr == '.') {
+        const std::string_view literal { start, std::find_if_not(ptr + 1, end, is_word_char) };
+        throw source_error(std::format("Invalid numerical literal: {}", literal), literal);
+    }
 
-    return derived_lex { lex_type::STRING_LITERAL, start + 1, find, 1 };
+    const std::string_view text { start, ptr };
+    auto literal = decode_numeric(text);
+    const auto type = std::holds_alternative<double>(literal.value) ? lex_type::FLOAT_LITERAL : lex_type::INT_LITERAL;
+
+    return derived_lex { type, text, ptr, token_id::none, literal };
 }
 
-std::optional<derived_lex> lex::derive_charlit(const str_ptr start, const str_ptr end) {
-    if (*start != '\'')
-        return std::nullopt;
+uint32_t lex::radix_of(const std::string_view text) {
+    if (text.size() <= 2 || text[0] != '0')
+        return 10;
 
-    const bool is_escaped = start[1] == '\\';
-    const auto expected_end = 2 + is_escaped;
+    switch (text[1]) {
+        case 'x': case 'X':
+            return 16;
+        case 'o': case 'O':
+            return 8;
+        case 'b': case 'B':
+            return 2;
+        default:
+            return 10;
+    }
+}
+
+literal_value lex::decode_numeric(const std::string_view text) {
+    const auto invalid = [text](const std::string_view reason = "") {
+        return source_error(std::format("Invalid numerical literal: {}{}", text, reason), text);
+    };
+
+    const auto radix = radix_of(text);
+    const char *first = text.data() + (radix == 10 ? 0 : 2);
+    const char *last = text.data() + text.size();
+
+    literal_value literal {};
+    auto &integer = std::get<uint64_t>(literal.value);
+    auto [digits_end, error] = std::from_chars(first, last, integer, static_cast<int>(radix));
+
+    if (error != std::errc {} && error != std::errc::result_out_of_range)
+        throw invalid();
+
+    // Too many digits for 64 bits is only an error once the literal turns out to be an integer
+    const auto check_fits = [&, out_of_range = error == std::errc::result_out_of_range] {
+        if (out_of_range)
+            throw invalid(", does not fit in 64 bits");
+    };
+
+    const bool is_float = radix == 10 && digits_end != last && (*digits_end == '.' || *digits_end == 'e' || *digits_end == 'E');
+    const auto parse_float = [&] {
+        auto &floating = literal.value.emplace<double>();
+        const auto [float_end, float_error] = std::from_chars(first, last, floating);
+
+        if (float_error != std::errc {})
+            throw invalid();
 
-    if (end - start < 2 || start[expected_end] != '\'')
-        throw std::runtime_error("Unclosed or invalid character literal");
+        digits_end = float_end;
+    };
 
-    return derived_lex { lex_type::CHAR_LITERAL, start + 1, start + expected_end, 1 };
+    if (is_float)
+        parse_float();
+
+    const std::string_view suffix_text { digits_end, last };
+
+    if (suffix_text.empty()) {
+        if (!is_float)
+            check_fits();
+
+        return literal;
+    }
+
+    const auto suffix = WORD_MAP.find(suffix_text);
+
+    if (!suffix || primitive_bits(*suffix) == 0)
+        throw invalid(std::format(", unknown suffix {}", suffix_text));
+
+    literal.suffix = *suffix;
+
+    if (*suffix == token_id::f32 || *suffix == token_id::f64) {
+        if (radix != 10)
+            throw invalid(", only decimal literals can be floats");
+
+        if (!is_float)
+            parse_float();
+
+        return literal;
+    }
+
+    if (is_float)
+        throw invalid(std::format(", a float cannot have suffix {}", suffix_text));
+
+    check_fits();
+
+    // Signed literals may reach 2^(N-1) so that the most negative value can be negated into range
+    const auto bits = primitive_bits(*suffix);
+    const bool is_signed = *suffix < token_id::u8;
+    const auto max = bits == 64 ? (is_signed ? uint64_t { 1 } << 63 : UINT64_MAX)
+                                : (uint64_t { 1 } << (bits - is_signed)) - !is_signed;
+
+    if (integer > max)
+        throw invalid(std::format(", does not fit in {}", suffix_text));
+
+    return literal;
 }
 
-std::optional<derived_lex> lex::derive_expr_op(const str_ptr start, const str_ptr end) {
-    for (auto i = 3; i >= 0; i--) {
-        if (end - start > i && EXPR_SYMBOL.contains({ start, start + i }))
-            return derived_lex { lex_type::EXPR_SYMBOL, start, start + i };
+derived_lex lex::derive_strlit(const str_ptr start, const str_ptr end) {
+    const auto find = run_kernel(simd::find_string_end, start + 1, end);
 
-        if (end - start > i && ASSN_SYMBOL.contains({ start, start + i }))
-            return derived_lex { lex_type::ASSN_SYMBOL, start, start + i };
+    if (find == end)
+        throw source_error("Unterminated string literal", { start, start + 1 });
+
+    return derived_lex { lex_type::STRING_LITERAL, { start + 1, find }, find + 1 };
+}
+
+derived_lex lex::derive_charlit(const str_ptr start, const str_ptr end) {
+    const bool is_escaped = end - start > 1 && start[1] == '\\';
+    const auto expected_end = 2 + is_escaped;
+
+    if (end - start <= expected_end || start[expected_end] != '\'')
+        throw source_error("Unclosed or invalid character literal", { start, start + 1 });
+
+    auto value = start[1];
+
+    if (is_escaped) {
+        const auto escaped = escape_char(start[2]);
+
+        if (!escaped)
+            throw source_error(std::format("Invalid escape sequence: \\{}", start[2]), { start + 1, start + 3 });
+
+        value = *escaped;
     }
 
-    return std::nullopt;
+    return derived_lex {
+        lex_type::CHAR_LITERAL, { start + 1, start + expected_end }, start + expected_end + 1,
+        token_id::none, literal_value { value }
+    };
 }
 
-std::optional<derived_lex> lex::derive_assn_op(const str_ptr start, const str_ptr end) {
-    if (end - start > 2 && ASSN_SYMBOL.contains({ start, start + 2 })) {
-        return derived_lex { lex_type::ASSN_SYMBOL, start, start + 2 };
-    } else if (ASSN_SYMBOL.contains({ start, start + 1 })) {
-        return derived_lex { lex_type::ASSN_SYMBOL, start, start + 1 };
+decoded_string lex::decode_string(const std::string_view raw, std::string& into) {
+    const auto offset = static_cast<uint32_t>(into.size());
+
+    for (size_t i = 0; i < raw.size(); i++) {
+        const auto escape = raw.find('\\', i);
+
+        into.append(raw.substr(i, escape - i));
+
+        if (escape == std::string_view::npos)
+            break;
+
+        // The scanner never ends a string on a backslash, so one more character always follows
+        const auto escaped = escape_char(raw[escape + 1]);
+
+        if (!escaped)
+            throw source_error(std::format("Invalid escape sequence: \\{}", raw[escape + 1]), raw.substr(escape, 2));
+
+        into.push_back(*escaped);
+        i = escape + 1;
     }
 
-    return std::nullopt;
+    return decoded_string { offset, static_cast<uint32_t>(into.size() - offset) };
+}
+
+std::optional<char> lex::escape_char(const char c) {
+    switch (c) {
+        case 'n':
+            return '\n';
+        case 't':
+            return '\t';
+        case 'r':
+            return '\r';
+        case '0':
+            return '\0';
+        case 'a':
+            return '\a';
+        case 'b':
+            return '\b';
+        case 'f':
+            return '\f';
+        case 'v':
+            return '\v';
+        case '\\':
+            return '\\';
+        case '\'':
+            return '\'';
+        case '\"':
+            return '\"';
+        default:
+            return std::nullopt;
+    }
 }
 
-std::optional<derived_lex> lex::derive_punctuator(const str_ptr start, const str_ptr) {
-    if (!PUNCTUATOR_SET.contains(*start))
+std::optional<derived_lex> lex::derive_symbol(const str_ptr start, const str_ptr end) {
+    uint8_t state = 0;
+    auto accepted = start;
+    auto id = token_id::none;
+
+    for (auto ptr = start; ptr != end; ++ptr) {
+        if (!(state = SYMBOL_TRIE.step(state, *ptr)))
+            break;
+
+        if (SYMBOL_TRIE.accepting[state] != token_id::none) {
+            id = SYMBOL_TRIE.accepting[state];
+            accepted = ptr + 1;
+        }
+    }
+
+    if (id == token_id::none)
         return std::nullopt;
 
-    return derived_lex { lex_type::PUNCTUATOR, start, start + 1 };
-}
\ No newline at end of file
+    return derived_lex { token_type(id), { start, accepted }, accepted, id };
+}
+
+str_ptr lex::skip_whitespace(const str_ptr start, const str_ptr end) {
+    // Most runs are a single space, which is not worth a trip through the kernel
+    if (start == end || classify(*start) != char_class::whitespace)
+        return start;
+
+    return run_kernel(simd::skip_whitespace, start, end);
+}
+
+str_ptr lex::skip_line_comment(const str_ptr start, const str_ptr end) {
+    return run_kernel(simd::find_char, start, end, '\n');
+}
+
+str_ptr lex::skip_block_comment(const str_ptr start, const str_ptr end) {
+    // An unterminated block comment runs to the end of the file
+    return run_kernel(simd::skip_block_comment, start, end);
+}
+
+std::optional<derived_lex> lex::derive_next(str_ptr& ptr, const str_ptr end) {
+    while (ptr != end) {
+        switch (classify(*ptr)) {
+            case char_class::whitespace:
+                ptr = skip_whitespace(ptr + 1, end);
+                continue;
+
+            case char_class::slash:
+                if (ptr + 1 != end && ptr[1] == '/') {
+                    ptr = skip_line_comment(ptr + 2, end);
+                    continue;
+                }
+
+                if (ptr + 1 != end && ptr[1] == '*') {
+                    ptr = skip_block_comment(ptr + 2, end);
+                    continue;
+                }
+
+                [[fallthrough]];
+            case char_class::symbol:
+                return *derive_symbol(ptr, end);
+
+            case char_class::ident:
+                return derive_word(ptr, end);
+            case char_class::digit:
+                return derive_numeric(ptr, end);
+            case char_class::str_quote:
+                return derive_strlit(ptr, end);
+            case char_class::char_quote:
+                return derive_charlit(ptr, end);
+
+            case char_class::unicode: {
+                const auto next = decode_utf8(std::to_address(ptr), std::to_address(end));
+
+                if (!next.length)
+                    throw source_error(std::format("Invalid UTF-8 byte: 0x{:02X}", static_cast<uint8_t>(*ptr)), { ptr, ptr + 1 });
+                if (is_xid_start(next.value))
+                    return derive_word(ptr, end);
+
+                throw source_error(std::format("Unexpected character: U+{:04X}", static_cast<uint32_t>(next.value)),
+                                   { ptr, ptr + next.length });
+            }
+
+            case char_class::invalid:
+                throw source_error(std::format("Unexpected character: '{}'", *ptr), { ptr, ptr + 1 });
+        }
+    }
+
+    return std::nullopt;
+}
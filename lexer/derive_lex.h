@@ -1,30 +1,169 @@
 #pragma once
+#include <array>
+#include <cstdint>
 #include <optional>
+#include <span>
 #include <string_view>
+#include <vector>
 
 #include "lex.h"
 
 namespace lex {
-    struct lex_token;
-    enum class lex_type;
+    enum class char_class : uint8_t {
+        invalid,
+        whitespace,
+        ident, // a-z, A-Z, _
+        digit,
+        unicode, // Any non-ASCII byte, which is decoded to see whether it starts an identifier
+        str_quote, char_quote,
+        slash, // Either a symbol or the start of a comment
+        symbol
+    };
+
+    inline constexpr auto CHAR_CLASSES = [] {
+        std::array<char_class, 256> classes {};
+
+        for (const char c : std::string_view { " \t\r\n\v\f", 6 })
+            classes[static_cast<uint8_t>(c)] = char_class::whitespace;
+        classes['\0'] = char_class::whitespace;
+
+        for (int c = 'a'; c <= 'z'; c++)
+            classes[c] = classes[c - 'a' + 'A'] = char_class::ident;
+        for (int c = 0x80; c <= 0xFF; c++)
+            classes[c] = char_class::unicode;
+        classes['_'] = char_class::ident;
+
+        for (int c = '0'; c <= '9'; c++)
+            classes[c] = char_class::digit;
+
+        for (const auto &table : { std::span<const token_spelling> { EXPR_SYMBOLS },
+                                   std::span<const token_spelling> { ASSN_SYMBOLS },
+                                   std::span<const token_spelling> { PUNCTUATORS } }) {
+            for (const auto &entry : table)
+                classes[static_cast<uint8_t>(entry.text.front())] = char_class::symbol;
+        }
+
+        classes['/'] = char_class::slash;
+        classes['\"'] = char_class::str_quote;
+        classes['\''] = char_class::char_quote;
+
+        return classes;
+    }();
+
+    constexpr char_class classify(const char c) {
+        return CHAR_CLASSES[static_cast<uint8_t>(c)];
+    }
+
+    // ASCII identifier characters only, non-ASCII ones have to be decoded first
+    constexpr bool is_ident_char(const char c) {
+        const auto cls = classify(c);
+        return cls == char_class::ident || cls == char_class::digit;
+    }
+
+    /**
+     *  Symbol Trie: Compile-Time DFA
+     *  -----------------------------
+     *  Every symbol the lexer recognizes is folded into a trie, with the characters
+     *  that may appear in a symbol compressed into a small set of columns. Walking
+     *  the trie one character at a time and remembering the last accepting state
+     *  yields the maximal munch without ever building or hashing a substring.
+     */
+    struct symbol_trie {
+        static constexpr size_t max_states = 64;
+        static constexpr size_t max_columns = 32;
+
+        std::array<uint8_t, 128> columns {};
+        std::array<std::array<uint8_t, max_columns>, max_states> transitions {};
+        std::array<token_id, max_states> accepting {};
+
+        constexpr symbol_trie() {
+            uint8_t column_count = 0, state_count = 0;
+
+            for (const auto &table : { std::span<const token_spelling> { EXPR_SYMBOLS },
+                                       std::span<const token_spelling> { ASSN_SYMBOLS },
+                                       std::span<const token_spelling> { PUNCTUATORS } }) {
+                for (const auto &[text, id] : table) {
+                    uint8_t state = 0;
+
+                    for (const char c : text) {
+                        auto &column = columns[static_cast<uint8_t>(c)];
+
+                        if (!column)
+                            column = ++column_count;
+
+                        auto &next = transitions[state][column];
+
+                        if (!next)
+                            next = ++state_count;
+
+                        state = next;
+                    }
+
+                    accepting[state] = id;
+                }
+            }
+
+            if (column_count >= max_columns || state_count >= max_states)
+                throw "Symbol trie capacity exceeded";
+        }
+
+        constexpr uint8_t step(const uint8_t state, const char c) const {
+            if (static_cast<uint8_t>(c) >= columns.size())
+                return 0;
+
+            return transitions[state][columns[static_cast<uint8_t>(c)]];
+        }
+    };
+
+    inline constexpr symbol_trie SYMBOL_TRIE {};
 
     struct derived_lex {
-        lex_type type;
+        lex_type type {};
         std::string_view span;
+
+        // First character after the token, including any closing quotes
         str_ptr end;
+        token_id id = token_id::none;
 
-        derived_lex(const lex_type type, str_ptr start, str_ptr end, const ptrdiff_t skip_chars = 0)
-            : type(type), span(start, end), end(end + skip_chars - 1) { }
+        // Set for numeric and character literals, which are decoded as they are scanned
+        std::optional<literal_value> literal;
     };
 
-    std::optional<derived_lex> derive_strlit(str_ptr start, str_ptr end);
-    std::optional<derived_lex> derive_charlit(str_ptr start, str_ptr end);
+    derived_lex derive_word(str_ptr start, str_ptr end);
+    derived_lex derive_numeric(str_ptr start, str_ptr end);
+    derived_lex derive_strlit(str_ptr start, str_ptr end);
+    derived_lex derive_charlit(str_ptr start, str_ptr end);
+    std::optional<derived_lex> derive_symbol(str_ptr start, str_ptr end);
+
+    // Skips whitespace and comments, leaving ptr on the first character of the next token
+    std::optional<derived_lex> derive_next(str_ptr& ptr, str_ptr end);
+
+    // The scanner may read this many characters past the end of a token to decide where it ends,
+    // e.g. ".." is only known to be "." "." after seeing that no third '.' follows
+    inline constexpr uint32_t MAX_LOOKAHEAD = 2;
+
+    // Pushes a derived token, recording its decoded value if it is a literal
+    uint32_t emit_token(token_stream& tokens, const derived_lex& derived);
+
+    // Links an opening punctuator to its closer as soon as the closer is pushed
+    void connect_punctuator(token_stream& tokens, std::vector<uint32_t>& openers, uint32_t index);
+
+    // Links every bracket in tokens in one pass, for streams built without connect_punctuator
+    void connect_punctuators(token_stream& tokens);
+
+    str_ptr skip_whitespace(str_ptr start, str_ptr end);
+    str_ptr skip_line_comment(str_ptr start, str_ptr end);
+    str_ptr skip_block_comment(str_ptr start, str_ptr end);
+
+    // Base of a numeric literal from its 0x, 0o or 0b prefix
+    uint32_t radix_of(std::string_view text);
 
-    char escape_char(char c);
+    // Decodes the text of a numeric literal, including its base prefix and type suffix
+    literal_value decode_numeric(std::string_view text);
 
-    std::optional<lex_token> gen_numeric(const str_ptr start, const str_ptr end);
+    // Appends the escape-processed contents of a string literal to into
+    decoded_string decode_string(std::string_view raw, std::string& into);
 
-    std::optional<derived_lex> derive_expr_op(str_ptr start, str_ptr end);
-    std::optional<derived_lex> derive_assn_op(str_ptr start, str_ptr end);
-    std::optional<derived_lex> derive_punctuator(str_ptr start, str_ptr end);
+    // The character a backslash followed by c stands for, or nullopt if it is not an escape
+    std::optional<char> escape_char(char c);
 }
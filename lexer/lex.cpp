@@ -2,117 +2,157 @@
 
 #include <algorithm>
 #include <format>
-#include <stack>
+#include <stdexcept>
 
 #include "derive_lex.h"
+#include "source_location.h"
+#include "unicode.h"
 
 using namespace lex;
 
-std::optional<derived_lex> derive(const str_ptr start, const str_ptr end) {
-    const auto try_derive = [start, end](auto fn) {
-        return [start, end, fn] { return fn(start, end); };
-    };
+void token_stream::reserve(const size_t count) {
+    types.reserve(count);
+    ids.reserve(count);
+    files.reserve(count);
+    offsets.reserve(count);
+    lengths.reserve(count);
+    payloads.reserve(count);
+}
+
+uint32_t token_stream::push(const lex_type type, const token_id id, const std::string_view span) {
+    const auto index = static_cast<uint32_t>(size());
+
+    types.push_back(type);
+    ids.push_back(id);
+    files.push_back(active_source);
+    offsets.push_back(static_cast<uint32_t>(span.data() - sources[active_source].data()));
+    lengths.push_back(static_cast<uint32_t>(span.size()));
+    payloads.push_back(no_payload);
+
+    return index;
+}
+
+void token_stream::select_source(const std::string_view buffer) {
+    if (buffer.size() >= no_payload)
+        throw std::runtime_error("Source file is too large to lex");
+
+    const auto existing = std::ranges::find_if(sources, [buffer](const std::string_view source) {
+        return source.data() == buffer.data() && source.size() == buffer.size();
+    });
+
+    if (existing == sources.end() && sources.size() > UINT16_MAX)
+        throw std::runtime_error("Too many source buffers in one token stream");
 
-    return derive_expr_op(start, end)
-        .or_else(try_derive(derive_punctuator))
-        .or_else(try_derive(derive_charlit))
-        .or_else(try_derive(derive_strlit));
+    active_source = static_cast<uint16_t>(existing - sources.begin());
+
+    if (existing == sources.end())
+        sources.push_back(buffer);
 }
 
-void output_buffer(const auto buffer_start, const auto buffer_end, std::vector<lex_token>& tokens) {
-    if (buffer_start == buffer_end)
-        return;
+uint32_t lex::emit_token(token_stream& tokens, const derived_lex& derived) {
+    const auto index = tokens.push(derived.type, derived.id, derived.span);
 
-    const auto shaved_start = std::find_if_not(buffer_start, buffer_end, iswspace);
-    const std::string_view shaved_buffer = { shaved_start, buffer_end };
+    if (derived.literal) {
+        tokens.payloads[index] = static_cast<uint32_t>(tokens.literals.size());
+        tokens.literals.push_back(*derived.literal);
+    } else if (derived.type == lex_type::STRING_LITERAL && derived.span.contains('\\')) {
+        if (!tokens.decoded)
+            tokens.decoded = std::make_shared<std::string>();
 
-    if (shaved_buffer.empty())
-        return;
+        tokens.payloads[index] = static_cast<uint32_t>(tokens.literals.size());
+        tokens.literals.push_back(literal_value { decode_string(derived.span, *tokens.decoded) });
+    }
 
-    if (auto numeric = gen_numeric(shaved_start, buffer_end))
-        tokens.push_back(*numeric);
-    else if (KEYWORD_SET.contains(shaved_buffer))
-        tokens.emplace_back(lex_type::KEYWORD, shaved_buffer);
-    else if (PRIMITIVES_SET.contains(shaved_buffer))
-        tokens.emplace_back(lex_type::PRIMITIVE, shaved_buffer);
-    else
-        tokens.emplace_back(lex_type::IDENTIFIER, shaved_buffer);
+    return index;
 }
 
-void connect_punctuators(std::vector<lex_token>& tokens) {
-    std::stack<lex_ptr> stack;
-
-    const auto punc_assert = [](const lex_ptr token, const std::string_view val) {
-        if (token->span != val)
-            throw std::runtime_error("Mismatched punctuators");
-    };
-
-    for (auto ptr = tokens.begin(); ptr != tokens.end(); ++ptr) {
-        if (ptr->type != lex_type::PUNCTUATOR)
-            continue;
-
-        switch (ptr->span.front()) {
-            case '{':
-            case '(':
-            case '[':
-                stack.emplace(ptr);
-                continue;
-            case '}':
-                punc_assert(stack.top(), "{");
-                break;
-            case ')':
-                punc_assert(stack.top(), "(");
-                break;
-            case ']':
-                punc_assert(stack.top(), "[");
-                break;
-            default:
-                throw std::runtime_error(std::format("Invalid Punctuator: {}", ptr->span));
-        }
-
-        stack.top()->closer = ptr;
-        stack.pop();
+void lex::connect_punctuator(token_stream& tokens, std::vector<uint32_t>& openers, const uint32_t index) {
+    token_id expected;
+
+    switch (tokens.ids[index]) {
+        case token_id::l_brace:
+        case token_id::l_paren:
+        case token_id::l_bracket:
+            openers.push_back(index);
+            return;
+        case token_id::r_brace:
+            expected = token_id::l_brace;
+            break;
+        case token_id::r_paren:
+            expected = token_id::l_paren;
+            break;
+        case token_id::r_bracket:
+            expected = token_id::l_bracket;
+            break;
+        default:
+            throw source_error(std::format("Invalid Punctuator: {}", tokens.span(index)), tokens.span(index));
     }
+
+    if (openers.empty() || tokens.ids[openers.back()] != expected)
+        throw source_error("Mismatched punctuators", tokens.span(index));
+
+    tokens.payloads[openers.back()] = index;
+    openers.pop_back();
 }
 
-std::vector<lex_token> lex::lex(const std::string_view code) {
-    std::vector<lex_token> tokens;
-    auto buffer_start = code.cbegin();
-    const auto end = std::cend(code);
-
-    for (auto ptr = std::cbegin(code); ptr != end; ++ptr) {
-        if (*ptr == ' ' || *ptr == '\n' || *ptr == '\0') {
-            output_buffer(buffer_start, ptr, tokens);
-            buffer_start = ptr + 1;
-        }
-
-        // Comments
-        else if (*ptr == '/' && *(ptr + 1) == '/') {
-            output_buffer(buffer_start, ptr, tokens);
-            buffer_start = std::find(ptr, end, '\n');
-            ptr = buffer_start;
-        }
-
-        else if (*ptr == '/' && *(ptr + 1) == '*') {
-            output_buffer(buffer_start, ptr, tokens);
-            while (ptr++ != end - 2 && (*ptr != '*' || *(ptr + 1) != '/')) {}
-            buffer_start = ptr + 2;
-            ptr += 2;
-        }
-
-        else if (const auto derived = derive(ptr, std::cend(code))) {
-            output_buffer(buffer_start, ptr, tokens);
-
-            tokens.emplace_back(derived->type, derived->span);
-            ptr = derived->end;
-            buffer_start = ptr + 1;
-        }
+void lex::connect_punctuators(token_stream& tokens) {
+    std::vector<uint32_t> openers;
+
+    for (uint32_t i = 0; i < tokens.size(); ++i) {
+        if (tokens.types[i] == lex_type::PUNCTUATOR)
+            connect_punctuator(tokens, openers, i);
     }
+}
+
+// Lexes [ptr, end) into tokens, keeping the brackets still open in openers so a later range can close them.
+// With stop_at_boundary it stops after the first ';' or '}' which leaves every bracket closed, and says whether it did.
+bool lex_range(token_stream& tokens, std::vector<uint32_t>& openers, str_ptr& ptr, const str_ptr end, const bool stop_at_boundary) {
+    while (const auto derived = derive_next(ptr, end)) {
+        const auto index = emit_token(tokens, *derived);
+
+        if (derived->type == lex_type::PUNCTUATOR)
+            connect_punctuator(tokens, openers, index);
 
-    output_buffer(buffer_start, end, tokens);
+        ptr = derived->end;
 
-    // TODO: If performance is bad, this can be done in the loop above to avoid the extra iteration
-    connect_punctuators(tokens);
+        if (stop_at_boundary && openers.empty() &&
+            (derived->id == token_id::semicolon || derived->id == token_id::r_brace))
+            return true;
+    }
+
+    return false;
+}
+
+bool lex::lex_declaration(token_stream& tokens, std::vector<uint32_t>& openers, str_ptr& ptr, const str_ptr end) {
+    return lex_range(tokens, openers, ptr, end, true);
+}
+
+token_stream lex::lex(const std::string_view code) {
+    const source_piece whole { code, 0, static_cast<uint32_t>(std::min<size_t>(code.size(), token_stream::no_payload)) };
+    return lex(std::span { &whole, 1 });
+}
+
+token_stream lex::lex(const std::span<const source_piece> pieces) {
+    token_stream tokens;
+    size_t size = 0;
+
+    for (const auto &piece : pieces) {
+        validate_utf8(piece.text());
+        size += piece.length;
+    }
+
+    // Roughly one token for every four bytes of source, so the arrays rarely need to grow
+    tokens.reserve(size / 4);
+
+    std::vector<uint32_t> openers;
+
+    for (const auto &piece : pieces) {
+        const auto text = piece.text();
+        auto ptr = text.cbegin();
+
+        tokens.select_source(piece.buffer);
+        lex_range(tokens, openers, ptr, text.cend(), false);
+    }
 
     return tokens;
 }
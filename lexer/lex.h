@@ -1,19 +1,27 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <compare>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <string>
 #include <string_view>
 #include <optional>
-#include <unordered_set>
+#include <span>
+#include <variant>
 #include <vector>
 
-namespace lex {
-    struct lex_token;
+#include "perfect_hash.h"
 
-    using lex_container = std::vector<lex_token>;
+namespace lex {
+    struct token_stream;
+    struct literal_value;
 
     using str_ptr = std::string_view::const_iterator;
-    using lex_ptr = lex_container::iterator;
 
-    enum class lex_type {
+    enum class lex_type : uint8_t {
         KEYWORD, // if, while, for, etc.
         PRIMITIVE, // i8, i16, i32, etc.
         IDENTIFIER, // Variable name, function name, etc.
@@ -23,60 +31,393 @@ namespace lex {
         PUNCTUATOR
     };
 
-    struct lex_token {
-        lex_type type;
-        std::string_view span;
+    // Dense identifier for every fixed spelling the lexer recognizes, ordered by lex_type
+    // so that the type of a token can be derived from its id with a range check.
+    enum class token_id : uint8_t {
+        none,
+
+        if_, while_, for_, switch_, else_, do_,
+        mut, extern_, volatile_,
+        fn, libc,
+        struct_,
+        match, case_, default_,
+        as,
+        return_,
+
+        i8, i16, i32, i64,
+        u8, u16, u32, u64,
+        f32, f64,
+        bool_, char_, void_,
+
+        plus, minus, star, slash, percent,
+        bang, amp, pipe, caret, tilde, lt, gt, question, colon,
+        shl, shr,
+        comma, hash, semicolon,
+        dot, arrow,
+        eq_eq, bang_eq, lt_eq, gt_eq, amp_amp, pipe_pipe,
+        plus_plus, minus_minus,
+        ellipsis,
+
+        assign, plus_assign, minus_assign, star_assign, slash_assign, percent_assign,
+        amp_assign, pipe_assign, caret_assign,
+
+        l_brace, r_brace, l_paren, r_paren, l_bracket, r_bracket,
 
-        std::optional<lex_ptr> closer;
+        count
     };
 
-    inline std::unordered_set<std::string_view> KEYWORD_SET {
-        "if", "while", "for", "switch",
+    using token_spelling = spelling_entry<token_id>;
 
-        "mut", "extern", "volatile",
+    inline constexpr std::array KEYWORDS {
+        token_spelling { "if", token_id::if_ }, token_spelling { "while", token_id::while_ },
+        token_spelling { "for", token_id::for_ }, token_spelling { "switch", token_id::switch_ },
+        token_spelling { "else", token_id::else_ }, token_spelling { "do", token_id::do_ },
 
-        "fn",
+        token_spelling { "mut", token_id::mut }, token_spelling { "extern", token_id::extern_ },
+        token_spelling { "volatile", token_id::volatile_ },
 
-        "struct",
+        token_spelling { "fn", token_id::fn }, token_spelling { "_libc", token_id::libc },
 
-        "match", "case", "default",
+        token_spelling { "struct", token_id::struct_ },
 
-        "as",
+        token_spelling { "match", token_id::match }, token_spelling { "case", token_id::case_ },
+        token_spelling { "default", token_id::default_ },
 
-        "return"
+        token_spelling { "as", token_id::as },
+
+        token_spelling { "return", token_id::return_ }
     };
 
-    inline std::unordered_set<std::string_view> PRIMITIVES_SET {
-        "i8", "i16", "i32", "i64",
-        "u8", "u16", "u32", "u64",
-        "f32", "f64",
+    inline constexpr std::array PRIMITIVES {
+        token_spelling { "i8", token_id::i8 }, token_spelling { "i16", token_id::i16 },
+        token_spelling { "i32", token_id::i32 }, token_spelling { "i64", token_id::i64 },
+        token_spelling { "u8", token_id::u8 }, token_spelling { "u16", token_id::u16 },
+        token_spelling { "u32", token_id::u32 }, token_spelling { "u64", token_id::u64 },
+        token_spelling { "f32", token_id::f32 }, token_spelling { "f64", token_id::f64 },
 
-        "bool", "char", "void",
+        token_spelling { "bool", token_id::bool_ }, token_spelling { "char", token_id::char_ },
+        token_spelling { "void", token_id::void_ }
     };
 
-    inline std::unordered_set<std::string_view> EXPR_SYMBOL {
-        "+", "-", "*", "/", "%",
-        "!", "&", "|", "^", "~", "<", ">", "?", ":",
-        "<<", ">>",
+    inline constexpr std::array EXPR_SYMBOLS {
+        token_spelling { "+", token_id::plus }, token_spelling { "-", token_id::minus },
+        token_spelling { "*", token_id::star }, token_spelling { "/", token_id::slash },
+        token_spelling { "%", token_id::percent },
+        token_spelling { "!", token_id::bang }, token_spelling { "&", token_id::amp },
+        token_spelling { "|", token_id::pipe }, token_spelling { "^", token_id::caret },
+        token_spelling { "~", token_id::tilde }, token_spelling { "<", token_id::lt },
+        token_spelling { ">", token_id::gt }, token_spelling { "?", token_id::question },
+        token_spelling { ":", token_id::colon },
+        token_spelling { "<<", token_id::shl }, token_spelling { ">>", token_id::shr },
+
+        token_spelling { ",", token_id::comma }, token_spelling { "#", token_id::hash },
+        token_spelling { ";", token_id::semicolon },
 
-        ",", "#", ";",
+        token_spelling { ".", token_id::dot }, token_spelling { "->", token_id::arrow },
 
-        ".", "->",
+        token_spelling { "==", token_id::eq_eq }, token_spelling { "!=", token_id::bang_eq },
+        token_spelling { "<=", token_id::lt_eq }, token_spelling { ">=", token_id::gt_eq },
+        token_spelling { "&&", token_id::amp_amp }, token_spelling { "||", token_id::pipe_pipe },
+        token_spelling { "++", token_id::plus_plus }, token_spelling { "--", token_id::minus_minus },
 
-        "==", "!=", "<=", ">=", "&&", "||",
-        "++", "--",
+        token_spelling { "...", token_id::ellipsis }
+    };
+
+    inline constexpr std::array ASSN_SYMBOLS {
+        token_spelling { "=", token_id::assign }, token_spelling { "+=", token_id::plus_assign },
+        token_spelling { "-=", token_id::minus_assign }, token_spelling { "*=", token_id::star_assign },
+        token_spelling { "/=", token_id::slash_assign }, token_spelling { "%=", token_id::percent_assign },
+        token_spelling { "&=", token_id::amp_assign }, token_spelling { "|=", token_id::pipe_assign },
+        token_spelling { "^=", token_id::caret_assign },
+    };
 
-        "..."
+    inline constexpr std::array PUNCTUATORS {
+        token_spelling { "{", token_id::l_brace }, token_spelling { "}", token_id::r_brace },
+        token_spelling { "(", token_id::l_paren }, token_spelling { ")", token_id::r_paren },
+        token_spelling { "[", token_id::l_bracket }, token_spelling { "]", token_id::r_bracket }
     };
 
-    inline std::unordered_set<std::string_view> ASSN_SYMBOL = {
-        "=", "+=", "-=", "*=", "/=", "%=",
-        "&=", "|=", "^=",
+    template <size_t... N>
+    constexpr auto concat_spellings(const std::array<token_spelling, N>&... tables) {
+        std::array<token_spelling, (N + ...)> out {};
+        size_t i = 0;
+
+        ((std::ranges::copy(tables, out.begin() + i), i += N), ...);
+
+        return out;
+    }
+
+    // Symbols are matched by the scanner's trie, so only identifier-like spellings need hashing
+    inline constexpr perfect_hash_map WORD_MAP { concat_spellings(KEYWORDS, PRIMITIVES) };
+
+    constexpr lex_type token_type(const token_id id) {
+        if (id < token_id::i8)
+            return lex_type::KEYWORD;
+        if (id < token_id::plus)
+            return lex_type::PRIMITIVE;
+        if (id < token_id::assign)
+            return lex_type::EXPR_SYMBOL;
+        if (id < token_id::l_brace)
+            return lex_type::ASSN_SYMBOL;
+
+        return lex_type::PUNCTUATOR;
+    }
+
+    constexpr bool is_literal(const lex_type type) {
+        return type >= lex_type::INT_LITERAL && type <= lex_type::CHAR_LITERAL;
+    }
+
+    // Width in bits of a sized numeric primitive, or 0 for any other token
+    constexpr uint8_t primitive_bits(const token_id id) {
+        switch (id) {
+            case token_id::i8: case token_id::u8:
+                return 8;
+            case token_id::i16: case token_id::u16:
+                return 16;
+            case token_id::i32: case token_id::u32: case token_id::f32:
+                return 32;
+            case token_id::i64: case token_id::u64: case token_id::f64:
+                return 64;
+            default:
+                return 0;
+        }
+    }
+
+    inline constexpr auto SPELLINGS = [] {
+        std::array<std::string_view, static_cast<size_t>(token_id::count)> names {};
+
+        for (const auto &entry : concat_spellings(KEYWORDS, PRIMITIVES, EXPR_SYMBOLS, ASSN_SYMBOLS, PUNCTUATORS))
+            names[static_cast<size_t>(entry.value)] = entry.text;
+
+        return names;
+    }();
+
+    constexpr std::string_view spelling(const token_id id) {
+        return SPELLINGS[static_cast<size_t>(id)];
+    }
+
+    // A decoded view of a single token, assembled on demand from a token_stream
+    struct lex_token {
+        lex_type type;
+        std::string_view span;
+        token_id id = token_id::none;
     };
 
-    inline std::unordered_set<char> PUNCTUATOR_SET = {
-        '{', '}', '(', ')', '[', ']'
+    /**
+     *  Token Cursor: Random Access Iterator
+     *  ------------------------------------
+     *  A position within a token_stream. Dereferencing assembles a lex_token
+     *  from the stream's arrays, so cursors stay valid however the stream's
+     *  storage is laid out, as long as the stream itself is not moved.
+     */
+    struct token_cursor {
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = lex_token;
+        using difference_type = std::ptrdiff_t;
+        using reference = lex_token;
+
+        struct arrow_proxy {
+            lex_token token;
+            const lex_token* operator->() const { return &token; }
+        };
+
+        using pointer = arrow_proxy;
+
+        const token_stream *stream = nullptr;
+        uint32_t index = 0;
+
+        lex_token operator*() const;
+        arrow_proxy operator->() const { return { **this }; }
+        lex_token operator[](difference_type offset) const { return *(*this + offset); }
+
+        // Read straight from the stream's arrays, without assembling the whole token
+        lex_type type() const;
+        token_id id() const;
+
+        std::optional<token_cursor> closer() const;
+        const literal_value* literal() const;
+        std::string_view string_value() const;
+
+        token_cursor& operator++() { ++index; return *this; }
+        token_cursor& operator--() { --index; return *this; }
+        token_cursor operator++(int) { auto copy = *this; ++index; return copy; }
+        token_cursor operator--(int) { auto copy = *this; --index; return copy; }
+
+        token_cursor& operator+=(const difference_type offset) { index += offset; return *this; }
+        token_cursor& operator-=(const difference_type offset) { index -= offset; return *this; }
+
+        friend token_cursor operator+(token_cursor cursor, const difference_type offset) { return cursor += offset; }
+        friend token_cursor operator+(const difference_type offset, token_cursor cursor) { return cursor += offset; }
+        friend token_cursor operator-(token_cursor cursor, const difference_type offset) { return cursor -= offset; }
+        friend difference_type operator-(const token_cursor lhs, const token_cursor rhs) {
+            return static_cast<difference_type>(lhs.index) - static_cast<difference_type>(rhs.index);
+        }
+
+        friend bool operator==(const token_cursor lhs, const token_cursor rhs) { return lhs.index == rhs.index; }
+        friend std::strong_ordering operator<=>(const token_cursor lhs, const token_cursor rhs) { return lhs.index <=> rhs.index; }
     };
 
-    lex_container lex(std::string_view code);
+    // A string literal's text after escape processing, as a range of token_stream::decoded
+    struct decoded_string {
+        uint32_t offset = 0;
+        uint32_t length = 0;
+    };
+
+    /**
+     *  Literal Value: Decoded Literal
+     *  ------------------------------
+     *  The value of a literal token, decoded once while lexing. Integers keep
+     *  their full 64-bit magnitude whatever base they were written in; the sign
+     *  is left to the unary minus in front of them.
+     */
+    struct literal_value {
+        std::variant<uint64_t, double, char, decoded_string> value;
+
+        // The primitive written directly after a numeric literal, e.g. u8 in 255u8
+        token_id suffix = token_id::none;
+    };
+
+    // A range of a source buffer to lex, such as one piece of preprocessed output
+    struct source_piece {
+        // The whole buffer the piece is part of, which token offsets are relative to
+        std::string_view buffer;
+        uint32_t offset = 0;
+        uint32_t length = 0;
+
+        std::string_view text() const { return buffer.substr(offset, length); }
+    };
+
+    /**
+     *  Token Stream: Struct-of-Arrays Token Container
+     *  ----------------------------------------------
+     *  Every token is stored as a one byte type, one byte token id, the 16-bit
+     *  index of the buffer it came from, and three 32-bit fields: its offset
+     *  into that buffer, its length, and a payload. For an opening punctuator
+     *  the payload is the index of the matching closer; for a literal it is the
+     *  index of its decoded value. This keeps a token to sixteen bytes and uses
+     *  indices rather than iterators, so the links survive any reallocation of
+     *  the arrays.
+     *
+     *  String literals without escapes have no decoded value, since their text
+     *  is the span itself. Those with escapes are decoded into `decoded`, which
+     *  is shared so anything viewing it can keep it alive past the stream.
+     */
+    struct token_stream {
+        static constexpr uint32_t no_payload = UINT32_MAX;
+
+        // Every buffer the tokens were lexed from, which files indexes. A stream lexed from
+        // a single buffer can be given it up front, as in token_stream { .sources = { code } }.
+        std::vector<std::string_view> sources;
+
+        // Index of the buffer push() takes new tokens from
+        uint16_t active_source = 0;
+
+        std::vector<lex_type> types;
+        std::vector<token_id> ids;
+        std::vector<uint16_t> files;
+        std::vector<uint32_t> offsets;
+        std::vector<uint32_t> lengths;
+        std::vector<uint32_t> payloads;
+
+        std::vector<literal_value> literals;
+        std::shared_ptr<std::string> decoded;
+
+        size_t size() const { return types.size(); }
+        bool empty() const { return types.empty(); }
+
+        void reserve(size_t count);
+        uint32_t push(lex_type type, token_id id, std::string_view span);
+
+        // Makes buffer the one pushed tokens point into, adding it to sources if it is not there yet
+        void select_source(std::string_view buffer);
+
+        // The buffer a token was lexed from, which its offset is relative to
+        std::string_view source(const size_t index) const {
+            return sources[files[index]];
+        }
+
+        std::string_view span(const size_t index) const {
+            return source(index).substr(offsets[index], lengths[index]);
+        }
+
+        // The source range a token was lexed from, which for string and character literals includes the quotes
+        uint32_t extent_begin(const size_t index) const {
+            return offsets[index] - is_quoted(index);
+        }
+
+        uint32_t extent_end(const size_t index) const {
+            return offsets[index] + lengths[index] + is_quoted(index);
+        }
+
+        bool is_quoted(const size_t index) const {
+            return types[index] == lex_type::STRING_LITERAL || types[index] == lex_type::CHAR_LITERAL;
+        }
+
+        lex_token operator[](const size_t index) const {
+            return lex_token { types[index], span(index), ids[index] };
+        }
+
+        // The decoded value of a literal token, or nullptr for a string literal without escapes
+        const literal_value* literal(const size_t index) const {
+            if (!is_literal(types[index]) || payloads[index] == no_payload)
+                return nullptr;
+
+            return &literals[payloads[index]];
+        }
+
+        // The text of a string literal after escape processing
+        std::string_view string_value(const size_t index) const {
+            const auto *value = literal(index);
+
+            if (!value)
+                return span(index);
+
+            const auto [offset, length] = std::get<decoded_string>(value->value);
+            return std::string_view { *decoded }.substr(offset, length);
+        }
+
+        token_cursor begin() const { return { this, 0 }; }
+        token_cursor end() const { return { this, static_cast<uint32_t>(size()) }; }
+    };
+
+    inline lex_token token_cursor::operator*() const {
+        return (*stream)[index];
+    }
+
+    inline lex_type token_cursor::type() const {
+        return stream->types[index];
+    }
+
+    inline token_id token_cursor::id() const {
+        return stream->ids[index];
+    }
+
+    inline std::optional<token_cursor> token_cursor::closer() const {
+        const auto closer = stream->payloads[index];
+
+        if (stream->types[index] != lex_type::PUNCTUATOR || closer == token_stream::no_payload)
+            return std::nullopt;
+
+        return token_cursor { stream, closer };
+    }
+
+    inline const literal_value* token_cursor::literal() const {
+        return stream->literal(index);
+    }
+
+    inline std::string_view token_cursor::string_value() const {
+        return stream->string_value(index);
+    }
+
+    token_stream lex(std::string_view code);
+
+    // Lexes the pieces in order into one stream, so brackets may be opened in one piece and closed
+    // in another. A single token, comment or literal cannot run from one piece into the next.
+    token_stream lex(std::span<const source_piece> pieces);
+
+    // Appends the tokens of the next top-level declaration from [ptr, end), i.e. everything up to and
+    // including the first ';' or '}' outside of any brackets, and moves ptr past it. Returns false if
+    // end came first, in which case openers holds the brackets still open so the declaration can be
+    // continued from another piece. The buffer ptr points into must be tokens' active source.
+    bool lex_declaration(token_stream& tokens, std::vector<uint32_t>& openers, str_ptr& ptr, str_ptr end);
 }
@@ -0,0 +1,176 @@
+#include "lex_parallel.h"
+
+#include <algorithm>
+#include <exception>
+#include <future>
+#include <ranges>
+#include <stdexcept>
+#include <vector>
+
+#include "derive_lex.h"
+#include "simd_scan.h"
+#include "unicode.h"
+
+using namespace lex;
+
+namespace {
+    // Chunks smaller than this spend more time being scheduled than lexed
+    constexpr size_t MIN_CHUNK_SIZE = 256 << 10;
+
+    struct chunk_result {
+        token_stream tokens;
+
+        // Start of the first token at or past the end of the chunk, or the end of the source
+        uint32_t exit = 0;
+        std::exception_ptr error;
+    };
+
+    // Lexes the tokens starting in [begin, end), letting the last one run past end if it has to
+    chunk_result lex_chunk(const std::string_view code, const uint32_t begin, const uint32_t end) {
+        chunk_result chunk { .tokens = { .sources = { code } } };
+
+        auto ptr = code.cbegin() + begin;
+        const auto stop = code.cbegin() + end;
+
+        try {
+            while (const auto derived = derive_next(ptr, code.cend())) {
+                if (ptr >= stop)
+                    break;
+
+                emit_token(chunk.tokens, *derived);
+                ptr = derived->end;
+            }
+        } catch (...) {
+            chunk.error = std::current_exception();
+        }
+
+        chunk.exit = static_cast<uint32_t>(ptr - code.cbegin());
+        return chunk;
+    }
+
+    std::vector<uint32_t> split_at_newlines(const std::string_view code, const size_t chunk_count) {
+        std::vector<uint32_t> bounds { 0 };
+
+        for (size_t i = 1; i < chunk_count; i++) {
+            const char *target = code.data() + code.size() * i / chunk_count;
+            const char *newline = simd::find_char(target, code.data() + code.size(), '\n');
+            const auto bound = static_cast<uint32_t>(std::min(newline + 1, code.data() + code.size()) - code.data());
+
+            if (bound > bounds.back() && bound < code.size())
+                bounds.push_back(bound);
+        }
+
+        bounds.push_back(static_cast<uint32_t>(code.size()));
+        return bounds;
+    }
+
+    void append_tokens(token_stream& to, const token_stream& from, const size_t first) {
+        const auto rebased = to.size();
+        const auto literal_base = static_cast<uint32_t>(to.literals.size());
+        const auto decoded_base = static_cast<uint32_t>(to.decoded ? to.decoded->size() : 0);
+
+        to.types.insert(to.types.end(), from.types.begin() + first, from.types.end());
+        to.ids.insert(to.ids.end(), from.ids.begin() + first, from.ids.end());
+        to.files.insert(to.files.end(), from.files.begin() + first, from.files.end());
+        to.offsets.insert(to.offsets.end(), from.offsets.begin() + first, from.offsets.end());
+        to.lengths.insert(to.lengths.end(), from.lengths.begin() + first, from.lengths.end());
+        to.payloads.insert(to.payloads.end(), from.payloads.begin() + first, from.payloads.end());
+
+        // Literal payloads index the chunk's own tables, so move them onto the merged ones
+        for (size_t i = rebased; i < to.size(); i++) {
+            if (is_literal(to.types[i]) && to.payloads[i] != token_stream::no_payload)
+                to.payloads[i] += literal_base;
+        }
+
+        for (auto literal : from.literals) {
+            if (auto *string = std::get_if<decoded_string>(&literal.value))
+                string->offset += decoded_base;
+
+            to.literals.push_back(literal);
+        }
+
+        if (from.decoded) {
+            if (!to.decoded)
+                to.decoded = std::make_shared<std::string>();
+
+            to.decoded->append(*from.decoded);
+        }
+    }
+}
+
+token_stream lex::lex_parallel(const std::string_view code, util::thread_pool& pool) {
+    // A few chunks per worker, so one slow chunk does not hold up the rest
+    const auto chunk_count = std::min(pool.size() * 4, code.size() / MIN_CHUNK_SIZE);
+
+    if (pool.size() <= 1 || chunk_count <= 1)
+        return lex(code);
+
+    if (code.size() >= token_stream::no_payload)
+        throw std::runtime_error("Source file is too large to lex");
+
+    const auto bounds = split_at_newlines(code, chunk_count);
+    std::vector<std::future<chunk_result>> chunks;
+
+    // Chunks end on newlines, so no code point is split between two of them
+    for (size_t i = 0; i + 1 < bounds.size(); i++)
+        chunks.emplace_back(pool.submit([code, begin = bounds[i], end = bounds[i + 1]] {
+            validate_utf8(code.substr(begin, end - begin));
+            return lex_chunk(code, begin, end);
+        }));
+
+    token_stream tokens { .sources = { code } };
+    tokens.reserve(code.size() / 4);
+
+    // Position of the next real token, as found by lexing everything before it correctly
+    uint32_t exit = 0;
+
+    try {
+        // lex() checks the encoding of the whole file before lexing any of it, so the first chunk
+        // with invalid UTF-8 has to win over a lexing error in any chunk
+        std::vector<chunk_result> results;
+        results.reserve(chunks.size());
+
+        for (auto &chunk : chunks) {
+            pool.wait(chunk);
+            results.push_back(chunk.get());
+        }
+
+        for (size_t i = 0; i < results.size(); i++) {
+            auto &chunk = results[i];
+
+            // A comment or literal from an earlier chunk swallowed this one whole
+            if (exit >= bounds[i + 1])
+                continue;
+
+            const auto first = *std::ranges::partition_point(
+                std::views::iota(size_t { 0 }, chunk.tokens.size()),
+                [&](const size_t token) { return chunk.tokens.extent_begin(token) < exit; }
+            );
+
+            // Without a token starting at exit, the speculation began inside a comment or literal
+            if (first != chunk.tokens.size() && chunk.tokens.extent_begin(first) == exit) {
+                append_tokens(tokens, chunk.tokens, first);
+            } else {
+                chunk = lex_chunk(code, exit, bounds[i + 1]);
+                append_tokens(tokens, chunk.tokens, 0);
+            }
+
+            // Past the synchronization point the chunk was lexed exactly as lex() would have, errors included
+            if (chunk.error)
+                std::rethrow_exception(chunk.error);
+
+            exit = chunk.exit;
+        }
+    } catch (...) {
+        // The remaining jobs still read from code, so they have to finish before it can go away
+        for (auto &chunk : chunks) {
+            if (chunk.valid())
+                pool.wait(chunk);
+        }
+
+        throw;
+    }
+
+    connect_punctuators(tokens);
+    return tokens;
+}
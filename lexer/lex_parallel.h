@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+#include "lex.h"
+#include "../util/thread_pool.h"
+
+namespace lex {
+    // Below this size a file is lexed faster on one core than it can be split up and merged
+    inline constexpr size_t PARALLEL_LEX_THRESHOLD = 4 << 20;
+
+    /**
+     *  Parallel Lex: Speculative Chunked Lexing
+     *  ----------------------------------------
+     *  Splits the source at newlines and lexes every chunk on the pool as if it
+     *  started outside of any comment or literal. The chunks are then stitched
+     *  together in order: a chunk's tokens are kept from the first one starting
+     *  exactly where the previous chunk's last token ended, and a chunk with no
+     *  such token (it began inside a block comment or string) is lexed again from
+     *  the right position. Brackets are matched in one final pass over the result.
+     *
+     *  Produces exactly the same stream, and the same errors, as lex().
+     */
+    token_stream lex_parallel(std::string_view code, util::thread_pool& pool = util::thread_pool::shared());
+}
@@ -0,0 +1,96 @@
+#include "lex_stream.h"
+
+#include <stdexcept>
+#include <utility>
+
+#include "unicode.h"
+
+using namespace lex;
+
+lex_stream::lex_stream(const std::string_view code, const size_t capacity)
+    : lex_stream(std::vector { source_piece { code, 0, static_cast<uint32_t>(code.size()) } }, capacity) {}
+
+lex_stream::lex_stream(std::vector<source_piece> pieces, const size_t capacity)
+    : pieces(std::move(pieces)), slots(capacity) {
+    if (capacity == 0)
+        throw std::runtime_error("A lex stream needs room for at least one declaration");
+
+    worker = std::jthread { [this](const std::stop_token stop) { produce(stop); } };
+}
+
+lex_stream::~lex_stream() {
+    worker.request_stop();
+    not_full.notify_all();
+}
+
+void lex_stream::produce(const std::stop_token stop) {
+    token_stream declaration;
+    std::vector<uint32_t> openers;
+
+    // Hands the declaration built so far to the consumer, or returns false if asked to stop first
+    const auto publish = [&] {
+        // Trailing whitespace and comments produce no tokens
+        if (declaration.empty())
+            return true;
+
+        if (declaration.decoded)
+            decoded_strings.push_back(declaration.decoded);
+
+        std::unique_lock lock { mutex };
+
+        if (!not_full.wait(lock, stop, [this] { return count < slots.size(); }))
+            return false;
+
+        slots[(head + count++) % slots.size()] = std::exchange(declaration, {});
+        openers.clear();
+        not_empty.notify_one();
+
+        return true;
+    };
+
+    try {
+        for (const auto &piece : pieces)
+            validate_utf8(piece.text());
+
+        for (const auto &piece : pieces) {
+            const auto text = piece.text();
+            auto ptr = text.cbegin();
+
+            while (ptr != text.cend()) {
+                declaration.select_source(piece.buffer);
+
+                if (lex_declaration(declaration, openers, ptr, text.cend()) && !publish())
+                    return;
+            }
+        }
+
+        if (!publish())
+            return;
+    } catch (...) {
+        std::scoped_lock lock { mutex };
+        error = std::current_exception();
+    }
+
+    std::scoped_lock lock { mutex };
+    finished = true;
+    not_empty.notify_one();
+}
+
+std::optional<token_stream> lex_stream::next() {
+    std::unique_lock lock { mutex };
+    not_empty.wait(lock, [this] { return count > 0 || finished; });
+
+    if (count == 0) {
+        if (error)
+            std::rethrow_exception(error);
+
+        return std::nullopt;
+    }
+
+    auto declaration = std::move(slots[head]);
+    head = (head + 1) % slots.size();
+    count--;
+
+    not_full.notify_one();
+    return declaration;
+}
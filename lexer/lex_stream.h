@@ -0,0 +1,63 @@
+#pragma once
+
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "lex.h"
+
+namespace lex {
+    /**
+     *  Lex Stream: Bounded Producer/Consumer Lexer
+     *  -------------------------------------------
+     *  Lexes a source file on a background thread, one top-level declaration at
+     *  a time, into a ring buffer of at most `capacity` declarations. The parser
+     *  pulls declarations with next() as it needs them, so lexing overlaps with
+     *  parsing and only a window of the file's tokens is alive at any moment.
+     *
+     *  Every declaration is its own token_stream, so bracket closers are always
+     *  resolved by the time it is handed out. Token spans still point into the
+     *  source buffers, which must outlive both the stream and anything parsed
+     *  from it.
+     *  The decoded text of string literals is kept by the stream itself, so it
+     *  has to outlive anything parsed from it as well.
+     */
+    class lex_stream {
+    public:
+        explicit lex_stream(std::string_view code, size_t capacity = 64);
+
+        // Lexes the pieces one after another, as lex::lex would, a declaration may span several of them
+        explicit lex_stream(std::vector<source_piece> pieces, size_t capacity = 64);
+        ~lex_stream();
+
+        lex_stream(const lex_stream&) = delete;
+        lex_stream& operator=(const lex_stream&) = delete;
+
+        // The next declaration, or nullopt once the source is exhausted. Rethrows any lexing error.
+        std::optional<token_stream> next();
+
+    private:
+        void produce(std::stop_token stop);
+
+        std::vector<source_piece> pieces;
+
+        std::vector<token_stream> slots;
+        size_t head = 0, count = 0;
+        bool finished = false;
+        std::exception_ptr error;
+
+        // Only touched by the producer, and kept after each declaration is handed out
+        std::vector<std::shared_ptr<std::string>> decoded_strings;
+
+        std::mutex mutex;
+        std::condition_variable_any not_empty, not_full;
+
+        // Declared last so the buffer above exists for the whole life of the thread
+        std::jthread worker;
+    };
+}
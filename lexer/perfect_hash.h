@@ -0,0 +1,69 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+namespace lex {
+    /**
+     *  Perfect Hash Map: Compile-Time Lookup Table
+     *  -------------------------------------------
+     *  Maps a fixed set of spellings to values with a single hash and a single
+     *  string comparison. The seed is searched for at compile time until every
+     *  entry lands in its own slot, so a lookup never has to probe.
+     */
+    constexpr uint32_t hash_spelling(const std::string_view str, const uint32_t seed) {
+        uint32_t hash = seed;
+
+        for (const char c : str)
+            hash = (hash ^ static_cast<uint8_t>(c)) * 0x01000193u;
+
+        return hash ^ (hash >> 16);
+    }
+
+    template <typename T>
+    struct spelling_entry {
+        std::string_view text;
+        T value {};
+    };
+
+    template <typename T, size_t N, size_t Slots = 256>
+    struct perfect_hash_map {
+        static_assert((Slots & (Slots - 1)) == 0, "Slot count must be a power of two");
+        static_assert(N <= Slots / 2, "Table too dense to reliably find a perfect seed");
+
+        std::array<spelling_entry<T>, Slots> slots {};
+        uint32_t seed = 0;
+
+        constexpr explicit perfect_hash_map(const std::array<spelling_entry<T>, N> &entries) {
+            while (!try_seed(entries))
+                ++seed;
+        }
+
+        constexpr std::optional<T> find(const std::string_view str) const {
+            const auto &slot = slots[hash_spelling(str, seed) & (Slots - 1)];
+
+            if (slot.text.empty() || slot.text != str)
+                return std::nullopt;
+
+            return slot.value;
+        }
+
+    private:
+        constexpr bool try_seed(const std::array<spelling_entry<T>, N> &entries) {
+            slots = {};
+
+            for (const auto &entry : entries) {
+                auto &slot = slots[hash_spelling(entry.text, seed) & (Slots - 1)];
+
+                if (!slot.text.empty())
+                    return false;
+
+                slot = entry;
+            }
+
+            return true;
+        }
+    };
+}
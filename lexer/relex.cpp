@@ -0,0 +1,246 @@
+#include "relex.h"
+
+#include <algorithm>
+#include <format>
+#include <iterator>
+#include <memory>
+#include <ranges>
+#include <stdexcept>
+#include <vector>
+
+#include "derive_lex.h"
+#include "source_location.h"
+#include "unicode.h"
+
+using namespace lex;
+
+bool is_opener(const token_id id) {
+    return id == token_id::l_brace || id == token_id::l_paren || id == token_id::l_bracket;
+}
+
+bool is_closer(const token_id id) {
+    return id == token_id::r_brace || id == token_id::r_paren || id == token_id::r_bracket;
+}
+
+// Appends the openers in [begin, end) which are not closed before end, outermost first. Complete bracket
+// pairs are jumped over, so only the tokens outside of them are visited.
+void add_open(std::vector<uint32_t>& openers, const token_stream& tokens, const uint32_t begin, const uint32_t end) {
+    for (uint32_t i = begin; i < end; ++i) {
+        if (!is_opener(tokens.ids[i]))
+            continue;
+
+        if (const auto closer = tokens.payloads[i]; closer != token_stream::no_payload && closer < end)
+            i = closer;
+        else
+            openers.push_back(i);
+    }
+}
+
+// The opener a closer matches, or none for any other punctuator
+token_id opener_of(const token_id closer) {
+    switch (closer) {
+        case token_id::r_brace: return token_id::l_brace;
+        case token_id::r_paren: return token_id::l_paren;
+        case token_id::r_bracket: return token_id::l_bracket;
+        default: return token_id::none;
+    }
+}
+
+// Replaces [begin, end) of an array with replacement, moving the elements after it in place
+template <typename T>
+void splice(std::vector<T>& array, const uint32_t begin, const uint32_t end, const std::vector<T>& replacement) {
+    const auto old_size = array.size();
+    const auto removed = end - begin;
+
+    if (replacement.size() > removed) {
+        array.resize(old_size + replacement.size() - removed);
+        std::move_backward(array.begin() + end, array.begin() + old_size, array.end());
+    } else if (replacement.size() < removed) {
+        std::move(array.begin() + end, array.end(), array.begin() + begin + replacement.size());
+        array.resize(old_size - (removed - replacement.size()));
+    }
+
+    std::ranges::copy(replacement, array.begin() + begin);
+}
+
+void lex::relex(token_stream& tokens, const std::string_view source, const text_edit& edit) {
+    if (tokens.sources.size() > 1)
+        throw std::runtime_error("Only a token stream lexed from a single buffer can be re-lexed");
+
+    const auto old_size = tokens.sources.empty() ? 0 : tokens.sources.front().size();
+
+    if (edit.offset + static_cast<size_t>(edit.removed) > old_size ||
+        source.size() != old_size - edit.removed + edit.inserted.size() ||
+        source.substr(edit.offset, edit.inserted.size()) != edit.inserted)
+        throw std::runtime_error("Edit does not describe the change between the two sources");
+
+    if (source.size() >= token_stream::no_payload)
+        throw std::runtime_error("Source file is too large to lex");
+
+    // The previous source was valid, so only the code points the edit touches need checking. That
+    // includes the one ending at the edit, which may have lost its continuation bytes to it.
+    const auto checked_from = edit.offset == 0 ? 0 : edit.offset - 1;
+    validate_utf8(enclosing_code_points(source, checked_from, edit.offset + edit.inserted.size()));
+
+    const auto old_count = static_cast<uint32_t>(tokens.size());
+    const auto shift = static_cast<int64_t>(edit.inserted.size()) - edit.removed;
+    const auto edit_end = edit.offset + edit.inserted.size();
+
+    // The first token whose text, or whatever the scanner looked at to end it, overlaps the edit
+    const auto indices = std::views::iota(uint32_t { 0 }, old_count);
+    const auto first = *std::ranges::partition_point(indices, [&](const uint32_t i) {
+        return tokens.extent_end(i) + MAX_LOOKAHEAD <= edit.offset;
+    });
+
+    // Until the result is known to lex, the stream is left as it is: the damaged range is lexed into a stream
+    // of its own, whose token k becomes token first + k, and bracket links are collected rather than written
+    token_stream fresh { .sources = { source } };
+    std::vector<std::pair<uint32_t, uint32_t>> links;
+
+    std::vector<uint32_t> openers;
+    add_open(openers, tokens, 0, first);
+
+    // Kept to work out which of them the copied tokens close, since re-lexing consumes openers
+    const auto open_before = openers;
+
+    // Links the closer at index, given the id of the token at any index of the result
+    const auto link = [&openers, &links](const uint32_t index, const token_id id, const std::string_view span, const auto& id_at) {
+        const auto expected = opener_of(id);
+
+        if (expected == token_id::none)
+            throw source_error(std::format("Invalid Punctuator: {}", span), span);
+
+        if (openers.empty() || id_at(openers.back()) != expected)
+            throw source_error("Mismatched punctuators", span);
+
+        links.emplace_back(openers.back(), index);
+        openers.pop_back();
+    };
+
+    const auto fresh_id = [&tokens, &fresh, first](const uint32_t index) {
+        return index < first ? tokens.ids[index] : fresh.ids[index - first];
+    };
+
+    // Re-lex until a token starts exactly where an old one did, past the edit
+    auto ptr = source.cbegin() + (first == 0 ? 0 : tokens.extent_end(first - 1));
+    const auto end = source.cend();
+    auto resume = old_count;
+
+    while (const auto derived = derive_next(ptr, end)) {
+        const auto start = static_cast<uint32_t>(ptr - source.cbegin());
+
+        if (start >= edit_end) {
+            const auto old_start = static_cast<uint32_t>(start - shift);
+            const auto match = *std::ranges::partition_point(
+                std::views::iota(first, old_count),
+                [&](const uint32_t i) { return tokens.extent_begin(i) < old_start; }
+            );
+
+            if (match != old_count && tokens.extent_begin(match) == old_start) {
+                resume = match;
+                break;
+            }
+        }
+
+        const auto index = first + emit_token(fresh, *derived);
+
+        if (derived->type == lex_type::PUNCTUATOR) {
+            if (is_opener(derived->id))
+                openers.push_back(index);
+            else
+                link(index, derived->id, derived->span, fresh_id);
+        }
+
+        ptr = derived->end;
+    }
+
+    // Everything from the resume point on lexes exactly as before, just moved to index + index_shift
+    const auto tail = static_cast<uint32_t>(first + fresh.size());
+    const auto index_shift = static_cast<int64_t>(tail) - resume;
+
+    const auto result_id = [&tokens, &fresh, first, tail, index_shift](const uint32_t index) {
+        return index < tail ? (index < first ? tokens.ids[index] : fresh.ids[index - first])
+                            : tokens.ids[index - index_shift];
+    };
+
+    // The tail closes every bracket still open at the resume point that was closed before the edit.
+    // Those opened before the damaged range are already known, so only the range itself has to be walked.
+    std::vector<uint32_t> carried_openers;
+    std::ranges::copy_if(open_before, std::back_inserter(carried_openers), [resume, &tokens](const uint32_t opener) {
+        return tokens.payloads[opener] >= resume;
+    });
+    add_open(carried_openers, tokens, first, resume);
+
+    const auto carried = std::ranges::count_if(carried_openers, [&tokens](const uint32_t opener) {
+        return tokens.payloads[opener] != token_stream::no_payload;
+    });
+
+    for (uint32_t i = resume, closed = 0; closed < carried && i < old_count; ++i) {
+        const auto id = tokens.ids[i];
+
+        if (is_opener(id) && tokens.payloads[i] != token_stream::no_payload) {
+            i = tokens.payloads[i];
+        } else if (is_opener(id)) {
+            openers.push_back(static_cast<uint32_t>(i + index_shift));
+        } else if (is_closer(id)) {
+            link(static_cast<uint32_t>(i + index_shift), id, source.substr(tokens.offsets[i] + shift, tokens.lengths[i]), result_id);
+            closed++;
+        }
+    }
+
+    // Nothing below throws, so from here on the stream is changed in place. The new literals are added after
+    // the existing ones, leaving those of the replaced tokens unused.
+    const auto literal_base = static_cast<uint32_t>(tokens.literals.size());
+
+    if (fresh.decoded) {
+        // Another stream sharing the decoded text keeps the text it had
+        if (!tokens.decoded)
+            tokens.decoded = std::make_shared<std::string>();
+        else if (tokens.decoded.use_count() > 1)
+            tokens.decoded = std::make_shared<std::string>(*tokens.decoded);
+
+        const auto decoded_base = static_cast<uint32_t>(tokens.decoded->size());
+
+        for (auto &literal : fresh.literals) {
+            if (auto *decoded = std::get_if<decoded_string>(&literal.value))
+                decoded->offset += decoded_base;
+        }
+
+        tokens.decoded->append(*fresh.decoded);
+    }
+
+    tokens.literals.insert(tokens.literals.end(), fresh.literals.begin(), fresh.literals.end());
+
+    for (uint32_t i = 0; i < fresh.size(); ++i) {
+        if (is_literal(fresh.types[i]) && fresh.payloads[i] != token_stream::no_payload)
+            fresh.payloads[i] += literal_base;
+    }
+
+    splice(tokens.types, first, resume, fresh.types);
+    splice(tokens.ids, first, resume, fresh.ids);
+    splice(tokens.files, first, resume, fresh.files);
+    splice(tokens.offsets, first, resume, fresh.offsets);
+    splice(tokens.lengths, first, resume, fresh.lengths);
+    splice(tokens.payloads, first, resume, fresh.payloads);
+
+    tokens.sources = { source };
+
+    // Kept as separate passes, so the one over offsets alone is a plain add over an array
+    if (shift != 0) {
+        for (auto i = tail; i < tokens.size(); ++i)
+            tokens.offsets[i] = static_cast<uint32_t>(tokens.offsets[i] + shift);
+    }
+
+    if (index_shift != 0) {
+        for (auto i = tail; i < tokens.size(); ++i) {
+            if (tokens.types[i] == lex_type::PUNCTUATOR && tokens.payloads[i] != token_stream::no_payload)
+                tokens.payloads[i] = static_cast<uint32_t>(tokens.payloads[i] + index_shift);
+        }
+    }
+
+    for (const auto opener : open_before)
+        tokens.payloads[opener] = token_stream::no_payload;
+
+    for (const auto [opener, closer] : links)
+        tokens.payloads[opener] = closer;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+#include "lex.h"
+
+namespace lex {
+    // Replaces `removed` bytes at `offset` of the previous source with `inserted`
+    struct text_edit {
+        uint32_t offset = 0;
+        uint32_t removed = 0;
+        std::string_view inserted;
+    };
+
+    /**
+     *  Relex: Incremental Re-Tokenization
+     *  ----------------------------------
+     *  Updates `tokens` in place to the token stream of `source`, the previous
+     *  source with `edit` applied, by only re-lexing the damaged region. Lexing
+     *  restarts after the last token the edit cannot have influenced, and stops
+     *  as soon as it lands on the start of a token that existed before the
+     *  edit; the new tokens are spliced over the ones they replace.
+     *
+     *  Bracket links inside the untouched regions are kept. Only the brackets
+     *  still open around the edit are re-matched, skipping over any complete
+     *  pair in between.
+     *
+     *  The lexing and the literal tables grow with the size of the edit: new
+     *  literals and decoded text are appended, leaving those of the replaced
+     *  tokens unused. What remains is proportional to the file but not to the
+     *  edit: moving the arrays after the damaged region when the token count
+     *  changes, a pass over those tokens to shift their offsets and one to
+     *  shift their links, each skipped when nothing moves, and finding the brackets open around the
+     *  edit, which visits the tokens before it that are not inside a complete
+     *  pair.
+     *
+     *  If the edited source does not lex, the error is thrown with `tokens`
+     *  left as it was. `tokens` must have been lexed from a single buffer, and
+     *  afterwards its spans point into `source`, which the caller owns.
+     */
+    void relex(token_stream& tokens, std::string_view source, const text_edit& edit);
+}
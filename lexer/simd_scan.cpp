@@ -0,0 +1,434 @@
+#include "simd_scan.h"
+
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+
+#include "unicode.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LEX_SIMD_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+    bool is_space(const char c) {
+        const auto u = static_cast<uint8_t>(c);
+
+        // ' ', '\0', and the contiguous range '\t' '\n' '\v' '\f' '\r'
+        return u == ' ' || u == '\0' || static_cast<uint8_t>(u - '\t') <= '\r' - '\t';
+    }
+
+    // -- Scalar -------------------
+
+    const char* skip_whitespace_scalar(const char* ptr, const char* end) {
+        while (ptr < end && is_space(*ptr))
+            ++ptr;
+
+        return ptr;
+    }
+
+    const char* find_char_scalar(const char* ptr, const char* end, const char c) {
+        if (ptr >= end)
+            return end;
+
+        const auto *find = static_cast<const char*>(std::memchr(ptr, c, end - ptr));
+        return find ? find : end;
+    }
+
+    const char* skip_block_comment_scalar(const char* ptr, const char* end) {
+        while ((ptr = find_char_scalar(ptr, end, '*')) != end) {
+            if (++ptr != end && *ptr == '/')
+                return ptr + 1;
+        }
+
+        return end;
+    }
+
+    const char* find_string_end_scalar(const char* ptr, const char* end) {
+        while (ptr < end && *ptr != '\"') {
+            if (*ptr == '\\' && end - ptr < 2)
+                return end;
+
+            ptr += *ptr == '\\' ? 2 : 1;
+        }
+
+        return ptr;
+    }
+
+    const char* validate_utf8_scalar(const char* ptr, const char* end) {
+        while (ptr < end) {
+            if (static_cast<uint8_t>(*ptr) < 0x80) {
+                ++ptr;
+                continue;
+            }
+
+            const auto length = lex::decode_utf8(ptr, end).length;
+
+            if (!length)
+                return ptr;
+
+            ptr += length;
+        }
+
+        return end;
+    }
+
+    // Steps back from ptr to the start of the code point that may run across it, so a scan can resume there
+    const char* rewind_to_lead(const char* start, const char* ptr) {
+        for (int i = 0; i < 4 && ptr > start; i++) {
+            if (!lex::is_utf8_continuation(*--ptr))
+                return ptr;
+        }
+
+        return ptr;
+    }
+
+#ifdef LEX_SIMD_X86
+
+    // -- SSE2 ---------------------
+
+    __attribute__((target("sse2")))
+    const char* skip_whitespace_sse2(const char* ptr, const char* end) {
+        const __m128i space = _mm_set1_epi8(' '), zero = _mm_setzero_si128();
+        const __m128i tab = _mm_set1_epi8('\t'), range = _mm_set1_epi8('\r' - '\t');
+
+        for (; end - ptr >= 16; ptr += 16) {
+            const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr));
+            const __m128i shifted = _mm_sub_epi8(block, tab);
+            const __m128i in_range = _mm_cmpeq_epi8(_mm_min_epu8(shifted, range), shifted);
+            const __m128i space_mask = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(block, space), _mm_cmpeq_epi8(block, zero)),
+                in_range
+            );
+
+            if (const uint32_t mask = ~_mm_movemask_epi8(space_mask) & 0xFFFF)
+                return ptr + std::countr_zero(mask);
+        }
+
+        return skip_whitespace_scalar(ptr, end);
+    }
+
+    __attribute__((target("sse2")))
+    const char* skip_block_comment_sse2(const char* ptr, const char* end) {
+        const __m128i star = _mm_set1_epi8('*');
+
+        for (; end - ptr >= 16; ptr += 16) {
+            const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr));
+
+            for (uint32_t mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, star)); mask; mask &= mask - 1) {
+                const char *hit = ptr + std::countr_zero(mask);
+
+                if (hit + 1 < end && hit[1] == '/')
+                    return hit + 2;
+            }
+        }
+
+        return skip_block_comment_scalar(ptr, end);
+    }
+
+    __attribute__((target("sse2")))
+    const char* find_string_end_sse2(const char* ptr, const char* end) {
+        const __m128i quote = _mm_set1_epi8('\"'), escape = _mm_set1_epi8('\\');
+
+        while (end - ptr >= 16) {
+            const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr));
+            const uint32_t mask = _mm_movemask_epi8(
+                _mm_or_si128(_mm_cmpeq_epi8(block, quote), _mm_cmpeq_epi8(block, escape))
+            );
+
+            if (!mask) {
+                ptr += 16;
+                continue;
+            }
+
+            const char *hit = ptr + std::countr_zero(mask);
+
+            if (*hit == '\"')
+                return hit;
+            if (end - hit < 2)
+                return end;
+
+            // Skip the backslash and whatever character it escapes
+            ptr = hit + 2;
+        }
+
+        return find_string_end_scalar(ptr, end);
+    }
+
+    __attribute__((target("sse2")))
+    const char* validate_utf8_sse2(const char* ptr, const char* end) {
+        while (end - ptr >= 16) {
+            const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr));
+            const uint32_t mask = _mm_movemask_epi8(block);
+
+            if (!mask) {
+                ptr += 16;
+                continue;
+            }
+
+            // Decode the rest of the block one code point at a time, the last may run into the next block
+            const char *block_end = ptr + 16;
+
+            for (ptr += std::countr_zero(mask); ptr < block_end;) {
+                if (static_cast<uint8_t>(*ptr) < 0x80) {
+                    ++ptr;
+                    continue;
+                }
+
+                const auto length = lex::decode_utf8(ptr, end).length;
+
+                if (!length)
+                    return ptr;
+
+                ptr += length;
+            }
+        }
+
+        return validate_utf8_scalar(ptr, end);
+    }
+
+    // -- AVX2 ---------------------
+
+    __attribute__((target("avx2")))
+    const char* skip_whitespace_avx2(const char* ptr, const char* end) {
+        const __m256i space = _mm256_set1_epi8(' '), zero = _mm256_setzero_si256();
+        const __m256i tab = _mm256_set1_epi8('\t'), range = _mm256_set1_epi8('\r' - '\t');
+
+        for (; end - ptr >= 32; ptr += 32) {
+            const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr));
+            const __m256i shifted = _mm256_sub_epi8(block, tab);
+            const __m256i in_range = _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, range), shifted);
+            const __m256i space_mask = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(block, space), _mm256_cmpeq_epi8(block, zero)),
+                in_range
+            );
+
+            if (const uint32_t mask = ~static_cast<uint32_t>(_mm256_movemask_epi8(space_mask)))
+                return ptr + std::countr_zero(mask);
+        }
+
+        return skip_whitespace_sse2(ptr, end);
+    }
+
+    __attribute__((target("avx2")))
+    const char* skip_block_comment_avx2(const char* ptr, const char* end) {
+        const __m256i star = _mm256_set1_epi8('*');
+
+        for (; end - ptr >= 32; ptr += 32) {
+            const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr));
+            auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, star)));
+
+            for (; mask; mask &= mask - 1) {
+                const char *hit = ptr + std::countr_zero(mask);
+
+                if (hit + 1 < end && hit[1] == '/')
+                    return hit + 2;
+            }
+        }
+
+        return skip_block_comment_sse2(ptr, end);
+    }
+
+    __attribute__((target("avx2")))
+    const char* find_string_end_avx2(const char* ptr, const char* end) {
+        const __m256i quote = _mm256_set1_epi8('\"'), escape = _mm256_set1_epi8('\\');
+
+        while (end - ptr >= 32) {
+            const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr));
+            const auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(
+                _mm256_or_si256(_mm256_cmpeq_epi8(block, quote), _mm256_cmpeq_epi8(block, escape))
+            ));
+
+            if (!mask) {
+                ptr += 32;
+                continue;
+            }
+
+            const char *hit = ptr + std::countr_zero(mask);
+
+            if (*hit == '\"')
+                return hit;
+            if (end - hit < 2)
+                return end;
+
+            ptr = hit + 2;
+        }
+
+        return find_string_end_sse2(ptr, end);
+    }
+
+    // Error bits for a pair of adjacent bytes, see validate_utf8_avx2
+    constexpr uint8_t TOO_SHORT = 1 << 0, TOO_LONG = 1 << 1, OVERLONG_3 = 1 << 2, TOO_LARGE = 1 << 3;
+    constexpr uint8_t SURROGATE = 1 << 4, OVERLONG_2 = 1 << 5, TOO_LARGE_1000 = 1 << 6, OVERLONG_4 = 1 << 6;
+    constexpr uint8_t TWO_CONTS = 1 << 7, CARRY = TOO_SHORT | TOO_LONG | TWO_CONTS;
+
+    // A 16 entry shuffle table, repeated for both 128-bit lanes
+    constexpr std::array<uint8_t, 32> lane_table(const std::array<uint8_t, 16>& entries) {
+        std::array<uint8_t, 32> table {};
+
+        for (size_t i = 0; i < table.size(); i++)
+            table[i] = entries[i % entries.size()];
+
+        return table;
+    }
+
+    constexpr auto BYTE_1_HIGH = lane_table({
+        TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+        TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+        TOO_SHORT | OVERLONG_2,
+        TOO_SHORT,
+        TOO_SHORT | OVERLONG_3 | SURROGATE,
+        TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4
+    });
+
+    constexpr auto BYTE_1_LOW = lane_table({
+        CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,
+        CARRY | OVERLONG_2,
+        CARRY, CARRY,
+        CARRY | TOO_LARGE,
+        CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,
+        CARRY | TOO_LARGE | TOO_LARGE_1000, CARRY | TOO_LARGE | TOO_LARGE_1000
+    });
+
+    constexpr auto BYTE_2_HIGH = lane_table({
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT
+    });
+
+    /**
+     *  Keiser and Lemire's lookup validator, from "Validating UTF-8 In Less Than
+     *  One Instruction Per Byte". Every error in a pair of adjacent bytes is
+     *  a bit set in all three of the tables above, indexed by the high and low
+     *  nibble of the first byte and the high nibble of the second. Three and four
+     *  byte sequences are then checked by requiring a continuation byte wherever
+     *  a lead two or three bytes earlier says one must be.
+     *
+     *  Blocks without any high bit set are skipped after checking that the block
+     *  before did not end partway through a sequence. The kernel only says
+     *  whether a block is valid, so once one is not the SSE2 kernel finds the
+     *  exact byte, starting from the last code point boundary before the block.
+     */
+    __attribute__((target("avx2")))
+    const char* validate_utf8_avx2(const char* start, const char* end) {
+        const __m256i byte_1_high = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(BYTE_1_HIGH.data()));
+        const __m256i byte_1_low = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(BYTE_1_LOW.data()));
+        const __m256i byte_2_high = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(BYTE_2_HIGH.data()));
+
+        // Anything above these in the last three bytes is a lead whose sequence continues in the next block
+        const __m256i incomplete_max = _mm256_setr_epi8(
+            -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+            -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+            static_cast<char>(0xF0 - 1), static_cast<char>(0xE0 - 1), static_cast<char>(0xC0 - 1)
+        );
+
+        const __m256i nibble = _mm256_set1_epi8(0x0F);
+
+        __m256i previous = _mm256_setzero_si256(), incomplete = _mm256_setzero_si256();
+        const char *ptr = start;
+
+        for (; end - ptr >= 32; ptr += 32) {
+            const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr));
+            __m256i error = incomplete;
+
+            if (_mm256_movemask_epi8(block)) {
+                // The block shifted right by one to three bytes, with the end of the previous block shifted in
+                const __m256i carried = _mm256_permute2x128_si256(previous, block, 0x21);
+                const __m256i prev1 = _mm256_alignr_epi8(block, carried, 15);
+                const __m256i prev2 = _mm256_alignr_epi8(block, carried, 14);
+                const __m256i prev3 = _mm256_alignr_epi8(block, carried, 13);
+
+                const __m256i special = _mm256_and_si256(
+                    _mm256_and_si256(
+                        _mm256_shuffle_epi8(byte_1_high, _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble)),
+                        _mm256_shuffle_epi8(byte_1_low, _mm256_and_si256(prev1, nibble))
+                    ),
+                    _mm256_shuffle_epi8(byte_2_high, _mm256_and_si256(_mm256_srli_epi16(block, 4), nibble))
+                );
+
+                const __m256i must_continue = _mm256_and_si256(
+                    _mm256_or_si256(
+                        _mm256_subs_epu8(prev2, _mm256_set1_epi8(static_cast<char>(0xE0 - 0x80))),
+                        _mm256_subs_epu8(prev3, _mm256_set1_epi8(static_cast<char>(0xF0 - 0x80)))
+                    ),
+                    _mm256_set1_epi8(static_cast<char>(0x80))
+                );
+
+                error = _mm256_xor_si256(must_continue, special);
+                incomplete = _mm256_subs_epu8(block, incomplete_max);
+            } else {
+                incomplete = _mm256_setzero_si256();
+            }
+
+            if (!_mm256_testz_si256(error, error))
+                break;
+
+            previous = block;
+        }
+
+        return validate_utf8_sse2(rewind_to_lead(start, ptr), end);
+    }
+
+#endif
+
+    struct scan_kernels {
+        std::string_view name;
+
+        const char* (*skip_whitespace)(const char*, const char*);
+        const char* (*skip_block_comment)(const char*, const char*);
+        const char* (*find_string_end)(const char*, const char*);
+        const char* (*validate_utf8)(const char*, const char*);
+    };
+
+    scan_kernels select_kernels() {
+#ifdef LEX_SIMD_X86
+        __builtin_cpu_init();
+
+        if (__builtin_cpu_supports("avx2"))
+            return { "avx2", skip_whitespace_avx2, skip_block_comment_avx2, find_string_end_avx2, validate_utf8_avx2 };
+
+        if (__builtin_cpu_supports("sse2"))
+            return { "sse2", skip_whitespace_sse2, skip_block_comment_sse2, find_string_end_sse2, validate_utf8_sse2 };
+#endif
+
+        return { "scalar", skip_whitespace_scalar, skip_block_comment_scalar, find_string_end_scalar, validate_utf8_scalar };
+    }
+
+    const scan_kernels& kernels() {
+        static const scan_kernels selected = select_kernels();
+        return selected;
+    }
+}
+
+const char* lex::simd::skip_whitespace(const char* start, const char* end) {
+    return kernels().skip_whitespace(start, end);
+}
+
+const char* lex::simd::find_char(const char* start, const char* end, const char c) {
+    // memchr is already vectorized by every libc worth using
+    return find_char_scalar(start, end, c);
+}
+
+const char* lex::simd::skip_block_comment(const char* start, const char* end) {
+    return kernels().skip_block_comment(start, end);
+}
+
+const char* lex::simd::find_string_end(const char* start, const char* end) {
+    return kernels().find_string_end(start, end);
+}
+
+const char* lex::simd::validate_utf8(const char* start, const char* end) {
+    return kernels().validate_utf8(start, end);
+}
+
+std::string_view lex::simd::active_kernels() {
+    return kernels().name;
+}
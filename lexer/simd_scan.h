@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string_view>
+
+namespace lex::simd {
+    /**
+     *  SIMD Scan Kernels
+     *  -----------------
+     *  Bulk scanning routines for the parts of a source file the lexer does not
+     *  turn into tokens. Each routine has a scalar, SSE2 and AVX2 implementation;
+     *  the widest one supported by the running CPU is picked once at startup.
+     *  None of them read past end, so they are safe on memory-mapped buffers.
+     */
+
+    // First character in [start, end) which is not whitespace, or end
+    const char* skip_whitespace(const char* start, const char* end);
+
+    // First occurrence of c in [start, end), or end
+    const char* find_char(const char* start, const char* end, char c);
+
+    // The character after the first "*/" in [start, end), or end if the comment is unterminated
+    const char* skip_block_comment(const char* start, const char* end);
+
+    // The first unescaped double quote in [start, end), or end
+    const char* find_string_end(const char* start, const char* end);
+
+    // The first byte in [start, end) which is not part of a valid UTF-8 sequence, or end
+    const char* validate_utf8(const char* start, const char* end);
+
+    // Name of the kernel set selected for this CPU ("avx2", "sse2" or "scalar")
+    std::string_view active_kernels();
+}
@@ -0,0 +1,38 @@
+#include "source_location.h"
+
+#include <algorithm>
+#include <functional>
+
+#include "simd_scan.h"
+
+using namespace lex;
+
+void line_table::build() const {
+    const char *ptr = source.data();
+    const char *end = source.data() + source.size();
+
+    line_starts.push_back(0);
+
+    while ((ptr = simd::find_char(ptr, end, '\n')) != end)
+        line_starts.push_back(static_cast<uint32_t>(++ptr - source.data()));
+}
+
+source_location line_table::locate(const uint32_t offset) const {
+    std::call_once(built, [this] { build(); });
+
+    const auto line = std::ranges::upper_bound(line_starts, offset) - 1;
+
+    return source_location {
+        static_cast<uint32_t>(line - line_starts.begin() + 1),
+        offset - *line + 1
+    };
+}
+
+std::optional<source_location> line_table::locate(const std::string_view where) const {
+    const std::less_equal<const char*> before;
+
+    if (!before(source.data(), where.data()) || !before(where.data(), source.data() + source.size()))
+        return std::nullopt;
+
+    return locate(static_cast<uint32_t>(where.data() - source.data()));
+}
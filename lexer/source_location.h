@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace lex {
+    // 1-based line and byte column
+    struct source_location {
+        uint32_t line;
+        uint32_t column;
+    };
+
+    /**
+     *  Line Table: Lazy Offset to Line/Column Map
+     *  ------------------------------------------
+     *  Holds the offset of every line start in a source buffer, which maps any
+     *  offset to a line by binary search. The table is only built the first time
+     *  a location is asked for, so compiling a file without diagnostics never
+     *  pays for it.
+     */
+    class line_table {
+    public:
+        explicit line_table(std::string_view source) : source(source) {}
+
+        source_location locate(uint32_t offset) const;
+
+        // The location of a view into the source, or nullopt if it points elsewhere
+        std::optional<source_location> locate(std::string_view where) const;
+
+    private:
+        void build() const;
+
+        std::string_view source;
+
+        mutable std::vector<uint32_t> line_starts;
+        mutable std::once_flag built;
+    };
+
+    /**
+     *  Source Error: Diagnostic with a Position
+     *  ----------------------------------------
+     *  A runtime_error that also remembers which part of the source it is about,
+     *  as a view into the buffer being compiled. Whoever owns that buffer turns
+     *  the view into a line and column once the error reaches them.
+     */
+    class source_error : public std::runtime_error {
+    public:
+        source_error(const std::string& message, const std::string_view where)
+            : std::runtime_error(message), location(where) {}
+
+        std::string_view where() const { return location; }
+
+    private:
+        std::string_view location;
+    };
+}
@@ -0,0 +1,90 @@
+#include "unicode.h"
+
+#include <algorithm>
+#include <format>
+#include <span>
+
+#include "simd_scan.h"
+#include "source_location.h"
+#include "unicode_tables.h"
+
+using namespace lex;
+
+code_point lex::decode_utf8(const char* ptr, const char* end) {
+    const auto lead = static_cast<uint8_t>(*ptr);
+
+    if (lead < 0x80)
+        return { lead, 1 };
+
+    // Allowed range of the second byte, which is narrowed for the leads that could otherwise
+    // encode an overlong form, a surrogate, or a code point past U+10FFFF
+    uint8_t length, low = 0x80, high = 0xBF;
+    char32_t value;
+
+    if (lead >= 0xC2 && lead <= 0xDF) {
+        length = 2;
+        value = lead & 0x1F;
+    } else if (lead >= 0xE0 && lead <= 0xEF) {
+        length = 3;
+        value = lead & 0x0F;
+        low = lead == 0xE0 ? 0xA0 : low;
+        high = lead == 0xED ? 0x9F : high;
+    } else if (lead >= 0xF0 && lead <= 0xF4) {
+        length = 4;
+        value = lead & 0x07;
+        low = lead == 0xF0 ? 0x90 : low;
+        high = lead == 0xF4 ? 0x8F : high;
+    } else {
+        return {};
+    }
+
+    if (end - ptr < length)
+        return {};
+
+    const auto second = static_cast<uint8_t>(ptr[1]);
+
+    if (second < low || second > high)
+        return {};
+
+    value = value << 6 | (second & 0x3F);
+
+    for (uint8_t i = 2; i < length; i++) {
+        if (!is_utf8_continuation(ptr[i]))
+            return {};
+
+        value = value << 6 | (static_cast<uint8_t>(ptr[i]) & 0x3F);
+    }
+
+    return { value, length };
+}
+
+std::string_view lex::enclosing_code_points(const std::string_view text, size_t begin, size_t end) {
+    // No code point is longer than four bytes, so at most three continuation bytes sit on either side
+    for (int i = 0; i < 3 && begin > 0 && begin < text.size() && is_utf8_continuation(text[begin]); i++)
+        begin--;
+
+    for (int i = 0; i < 3 && end < text.size() && is_utf8_continuation(text[end]); i++)
+        end++;
+
+    return text.substr(begin, end - begin);
+}
+
+void lex::validate_utf8(const std::string_view text) {
+    const char *invalid = simd::validate_utf8(text.data(), text.data() + text.size());
+
+    if (invalid != text.data() + text.size())
+        throw source_error(std::format("Invalid UTF-8 byte: 0x{:02X}", static_cast<uint8_t>(*invalid)), { invalid, 1 });
+}
+
+bool in_ranges(const std::span<const code_point_range> ranges, const char32_t code) {
+    const auto range = std::ranges::lower_bound(ranges, code, {}, &code_point_range::last);
+    return range != ranges.end() && range->first <= code;
+}
+
+bool lex::is_xid_start(const char32_t code) {
+    return in_ranges(XID_START_RANGES, code);
+}
+
+bool lex::is_xid_continue(const char32_t code) {
+    return in_ranges(XID_CONTINUE_RANGES, code);
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+namespace lex {
+    struct code_point {
+        char32_t value = 0;
+
+        // Bytes the code point takes up, or 0 if the bytes are not valid UTF-8
+        uint8_t length = 0;
+    };
+
+    // Decodes the code point starting at ptr, rejecting overlong forms, surrogates and truncated sequences
+    code_point decode_utf8(const char* ptr, const char* end);
+
+    constexpr bool is_utf8_continuation(const char c) {
+        return (static_cast<uint8_t>(c) & 0xC0) == 0x80;
+    }
+
+    // The smallest part of text holding [begin, end) that starts and ends on code point boundaries
+    std::string_view enclosing_code_points(std::string_view text, size_t begin, size_t end);
+
+    // Throws a source_error at the first byte of text which is not valid UTF-8
+    void validate_utf8(std::string_view text);
+
+    // Only meaningful for non-ASCII code points, ASCII identifiers go through the lexer's class table
+    bool is_xid_start(char32_t code);
+    bool is_xid_continue(char32_t code);
+}
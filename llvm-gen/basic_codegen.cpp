@@ -3,6 +3,7 @@
 #include "types.h"
 #include "operators.h"
 #include "data.h"
+#include "expressions.h"
 #include "../ast/util.h"
 
 #include <llvm/IR/Module.h>
@@ -99,13 +100,18 @@ llvm::Value* literal::generate_code(cg::scope_data &scope) const {
         using namespace ast::nodes;
         case UINT:
             return llvm::ConstantInt::get(scope.context,
-                    llvm::APInt(type_size, std::get<unsigned int>(value))
+                    llvm::APInt(type_size, std::get<uint64_t>(value))
             );
         case INT:
             return llvm::ConstantInt::get(scope.context,
-                    llvm::APInt(type_size, std::get<int>(value))
+                    llvm::APInt(type_size, std::get<int64_t>(value), true)
             );
         case FLOAT:
+            if (suffix == intrinsic_type::f32)
+                return llvm::ConstantFP::get(scope.context,
+                        llvm::APFloat(static_cast<float>(std::get<double>(value)))
+                );
+
             return llvm::ConstantFP::get(scope.context,
                     llvm::APFloat(std::get<double>(value))
             );
@@ -115,7 +121,7 @@ llvm::Value* literal::generate_code(cg::scope_data &scope) const {
             );
         case STRING:
             return scope.builder.CreateGlobalStringPtr(
-                stringify(std::get<std::string_view>(value))
+                std::get<std::string_view>(value)
             );
         default:
             std::unreachable();
@@ -123,59 +129,15 @@ llvm::Value* literal::generate_code(cg::scope_data &scope) const {
 }
 
 llvm::Value* cast::generate_code(cg::scope_data &scope) const {
-    auto *expr_val = cg::load_if_ref(expr, scope);
-    auto *llvm_cast_type = get_llvm_type(cast_type, scope);
-
-    auto expr_type = expr->get_type();
-
-    if (auto *binop = dynamic_cast<bin_op*>(expr.get())) {
-        if (binop->type == bin_op_type::acc) {
-            expr_type.pointer_depth--;
-        }
-    }
-
-    if (expr_type.pointer_depth == cast_type.pointer_depth
-    &&  expr_type.type == cast_type.type)
-        return expr_val;
-
-    if (expr_type.is_pointer() && cast_type.is_pointer())
-        return scope.builder.CreatePointerCast(expr_val, llvm_cast_type);
-
-    if (!expr_type.is_intrinsic() || !cast_type.is_intrinsic())
-        throw std::runtime_error("Cannot cast non-intrinsic types.");
-
-    if (expr_type.is_int() && cast_type.is_int())
-        return scope.builder.CreateIntCast(expr_val, llvm_cast_type, cast_type.is_signed());
-
-    if (!expr_type.is_int() && !cast_type.is_int())
-        return scope.builder.CreateFPCast(expr_val, llvm_cast_type);
-
-    if (expr_type.is_int() && cast_type.is_fp()) {
-        if (expr_type.is_signed())
-            return scope.builder.CreateSIToFP(expr_val, llvm_cast_type);
-        else
-            return scope.builder.CreateUIToFP(expr_val, llvm_cast_type);
-    }
-
-    if (expr_type.is_fp() && cast_type.is_int()) {
-        if (cast_type.is_signed())
-            return scope.builder.CreateFPToSI(expr_val, llvm_cast_type);
-        else
-            return scope.builder.CreateFPToUI(expr_val, llvm_cast_type);
-    }
-
-    throw std::runtime_error("Invalid cast.");
+    return cg::generate_expression(*this, scope);
 }
 
 llvm::Value* load::generate_code(cg::scope_data &scope) const {
-    return scope.builder.CreateLoad(
-        get_llvm_type(get_type().dereference(), scope),
-        expr->generate_code(scope)
-    );
+    return cg::generate_expression(*this, scope);
 }
 
 llvm::Value* expression_shield::generate_code(cg::scope_data &scope) const {
-    return expr->generate_code(scope);
+    return cg::generate_expression(*this, scope);
 }
 
 llvm::Value* initializer_list::generate_code(cg::scope_data &scope) const {
@@ -183,18 +145,7 @@ llvm::Value* initializer_list::generate_code(cg::scope_data &scope) const {
 }
 
 llvm::Value* struct_initializer::generate_code(cg::scope_data &scope) const {
-    auto struct_def = scope.get_struct(struct_type);
-    auto struct_size = struct_def.field_decls.size();
-
-    llvm::Value* aggregate = llvm::UndefValue::get(struct_def.struct_type);
-
-    for (auto i = 0; i < struct_size; ++i) {
-        auto *val = cg::load_if_ref(values[i], scope);
-
-        aggregate = scope.builder.CreateInsertValue(aggregate, val, i);
-    }
-
-    return aggregate;
+    return cg::generate_expression(*this, scope);
 }
 
 llvm::Value* array_initializer::generate_code(cg::scope_data &scope) const {
@@ -218,21 +169,7 @@ llvm::Value* initialization::generate_code(cg::scope_data &scope) const {
 }
 
 llvm::Value* method_call::generate_code(cg::scope_data &scope) const {
-    llvm::Function* func = scope.functions_table->at(method_name).get(scope);
-
-    if (!func)
-        throw std::runtime_error("Function not found.");
-
-    std::vector<llvm::Value*> args;
-
-    for (auto &arg : arguments) {
-        args.emplace_back(cg::load_if_ref(arg, scope));
-    }
-
-    if (arguments.size() != func->arg_size() && !func->isVarArg())
-        throw std::runtime_error("Argument count mismatch.");
-
-    return scope.builder.CreateCall(func, args);
+    return cg::generate_expression(*this, scope);
 }
 
 llvm::Value* var_ref::generate_code(cg::scope_data &scope) const {
@@ -251,7 +188,7 @@ llvm::Value* return_op::generate_code(cg::scope_data &scope) const {
     return scope.builder.CreateRetVoid();
 }
 
-llvm::Value* conditional_expression(const std::unique_ptr<ast::nodes::expression> &condition, cg::scope_data &scope) {
+llvm::Value* conditional_expression(const ast::nodes::node_ptr<ast::nodes::expression> &condition, cg::scope_data &scope) {
     auto cond = condition->generate_code(scope);
     return attempt_cast(cond, llvm::Type::getInt1Ty(scope.context), scope);
 }
@@ -423,9 +360,9 @@ llvm::Function* function_prototype::generate_code(cg::scope_data &scope) const {
 
     scope.functions_table->at(fn_name).function = func;
 
-    if (implementation) {
+    if (const auto *body = get_implementation()) {
         scope.current_function = func;
-        implementation->generate_code(scope);
+        body->generate_code(scope);
         scope.current_function = nullptr;
     }
 
@@ -483,49 +420,15 @@ llvm::Value *struct_declaration::generate_code(cg::scope_data &scope) const {
 }
 
 llvm::Value* un_op::generate_code(cg::scope_data &scope) const {
-    auto *val = value->generate_code(scope);
-
-    switch (type) {
-        using namespace ast::nodes;
-        case un_op_type::log_not:
-            return scope.builder.CreateNot(val);
-        case un_op_type::bit_not:
-            if (!val->getType()->isIntegerTy())
-                throw std::runtime_error("Cannot perform bitwise NOT on non-integer type.");
-
-            return scope.builder.CreateBinOp(
-                    llvm::Instruction::BinaryOps::Xor,
-                    val, llvm::ConstantInt::get(val->getType(), -1)
-            );
-        case un_op_type::negate:
-            if (val->getType()->isIntegerTy())
-                return scope.builder.CreateNeg(val);
-            else if (val->getType()->isFloatingPointTy())
-                return scope.builder.CreateFNeg(val);
-            else
-                throw std::runtime_error("Cannot negate non-numeric type.");
-        default:
-            throw std::runtime_error("Unknown unary operator.");
-    }
+    return cg::generate_expression(*this, scope);
 }
 
 llvm::Value* bin_op::generate_code(cg::scope_data &scope) const {
-    return cg::generate_bin_op(left, right, type, scope);
+    return cg::generate_expression(*this, scope);
 }
 
 llvm::Value* assignment::generate_code(cg::scope_data &scope) const {
-    llvm::Value *l_val = lhs->generate_code(scope);
-    llvm::Value *r_val = load_if_ref(rhs, scope);
-
-    if (op) {
-        r_val = scope.builder.CreateBinOp(
-            get_llvm_binop(*op, r_val->getType()->isFloatingPointTy()),
-            load_if_ref(lhs, scope),
-            r_val
-        );
-    }
-
-    return scope.builder.CreateStore(r_val, l_val);
+    return cg::generate_expression(*this, scope);
 }
 
 llvm::Function *cg::function_definition::get(scope_data &scope) {
@@ -0,0 +1,348 @@
+#include "expressions.h"
+
+#include <span>
+#include <stdexcept>
+#include <variant>
+#include <vector>
+
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/IRBuilder.h>
+
+#include "basic_codegen.h"
+#include "data.h"
+#include "operators.h"
+#include "types.h"
+#include "../ast/util.h"
+
+using namespace ast;
+using namespace cg;
+
+namespace {
+    // An operand a node needs generated before it can go on, and whether it is wanted loaded
+    struct operand_request {
+        const nodes::expression *node;
+        bool load;
+    };
+
+    // A node being generated. The values of the operands it has asked for so far sit on the value stack
+    // from base up, in the order they were asked for.
+    struct frame {
+        const nodes::expression *node;
+        bool load;
+        uint32_t step = 0;
+        size_t base = 0;
+
+        // Carried between steps: a call's callee, or a struct initializer's aggregate so far
+        llvm::Value *held = nullptr;
+    };
+
+    // Either the next operand the node needs, or its value once it has them all
+    using step = std::variant<operand_request, llvm::Value*>;
+
+    operand_request operand(const nodes::node_ptr<nodes::expression> &expr, const bool load) {
+        return { expr.get(), load };
+    }
+
+    llvm::Value* convert(const nodes::cast &cast, llvm::Value *expr_val, scope_data &scope) {
+        auto *llvm_cast_type = get_llvm_type(cast.cast_type, scope);
+        const auto &cast_type = cast.cast_type;
+
+        auto expr_type = cast.expr->get_type();
+
+        if (auto *binop = dynamic_cast<nodes::bin_op*>(cast.expr.get())) {
+            if (binop->type == nodes::bin_op_type::acc) {
+                expr_type.pointer_depth--;
+            }
+        }
+
+        if (expr_type.pointer_depth == cast_type.pointer_depth
+        &&  expr_type.type == cast_type.type)
+            return expr_val;
+
+        if (expr_type.is_pointer() && cast_type.is_pointer())
+            return scope.builder.CreatePointerCast(expr_val, llvm_cast_type);
+
+        if (!expr_type.is_intrinsic() || !cast_type.is_intrinsic())
+            throw std::runtime_error("Cannot cast non-intrinsic types.");
+
+        if (expr_type.is_int() && cast_type.is_int())
+            return scope.builder.CreateIntCast(expr_val, llvm_cast_type, cast_type.is_signed());
+
+        if (!expr_type.is_int() && !cast_type.is_int())
+            return scope.builder.CreateFPCast(expr_val, llvm_cast_type);
+
+        if (expr_type.is_int() && cast_type.is_fp()) {
+            if (expr_type.is_signed())
+                return scope.builder.CreateSIToFP(expr_val, llvm_cast_type);
+            else
+                return scope.builder.CreateUIToFP(expr_val, llvm_cast_type);
+        }
+
+        if (expr_type.is_fp() && cast_type.is_int()) {
+            if (cast_type.is_signed())
+                return scope.builder.CreateFPToSI(expr_val, llvm_cast_type);
+            else
+                return scope.builder.CreateFPToUI(expr_val, llvm_cast_type);
+        }
+
+        throw std::runtime_error("Invalid cast.");
+    }
+
+    llvm::Value* apply_un_op(const nodes::un_op &op, llvm::Value *val, scope_data &scope) {
+        switch (op.type) {
+            using namespace ast::nodes;
+            case un_op_type::log_not:
+                return scope.builder.CreateNot(val);
+            case un_op_type::bit_not:
+                if (!val->getType()->isIntegerTy())
+                    throw std::runtime_error("Cannot perform bitwise NOT on non-integer type.");
+
+                return scope.builder.CreateBinOp(
+                        llvm::Instruction::BinaryOps::Xor,
+                        val, llvm::ConstantInt::get(val->getType(), -1)
+                );
+            case un_op_type::negate:
+                if (val->getType()->isIntegerTy())
+                    return scope.builder.CreateNeg(val);
+                else if (val->getType()->isFloatingPointTy())
+                    return scope.builder.CreateFNeg(val);
+                else
+                    throw std::runtime_error("Cannot negate non-numeric type.");
+            default:
+                throw std::runtime_error("Unknown unary operator.");
+        }
+    }
+
+    llvm::Value* compare(const nodes::bin_op &op, llvm::Value *lhs, llvm::Value *rhs, scope_data &scope) {
+        auto l_type = op.left->get_type();
+
+        if (l_type.is_fp()) {
+            return scope.builder.CreateFCmp(
+                    *pm::find_element(cg::f_cmp_map, op.type),
+                    lhs, rhs
+            );
+        } else if (l_type.is_int()) {
+            auto i_cmp = *pm::find_element(cg::i_cmp_map, op.type);
+
+            if (op.type == nodes::bin_op_type::eq || op.type == nodes::bin_op_type::neq)
+                return scope.builder.CreateICmp(i_cmp, lhs, rhs);
+
+            if (l_type.is_signed())
+                i_cmp = static_cast<llvm::CmpInst::Predicate>(i_cmp + 4);
+
+            return scope.builder.CreateICmp(
+                    i_cmp,
+                    lhs, rhs
+            );
+        }
+
+        throw std::runtime_error("Invalid comparison type.");
+    }
+
+    struct member {
+        llvm::StructType *struct_type;
+        unsigned index;
+    };
+
+    // The struct field an access to a non-pointer names
+    member member_of(const nodes::bin_op &access, const nodes::variable_type &l_type, scope_data &scope) {
+        const auto *get_var = dynamic_cast<nodes::var_ref*>(access.right.get());
+
+        if (!get_var)
+            throw std::runtime_error("Accessing non-member of a struct");
+
+        if (l_type.is_intrinsic())
+            throw std::runtime_error("Cannot access member of intrinsic type!");
+
+        auto struct_name = std::get<std::string_view>(l_type.type);
+        auto &struct_decl = scope.get_struct(struct_name);
+
+        auto field_index = std::ranges::find_if(struct_decl.field_decls, [get_var] (const auto &field) {
+            return field.var_name == get_var->var_name;
+        });
+
+        if (field_index == struct_decl.field_decls.end())
+            throw std::runtime_error("Invalid right side of accessor.");
+
+        return { struct_decl.struct_type, static_cast<unsigned>(std::distance(struct_decl.field_decls.begin(), field_index)) };
+    }
+
+    step advance_bin_op(const nodes::bin_op &op, frame &top, const std::span<llvm::Value* const> operands, scope_data &scope) {
+        if (op.type == nodes::bin_op_type::acc) {
+            const auto l_type = op.left->get_type();
+
+            if (l_type.is_pointer()) {
+                switch (top.step++) {
+                    case 0: return operand(op.left, true);
+                    case 1: return operand(op.right, true);
+                    default: break;
+                }
+
+                return scope.builder.CreateGEP(get_llvm_type(l_type, scope), operands[0], operands[1]);
+            }
+
+            // Checked before the struct itself is generated, so a bad access fails before emitting anything
+            const auto [struct_type, index] = member_of(op, l_type, scope);
+
+            if (top.step++ == 0)
+                return operand(op.left, false);
+
+            return scope.builder.CreateStructGEP(struct_type, operands[0], index);
+        }
+
+        const bool is_basic = cg::binop_map.contains(op.type);
+
+        if (!is_basic && !cg::i_cmp_map.contains(op.type) && !cg::f_cmp_map.contains(op.type))
+            throw std::runtime_error("Invalid binary operator.");
+
+        switch (top.step++) {
+            case 0: return operand(op.left, true);
+            case 1: return operand(op.right, true);
+            default: break;
+        }
+
+        if (!is_basic)
+            return compare(op, operands[0], operands[1], scope);
+
+        return scope.builder.CreateBinOp(
+                get_llvm_binop(op.type, operands[0]->getType()->isFloatingPointTy()),
+                operands[0], operands[1]);
+    }
+
+    // Takes the next step of generating the node at the top of the stack
+    step advance(frame &top, const std::span<llvm::Value* const> operands, scope_data &scope) {
+        const auto *node = top.node;
+
+        // Where loading a value differs from generating it
+        if (top.load) {
+            if (const auto *ref = dynamic_cast<const nodes::var_ref*>(node)) {
+                // If the variable is the name of a struct field, then it should not be loaded
+                if (ref->type)
+                    return scope.builder.CreateLoad(get_llvm_type(ref->get_type(), scope), ref->generate_code(scope));
+            } else if (const auto *access = dynamic_cast<const nodes::bin_op*>(node)) {
+                if (access->type == nodes::bin_op_type::acc) {
+                    if (top.step++ == 0)
+                        return operand_request { node, false };
+
+                    return scope.builder.CreateLoad(get_llvm_type(access->get_type().dereference(), scope), operands[0]);
+                }
+            } else if (const auto *cast = dynamic_cast<const nodes::cast*>(node)) {
+                if (top.step++ == 0)
+                    return operand(cast->expr, false);
+
+                return attempt_cast(operands[0], get_llvm_type(cast->get_type(), scope), scope);
+            }
+        }
+
+        if (const auto *op = dynamic_cast<const nodes::bin_op*>(node))
+            return advance_bin_op(*op, top, operands, scope);
+
+        if (const auto *assn = dynamic_cast<const nodes::assignment*>(node)) {
+            switch (top.step++) {
+                case 0: return operand(assn->lhs, false);
+                case 1: return operand(assn->rhs, true);
+                case 2: if (assn->op) return operand(assn->lhs, true);
+                default: break;
+            }
+
+            llvm::Value *r_val = operands[1];
+
+            if (assn->op) {
+                r_val = scope.builder.CreateBinOp(
+                    get_llvm_binop(*assn->op, r_val->getType()->isFloatingPointTy()),
+                    operands[2],
+                    r_val
+                );
+            }
+
+            return scope.builder.CreateStore(r_val, operands[0]);
+        }
+
+        if (const auto *op = dynamic_cast<const nodes::un_op*>(node)) {
+            if (top.step++ == 0)
+                return operand(op->value, false);
+
+            return apply_un_op(*op, operands[0], scope);
+        }
+
+        if (const auto *call = dynamic_cast<const nodes::method_call*>(node)) {
+            if (top.step == 0) {
+                top.held = scope.functions_table->at(call->method_name).get(scope);
+
+                if (!top.held)
+                    throw std::runtime_error("Function not found.");
+            }
+
+            if (top.step < call->arguments.size())
+                return operand(call->arguments[top.step++], true);
+
+            auto *func = llvm::cast<llvm::Function>(top.held);
+
+            if (call->arguments.size() != func->arg_size() && !func->isVarArg())
+                throw std::runtime_error("Argument count mismatch.");
+
+            return scope.builder.CreateCall(func, llvm::ArrayRef<llvm::Value*> { operands.data(), operands.size() });
+        }
+
+        if (const auto *cast = dynamic_cast<const nodes::cast*>(node)) {
+            if (top.step++ == 0)
+                return operand(cast->expr, true);
+
+            return convert(*cast, operands[0], scope);
+        }
+
+        if (const auto *load = dynamic_cast<const nodes::load*>(node)) {
+            if (top.step++ == 0)
+                return operand(load->expr, false);
+
+            return scope.builder.CreateLoad(get_llvm_type(load->get_type().dereference(), scope), operands[0]);
+        }
+
+        if (const auto *shield = dynamic_cast<const nodes::expression_shield*>(node)) {
+            if (top.step++ == 0)
+                return operand(shield->expr, false);
+
+            return operands[0];
+        }
+
+        if (const auto *init = dynamic_cast<const nodes::struct_initializer*>(node)) {
+            const auto &struct_def = scope.get_struct(init->struct_type);
+
+            // Each field is inserted as soon as its value is generated
+            if (top.step == 0)
+                top.held = llvm::UndefValue::get(struct_def.struct_type);
+            else
+                top.held = scope.builder.CreateInsertValue(top.held, operands[top.step - 1], top.step - 1);
+
+            if (top.step < struct_def.field_decls.size())
+                return operand(init->values[top.step++], true);
+
+            return top.held;
+        }
+
+        // Nothing else has operands of its own to walk
+        return node->generate_code(scope);
+    }
+}
+
+llvm::Value* cg::generate_expression(const nodes::expression &expr, scope_data &scope, const bool load) {
+    std::vector<frame> frames { { &expr, load } };
+    std::vector<llvm::Value*> values;
+
+    while (true) {
+        auto &top = frames.back();
+        const auto next = advance(top, std::span<llvm::Value* const> { values }.subspan(top.base), scope);
+
+        if (const auto *request = std::get_if<operand_request>(&next)) {
+            frames.push_back({ request->node, request->load, 0, values.size() });
+            continue;
+        }
+
+        values.resize(top.base);
+        values.push_back(std::get<llvm::Value*>(next));
+        frames.pop_back();
+
+        if (frames.empty())
+            return values.back();
+    }
+}
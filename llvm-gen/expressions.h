@@ -0,0 +1,25 @@
+#pragma once
+
+#include "../ast/data/ast_nodes.h"
+
+namespace llvm {
+    class Value;
+}
+
+namespace cg {
+    struct scope_data;
+
+    /**
+     *  Generate Expression: Iterative Expression Codegen
+     *  -------------------------------------------------
+     *  Generates an expression with an explicit stack of the nodes still in
+     *  progress rather than by recursing into each operand, so the depth of an
+     *  expression is bounded by memory rather than by the call stack. Operators,
+     *  assignments, calls, casts, loads and struct initializers are walked this
+     *  way, and every other node is generated by its own generate_code.
+     *
+     *  With load set, the value is loaded the way load_if_ref loads it, rather
+     *  than left as the address an assignment would store to.
+     */
+    llvm::Value* generate_expression(const ast::nodes::expression &expr, scope_data &scope, bool load = false);
+}
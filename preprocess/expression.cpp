@@ -0,0 +1,293 @@
+#include "expression.hpp"
+
+#include <array>
+#include <charconv>
+#include <format>
+#include <limits>
+#include <string>
+
+#include "../lexer/derive_lex.h"
+#include "../lexer/source_location.h"
+
+using namespace pp;
+
+namespace {
+    struct binary_operator {
+        std::string_view spelling;
+        int precedence;
+    };
+
+    // Longer spellings come first, so "<<" is never read as "<"
+    constexpr std::array<binary_operator, 18> BINARY_OPERATORS {{
+        { "||", 1 }, { "&&", 2 },
+        { "==", 6 }, { "!=", 6 },
+        { "<<", 8 }, { ">>", 8 },
+        { "<=", 7 }, { ">=", 7 },
+        { "|", 3 }, { "^", 4 }, { "&", 5 },
+        { "<", 7 }, { ">", 7 },
+        { "+", 9 }, { "-", 9 },
+        { "*", 10 }, { "/", 10 }, { "%", 10 },
+    }};
+
+    bool is_digit(const char c) {
+        return c >= '0' && c <= '9';
+    }
+
+    class evaluator {
+    public:
+        evaluator(const std::string_view expr, const macro_table &macros)
+            : expr(expr), macros(macros) {}
+
+        int64_t run() {
+            const auto value = conditional();
+            skip_space();
+
+            if (pos < expr.size())
+                fail("Unexpected text in expression");
+
+            return value;
+        }
+
+    private:
+        std::string_view expr;
+        const macro_table &macros;
+        size_t pos = 0;
+
+        // Cleared while reading an operand whose value is never used, which then cannot fail
+        bool live = true;
+
+        [[noreturn]] void fail(const std::string &message) const {
+            const auto where = pos < expr.size() ? expr.substr(pos) : expr.substr(expr.empty() ? 0 : expr.size() - 1);
+            throw lex::source_error(message, where);
+        }
+
+        void skip_space() {
+            while (pos < expr.size() && (expr[pos] == ' ' || expr[pos] == '\t' || expr[pos] == '\r'))
+                pos++;
+        }
+
+        bool accept(const std::string_view token) {
+            skip_space();
+
+            if (!expr.substr(pos).starts_with(token))
+                return false;
+
+            pos += token.size();
+            return true;
+        }
+
+        void expect(const std::string_view token) {
+            if (!accept(token))
+                fail(std::format("Expected '{}'", token));
+        }
+
+        int64_t conditional() {
+            const auto condition = binary(1);
+
+            if (!accept("?"))
+                return condition;
+
+            const bool was_live = live;
+
+            live = was_live && condition;
+            const auto if_true = conditional();
+            expect(":");
+
+            live = was_live && !condition;
+            const auto if_false = conditional();
+
+            live = was_live;
+            return condition ? if_true : if_false;
+        }
+
+        // Precedence climbing over the operators which bind at least as tightly as min_precedence
+        int64_t binary(const int min_precedence) {
+            auto lhs = unary();
+
+            while (const auto *op = peek_operator(min_precedence)) {
+                pos += op->spelling.size();
+
+                const bool was_live = live;
+
+                if (op->spelling == "&&")
+                    live = was_live && lhs;
+                else if (op->spelling == "||")
+                    live = was_live && !lhs;
+
+                const auto rhs = binary(op->precedence + 1);
+
+                live = was_live;
+                lhs = apply(op->spelling, lhs, rhs);
+            }
+
+            return lhs;
+        }
+
+        const binary_operator* peek_operator(const int min_precedence) {
+            skip_space();
+            const auto rest = expr.substr(pos);
+
+            for (const auto &op : BINARY_OPERATORS) {
+                if (rest.starts_with(op.spelling))
+                    return op.precedence >= min_precedence ? &op : nullptr;
+            }
+
+            return nullptr;
+        }
+
+        int64_t apply(const std::string_view op, const int64_t lhs, const int64_t rhs) const {
+            // Arithmetic wraps rather than overflowing
+            const auto ulhs = static_cast<uint64_t>(lhs), urhs = static_cast<uint64_t>(rhs);
+
+            if (op == "+") return static_cast<int64_t>(ulhs + urhs);
+            if (op == "-") return static_cast<int64_t>(ulhs - urhs);
+            if (op == "*") return static_cast<int64_t>(ulhs * urhs);
+
+            if (op == "/" || op == "%") {
+                if (rhs == 0) {
+                    if (live)
+                        fail("Division by zero in expression");
+
+                    return 0;
+                }
+
+                if (lhs == std::numeric_limits<int64_t>::min() && rhs == -1)
+                    return op == "/" ? lhs : 0;
+
+                return op == "/" ? lhs / rhs : lhs % rhs;
+            }
+
+            if (op == "<<" || op == ">>") {
+                if (rhs < 0 || rhs >= 64) {
+                    if (live)
+                        fail("Shift count out of range in expression");
+
+                    return 0;
+                }
+
+                return op == "<<" ? static_cast<int64_t>(ulhs << rhs) : lhs >> rhs;
+            }
+
+            if (op == "<")  return lhs < rhs;
+            if (op == ">")  return lhs > rhs;
+            if (op == "<=") return lhs <= rhs;
+            if (op == ">=") return lhs >= rhs;
+            if (op == "==") return lhs == rhs;
+            if (op == "!=") return lhs != rhs;
+            if (op == "&")  return lhs & rhs;
+            if (op == "^")  return lhs ^ rhs;
+            if (op == "|")  return lhs | rhs;
+            if (op == "&&") return lhs && rhs;
+
+            return lhs || rhs;
+        }
+
+        int64_t unary() {
+            if (accept("!"))
+                return !unary();
+            if (accept("~"))
+                return ~unary();
+            if (accept("-"))
+                return static_cast<int64_t>(0 - static_cast<uint64_t>(unary()));
+            if (accept("+"))
+                return unary();
+
+            return primary();
+        }
+
+        int64_t primary() {
+            if (accept("(")) {
+                const auto value = conditional();
+                expect(")");
+
+                return value;
+            }
+
+            const auto rest = expr.substr(pos);
+
+            if (const auto length = identifier_length(rest)) {
+                const auto name = rest.substr(0, length);
+                pos += length;
+
+                if (name == "defined")
+                    return defined();
+                if (name == "true")
+                    return 1;
+                if (name == "false")
+                    return 0;
+
+                const auto value = macros.find(name);
+                return value != macros.end() ? value->second : 0;
+            }
+
+            if (!rest.empty() && is_digit(rest.front()))
+                return number();
+
+            fail("Expected an integer constant expression");
+        }
+
+        int64_t defined() {
+            const bool parenthesized = accept("(");
+            skip_space();
+
+            const auto length = identifier_length(expr.substr(pos));
+
+            if (!length)
+                fail("Expected a macro name after defined");
+
+            const auto name = expr.substr(pos, length);
+            pos += length;
+
+            if (parenthesized)
+                expect(")");
+
+            return macros.contains(name);
+        }
+
+        int64_t number() {
+            auto rest = expr.substr(pos);
+
+            // The prefixes of the language's own literals, under which a leading 0 alone is still decimal
+            const auto base = lex::radix_of(rest);
+
+            if (base != 10)
+                rest.remove_prefix(2);
+
+            uint64_t value = 0;
+            const auto [end, error] = std::from_chars(rest.data(), rest.data() + rest.size(), value, static_cast<int>(base));
+
+            if (error == std::errc::result_out_of_range || value > static_cast<uint64_t>(std::numeric_limits<int64_t>::max()))
+                fail("Integer literal is too large");
+            if (error != std::errc {})
+                fail("Invalid integer literal");
+
+            pos = static_cast<size_t>(end - expr.data());
+
+            // Suffixes, such as the type suffixes of the language's own literals, have no meaning here
+            if (pos < expr.size() && (is_digit(expr[pos]) || identifier_length(expr.substr(pos))))
+                fail("Invalid integer literal");
+
+            return static_cast<int64_t>(value);
+        }
+    };
+}
+
+size_t pp::identifier_length(const std::string_view text) {
+    const auto is_start = [](const char c) {
+        return c == '_' || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+    };
+
+    if (text.empty() || !is_start(text.front()))
+        return 0;
+
+    size_t length = 1;
+
+    while (length < text.size() && (is_start(text[length]) || is_digit(text[length])))
+        length++;
+
+    return length;
+}
+
+int64_t pp::evaluate(const std::string_view expr, const macro_table &macros) {
+    return evaluator { expr, macros }.run();
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+
+namespace pp {
+    // Macros only exist for conditional compilation, so every one has an integer value
+    using macro_table = std::unordered_map<std::string_view, int64_t>;
+
+    // The length of the identifier text starts with, or 0 if it does not start with one
+    size_t identifier_length(std::string_view text);
+
+    /**
+     *  Evaluate: Integer Constant Expression
+     *  -------------------------------------
+     *  Evaluates the condition of an #if or #elif, or the value of a #define,
+     *  with C's rules: integer literals, macro names (0 when undefined),
+     *  defined NAME / defined(NAME), the unary, binary and ternary operators,
+     *  and parentheses, all on 64-bit signed integers. Operands skipped by
+     *  &&, || or ?: are not evaluated, so 0 && 1 / 0 is not an error.
+     *
+     *  Integer literals are spelled as in the language rather than in C: a
+     *  0x, 0o or 0b prefix gives the base, 010 is ten, and a literal that does
+     *  not fit in an int64_t is an error rather than wrapping.
+     *
+     *  Errors point into expr, which is a view into its directive's line.
+     */
+    int64_t evaluate(std::string_view expr, const macro_table &macros);
+}
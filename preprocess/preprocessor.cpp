@@ -1,66 +1,321 @@
-#include <sstream>
-#include <fstream>
 #include <algorithm>
+#include <format>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <unordered_set>
 #include "preprocessor.hpp"
+#include "../ast/precompiled.h"
+#include "../lexer/source_location.h"
 
-void handle_imports(std::string_view line, std::stringstream &ss) {
-    if (line.length() < 10)
-        throw std::runtime_error("Invalid import statement");
+// Where a directive name ends, and its trimmed argument
+std::pair<std::string_view, std::string_view> split_directive(const std::string_view line) {
+    const auto trim = [](std::string_view text) {
+        const auto begin = std::min(text.find_first_not_of(" \t\r"), text.size());
+        text.remove_prefix(begin);
+        text.remove_suffix(text.size() - std::min(text.find_last_not_of(" \t\r") + 1, text.size()));
 
-    auto path = line.substr(9);
+        return text;
+    };
+
+    const auto rest = trim(line.substr(1));
+    const auto name_end = std::min(rest.find_first_of(" \t\r"), rest.size());
+
+    return { rest.substr(0, name_end), trim(rest.substr(name_end)) };
+}
+
+const std::unordered_map<std::string_view, pp::branch_kind> branch_kinds {
+    { "if",     pp::branch_kind::if_    },
+    { "ifdef",  pp::branch_kind::ifdef  },
+    { "ifndef", pp::branch_kind::ifndef },
+    { "elif",   pp::branch_kind::elif   },
+    { "else",   pp::branch_kind::else_  },
+    { "endif",  pp::branch_kind::endif  },
+};
+
+static bool pp::handle_line(std::string_view line, outline &out) {
+    if (!line.starts_with("#"))
+        return false;
+
+    const auto [directive, argument] = split_directive(line);
+
+    if (line.starts_with("#include"))
+        out.emplace_back(include_ref { line });
+    else if (directive == "define" || directive == "undef")
+        out.emplace_back(macro_directive { line, argument, directive == "undef" });
+    else if (const auto kind = branch_kinds.find(directive); kind != branch_kinds.end())
+        out.emplace_back(branch { kind->second, line, argument });
+
+    return true;
+}
+
+// Links every branch of each #if chain to the next one and to the chain's #endif
+void link_branches(pp::outline &out) {
+    // The branches so far of every chain still open, innermost last
+    std::vector<std::vector<uint32_t>> open;
+
+    for (uint32_t i = 0; i < out.size(); i++) {
+        auto *current = std::get_if<pp::branch>(&out[i]);
+
+        if (!current)
+            continue;
+
+        if (current->kind == pp::branch_kind::if_ || current->kind == pp::branch_kind::ifdef || current->kind == pp::branch_kind::ifndef) {
+            open.push_back({ i });
+            continue;
+        }
+
+        if (open.empty())
+            throw lex::source_error("Conditional directive without a matching #if", current->line);
+
+        auto &previous = std::get<pp::branch>(out[open.back().back()]);
 
-    std::ifstream inc_file { std::string(path) + ".on" };
+        if (previous.kind == pp::branch_kind::else_ && current->kind != pp::branch_kind::endif)
+            throw lex::source_error("Conditional directive after #else", current->line);
 
-    if (!inc_file.is_open())
-        inc_file = std::ifstream { "lib/" + std::string(path) + ".on" };
+        previous.next = i;
 
-    if (!inc_file.is_open())
-        throw std::runtime_error("Could not open file: " + std::string(path));
+        if (current->kind != pp::branch_kind::endif) {
+            open.back().push_back(i);
+            continue;
+        }
 
-    std::string read_line;
-    std::ostringstream code_stream;
+        for (const auto chain_branch : open.back())
+            std::get<pp::branch>(out[chain_branch]).end = i;
 
-    while (!inc_file.eof()){
-        std::getline(inc_file, read_line);
-        code_stream << read_line << '\n';
+        open.pop_back();
     }
 
-    std::string code = code_stream.str();
+    if (!open.empty())
+        throw lex::source_error("Unterminated conditional directive", std::get<pp::branch>(out[open.back().front()]).line);
+}
+
+std::optional<in::file_id> pp::include_cache::resolve(const std::string_view name, in::source_manager &sources) {
+    const std::string file_name = std::string(name) + ".on";
+
+    if (const auto existing = resolved.find(file_name); existing != resolved.end())
+        return existing->second;
 
-    pp::preprocess(code);
+    auto file = sources.load(file_name);
+
+    for (size_t i = 0; !file && i < search_paths.size(); i++) {
+        file = sources.load(search_paths[i] / file_name);
+
+        if (file)
+            libraries.insert(*file);
+    }
 
-    ss << code;
+    if (file)
+        resolved.emplace(file_name, *file);
 
-    inc_file.close();
+    return file;
 }
 
-static bool pp::handle_line(std::string_view line, std::stringstream &ss) {
-    if (!line.starts_with("#"))
-        return false;
+// Writes under a temporary name and renames it into place, so a compile running alongside never maps half a blob.
+// Failing to write, for instance to a read-only library directory, only means the blob is built again next time.
+void write_blob(const std::filesystem::path &path, const std::string_view blob) {
+    auto temp = path;
+    temp += std::format(".{}.tmp", std::random_device {}());
 
-    if (line.starts_with("#include"))
-        handle_imports(line, ss);
+    {
+        std::ofstream out { temp, std::ios::binary };
+        out.write(blob.data(), static_cast<std::streamsize>(blob.size()));
 
-    return true;
+        if (out.good()) {
+            out.close();
+
+            std::error_code error;
+            std::filesystem::rename(temp, path, error);
+
+            if (!error)
+                return;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::remove(temp, error);
 }
 
-void pp::preprocess(std::string &code) {
-    std::stringstream ss;
+std::optional<in::file_id> pp::include_cache::precompiled(const in::file_id file, in::source_manager &sources) {
+    const auto code = sources.buffer(file);
+
+    // Directives would need preprocessing, which an interface has no record of
+    if (code.starts_with('#') || code.find("\n#") != std::string_view::npos)
+        return std::nullopt;
 
-    auto line_begin = code.begin();
-    auto line_end = code.begin();
+    const auto path = std::filesystem::path { sources.name(file) }.replace_extension(".onpi");
+    const auto hash = ast::pci::content_hash(code);
 
-    while (line_end != code.end()) {
-        line_end = std::find(line_begin, code.end(), '\n');
+    if (const auto blob = sources.load(path); blob && ast::pci::is_current(sources.buffer(*blob), hash))
+        return ast::pci::is_interface(sources.buffer(*blob)) ? blob : std::nullopt;
 
-        if (!handle_line({ line_begin, line_end }, ss))
-            ss << std::string_view { line_begin, line_end } << '\n';
+    auto built = ast::pci::build(code);
+    write_blob(path, built);
+
+    const bool interface = ast::pci::is_interface(built);
+    const auto blob = sources.add_buffer(path.string(), std::move(built));
+
+    return interface ? std::make_optional(blob) : std::nullopt;
+}
 
-        if (line_end == code.end())
-            break;
+const pp::outline& pp::include_cache::scan(const in::file_id file, in::source_manager &sources) {
+    if (const auto existing = outlines.find(file); existing != outlines.end())
+        return existing->second;
 
-        line_begin = line_end + 1;
+    if (libraries.contains(file)) {
+        if (const auto blob = precompiled(file, sources))
+            return outlines.emplace(file, outline { interface_ref { *blob } }).first->second;
     }
 
-    code = ss.str();
+    const auto code = sources.buffer(file);
+    outline out;
+
+    // The run of ordinary lines since the last directive, which becomes one piece
+    size_t run_begin = 0;
+    const auto end_run = [&](const size_t run_end) {
+        if (run_end > run_begin)
+            out.emplace_back(piece { file, static_cast<uint32_t>(run_begin), static_cast<uint32_t>(run_end - run_begin) });
+    };
+
+    // Directives have to start a line, so only lines starting with '#' are looked at
+    for (size_t line_begin = code.starts_with('#') ? 0 : code.find("\n#");
+         line_begin != std::string_view::npos;
+         line_begin = code.find("\n#", line_begin)) {
+        if (code[line_begin] == '\n')
+            line_begin++;
+
+        const auto line_end = std::min(code.find('\n', line_begin), code.size());
+
+        end_run(line_begin);
+        handle_line(code.substr(line_begin, line_end - line_begin), out);
+        run_begin = std::min(line_end + 1, code.size());
+    }
+
+    end_run(code.size());
+    link_branches(out);
+
+    return outlines.emplace(file, std::move(out)).first->second;
+}
+
+// The name of the macro a directive is about, which has to be all of text unless it may be followed by a value
+std::string_view macro_name(const std::string_view text, const std::string_view line, const bool allow_value) {
+    const auto length = pp::identifier_length(text);
+
+    if (!length)
+        throw lex::source_error("Expected a macro name", text.empty() ? line : text);
+
+    if (length < text.size() && text[length] == '(')
+        throw lex::source_error("Function-like macros are not supported", text);
+
+    if (length < text.size() && (!allow_value || (text[length] != ' ' && text[length] != '\t')))
+        throw lex::source_error("Unexpected text after macro name", text.substr(length));
+
+    return text.substr(0, length);
+}
+
+void apply_macro(const pp::macro_directive &directive, pp::macro_table &macros) {
+    const auto name = macro_name(directive.text, directive.line, !directive.undefine);
+
+    if (directive.undefine) {
+        macros.erase(name);
+        return;
+    }
+
+    // The value is evaluated here, so later changes to the macros it names do not change it
+    const auto value = directive.text.substr(name.size());
+    macros[name] = value.find_first_not_of(" \t") == std::string_view::npos ? 1 : pp::evaluate(value, macros);
+}
+
+bool branch_taken(const pp::branch &branch, const pp::macro_table &macros) {
+    switch (branch.kind) {
+        case pp::branch_kind::ifdef:
+            return macros.contains(macro_name(branch.condition, branch.line, false));
+        case pp::branch_kind::ifndef:
+            return !macros.contains(macro_name(branch.condition, branch.line, false));
+        case pp::branch_kind::if_:
+        case pp::branch_kind::elif:
+            if (branch.condition.empty())
+                throw lex::source_error("Expected an expression", branch.line);
+
+            return pp::evaluate(branch.condition, macros) != 0;
+        default:
+            return true;
+    }
+}
+
+// Where splicing continues from the branch at index i: inside the branch of its chain which is taken, or after the chain
+uint32_t follow_branches(const pp::outline &out, uint32_t i, const pp::macro_table &macros) {
+    const auto &first = std::get<pp::branch>(out[i]);
+
+    // Reaching a later branch of a chain means the one before it was taken, so the rest of the chain is skipped
+    if (first.kind == pp::branch_kind::elif || first.kind == pp::branch_kind::else_)
+        return first.end + 1;
+
+    while (!branch_taken(std::get<pp::branch>(out[i]), macros))
+        i = std::get<pp::branch>(out[i]).next;
+
+    return i + 1;
+}
+
+// Resolves an #include line to a file, which is done only when the include is reached
+in::file_id resolve_include(const std::string_view line, pp::include_cache &includes, in::source_manager &sources) {
+    if (line.length() < 10)
+        throw lex::source_error("Invalid import statement", line);
+
+    auto path = line.substr(9);
+    auto inc_file = includes.resolve(path, sources);
+
+    if (!inc_file)
+        throw lex::source_error("Could not open file: " + std::string(path), path);
+
+    return *inc_file;
+}
+
+// Appends the pieces of file in its active branches, splicing in every file it includes that is not in the program yet
+void splice(const in::file_id file, pp::translation_unit &unit, std::unordered_set<in::file_id> &included,
+            pp::macro_table &macros, pp::include_cache &includes, in::source_manager &sources) {
+    const auto &out = includes.scan(file, sources);
+
+    for (uint32_t i = 0; i < out.size();) {
+        const auto &segment = out[i];
+
+        if (std::holds_alternative<pp::branch>(segment)) {
+            i = follow_branches(out, i, macros);
+            continue;
+        }
+
+        i++;
+
+        if (const auto *text = std::get_if<pp::piece>(&segment)) {
+            unit.pieces.push_back(*text);
+        } else if (const auto *interface = std::get_if<pp::interface_ref>(&segment)) {
+            unit.interfaces.push_back(interface->blob);
+        } else if (const auto *macro = std::get_if<pp::macro_directive>(&segment)) {
+            apply_macro(*macro, macros);
+        } else {
+            const auto inc_file = resolve_include(std::get<pp::include_ref>(segment).line, includes, sources);
+
+            if (included.insert(inc_file).second)
+                splice(inc_file, unit, included, macros, includes, sources);
+        }
+    }
+}
+
+void pp::define_macro(macro_table &macros, const std::string_view definition) {
+    const auto equals = definition.find('=');
+    const auto name = definition.substr(0, equals);
+
+    if (name.empty() || identifier_length(name) != name.size())
+        throw std::runtime_error(std::format("Invalid macro definition: {}", definition));
+
+    macros[name] = equals == std::string_view::npos ? 1 : evaluate(definition.substr(equals + 1), macros);
+}
+
+pp::translation_unit pp::preprocess(const in::file_id file, in::source_manager &sources, include_cache &includes, macro_table macros) {
+    translation_unit unit;
+    std::unordered_set included { file };
+
+    splice(file, unit, included, macros, includes, sources);
+
+    return unit;
 }
@@ -1,11 +1,127 @@
 #pragma once
 
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <variant>
+#include <vector>
+
+#include "expression.hpp"
+#include "../interface/source_manager.h"
+
 namespace in {
     struct file_pipeline;
 }
 
 namespace pp {
+    // A slice of one source file
+    struct piece {
+        in::file_id file;
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    /**
+     *  Piece Table: Preprocessed Program
+     *  ---------------------------------
+     *  The program after preprocessing, as the slices of its source files in
+     *  the order they are to be lexed. Directive lines are left out between
+     *  slices, and an include is replaced by the slices of the included file,
+     *  so no source text is ever copied however deeply includes are nested,
+     *  and every token can be traced back to the file it was written in.
+     */
+    using piece_table = std::vector<piece>;
+
+    // An #include line, only resolved once it is reached, so one in an inactive branch needs no file
+    struct include_ref {
+        std::string_view line;
+    };
+
+    // A library file included through its precompiled interface, see ast::pci
+    struct interface_ref {
+        in::file_id blob;
+    };
+
+    // A #define or #undef, where text is everything after the directive name
+    struct macro_directive {
+        std::string_view line, text;
+        bool undefine;
+    };
+
+    enum class branch_kind {
+        if_, ifdef, ifndef, elif, else_, endif
+    };
+
+    /**
+     *  Branch: Conditional Compilation Directive
+     *  -----------------------------------------
+     *  One directive of an #if chain, linked by outline index to the next
+     *  directive of the same chain and to the chain's #endif. A branch which
+     *  is not taken is stepped over by following next, so the text, includes
+     *  and nested chains inside an inactive region are never visited at all.
+     */
+    struct branch {
+        branch_kind kind;
+        std::string_view line, condition;
+        uint32_t next = 0, end = 0;
+    };
+
+    // A file as the preprocessor sees it: runs of ordinary text, and the directives between them.
+    // A library file with a precompiled interface is only the reference to it.
+    using outline = std::vector<std::variant<piece, include_ref, interface_ref, macro_directive, branch>>;
+
+    // The preprocessed program, with the interface blobs to load in place of the files they were built from
+    struct translation_unit {
+        piece_table pieces;
+        std::vector<in::file_id> interfaces;
+    };
 
-    static bool handle_line(std::string_view line, std::stringstream &ss);
-    void preprocess(std::string &code);
-}
\ No newline at end of file
+    /**
+     *  Include Cache: Resolved and Scanned Files
+     *  -----------------------------------------
+     *  Remembers which file every include name resolved to, and the outline of
+     *  every file it has scanned for directives. A file is found and scanned the
+     *  first time it is included, after which including it again only splices
+     *  its outline, so it never touches the file system or the file's text.
+     *  Outlines do not depend on which macros are defined, so a file included
+     *  under different macros still shares one.
+     *
+     *  Include names are looked up relative to the working directory, then in
+     *  each search path in order. A file found through a search path is a
+     *  library file, which is included through its precompiled interface when
+     *  it has one, building the interface on first use.
+     */
+    class include_cache {
+    public:
+        explicit include_cache(std::vector<std::filesystem::path> search_paths = {})
+            : search_paths(std::move(search_paths)) {}
+
+        // The file an include name refers to, or nullopt if there is none
+        std::optional<in::file_id> resolve(std::string_view name, in::source_manager &sources);
+
+        const outline& scan(in::file_id file, in::source_manager &sources);
+
+    private:
+        // The current interface blob of a library file, or nullopt if it has to be included as text
+        std::optional<in::file_id> precompiled(in::file_id file, in::source_manager &sources);
+
+        std::vector<std::filesystem::path> search_paths;
+
+        std::unordered_map<std::string, in::file_id> resolved;
+        std::unordered_map<in::file_id, outline> outlines;
+        std::unordered_set<in::file_id> libraries;
+    };
+
+    static bool handle_line(std::string_view line, outline &out);
+
+    // Adds a macro given on the command line as NAME or NAME=VALUE, where a bare NAME is defined as 1
+    void define_macro(macro_table &macros, std::string_view definition);
+
+    // Every file is included at most once per program, so include guards and #pragma once are unnecessary.
+    // Directives other than #include, #define, #undef and the #if family are ignored.
+    translation_unit preprocess(in::file_id file, in::source_manager &sources, include_cache &includes, macro_table macros = {});
+}
@@ -0,0 +1,118 @@
+#include "arena.h"
+
+#include <cstdint>
+
+using namespace util;
+
+arena::arena(arena &&other) noexcept
+    : newest_chunk(std::exchange(other.newest_chunk, nullptr)),
+      oldest_chunk(std::exchange(other.oldest_chunk, nullptr)),
+      cursor(std::exchange(other.cursor, nullptr)),
+      limit(std::exchange(other.limit, nullptr)),
+      newest_record(std::exchange(other.newest_record, nullptr)),
+      oldest_record(std::exchange(other.oldest_record, nullptr)) {}
+
+arena& arena::operator=(arena &&other) noexcept {
+    if (this != &other) {
+        release();
+
+        newest_chunk = std::exchange(other.newest_chunk, nullptr);
+        oldest_chunk = std::exchange(other.oldest_chunk, nullptr);
+        cursor = std::exchange(other.cursor, nullptr);
+        limit = std::exchange(other.limit, nullptr);
+        newest_record = std::exchange(other.newest_record, nullptr);
+        oldest_record = std::exchange(other.oldest_record, nullptr);
+    }
+
+    return *this;
+}
+
+arena::~arena() {
+    release();
+}
+
+void arena::release() {
+    while (newest_record) {
+        auto *record = newest_record;
+        newest_record = record->previous;
+
+        record->destroy(record);
+    }
+
+    while (newest_chunk) {
+        auto *previous = newest_chunk->previous;
+
+        ::operator delete(newest_chunk);
+        newest_chunk = previous;
+    }
+
+    oldest_chunk = nullptr;
+    cursor = limit = nullptr;
+    oldest_record = nullptr;
+}
+
+void* arena::allocate(const size_t size, const size_t alignment) {
+    const auto align_up = [alignment](std::byte *ptr) {
+        const auto address = reinterpret_cast<uintptr_t>(ptr);
+        return ptr + ((address + alignment - 1) / alignment * alignment - address);
+    };
+
+    if (cursor) {
+        if (auto *start = align_up(cursor); start <= limit && size <= static_cast<size_t>(limit - start)) {
+            cursor = start + size;
+            return start;
+        }
+    }
+
+    // Whatever is left of the current chunk goes unused, which is little next to a whole chunk
+    const auto data_size = std::max(CHUNK_SIZE, size + alignment);
+    auto *fresh = static_cast<chunk*>(::operator new(sizeof(chunk) + data_size));
+
+    fresh->previous = newest_chunk;
+    newest_chunk = fresh;
+
+    if (!oldest_chunk)
+        oldest_chunk = fresh;
+
+    cursor = reinterpret_cast<std::byte*>(fresh + 1);
+    limit = cursor + data_size;
+
+    auto *start = align_up(cursor);
+    cursor = start + size;
+
+    return start;
+}
+
+void arena::adopt(arena &&other) {
+    if (&other == this)
+        return;
+
+    // Its chunks go behind the one being filled, which stays the one being filled
+    if (other.newest_chunk) {
+        if (!newest_chunk) {
+            newest_chunk = other.newest_chunk;
+            oldest_chunk = other.oldest_chunk;
+            cursor = other.cursor;
+            limit = other.limit;
+        } else {
+            other.oldest_chunk->previous = newest_chunk->previous;
+            newest_chunk->previous = other.newest_chunk;
+
+            if (oldest_chunk == newest_chunk)
+                oldest_chunk = other.oldest_chunk;
+        }
+    }
+
+    // Its objects are destroyed before this arena's own
+    if (other.newest_record) {
+        other.oldest_record->previous = newest_record;
+        newest_record = other.newest_record;
+
+        if (!oldest_record)
+            oldest_record = other.oldest_record;
+    }
+
+    other.newest_chunk = other.oldest_chunk = nullptr;
+    other.cursor = other.limit = nullptr;
+    other.newest_record = other.oldest_record = nullptr;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace util {
+    /**
+     *  Arena: Bump-Pointer Allocator
+     *  -----------------------------
+     *  Hands out memory from large chunks in the order it is asked for, and
+     *  frees every chunk at once when the arena is destroyed. Objects made with
+     *  make() are destroyed at that point too, newest first, so anything they
+     *  own themselves, such as a vector's storage, is still released. Nothing
+     *  made in an arena may be used once it is gone.
+     *
+     *  An arena is unsynchronized. Threads each fill an arena of their own, and
+     *  one arena may then adopt the others, taking over everything in them.
+     */
+    class arena {
+    public:
+        arena() = default;
+        arena(arena &&other) noexcept;
+        arena& operator=(arena &&other) noexcept;
+        ~arena();
+
+        arena(const arena&) = delete;
+        arena& operator=(const arena&) = delete;
+
+        void* allocate(size_t size, size_t alignment);
+
+        template <typename T, typename... Args>
+        T* make(Args&&... args) {
+            if constexpr (std::is_trivially_destructible_v<T>) {
+                return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+            } else {
+                // The record of how to destroy the object sits directly in front of it
+                constexpr auto offset = (sizeof(destructor_record) + alignof(T) - 1) / alignof(T) * alignof(T);
+
+                auto *block = static_cast<std::byte*>(
+                    allocate(offset + sizeof(T), std::max(alignof(T), alignof(destructor_record)))
+                );
+                auto *object = new (block + offset) T(std::forward<Args>(args)...);
+
+                // Only linked in once constructed, so an object whose constructor threw is never destroyed
+                auto *record = new (block) destructor_record {
+                    [](destructor_record *record) {
+                        std::launder(reinterpret_cast<T*>(reinterpret_cast<std::byte*>(record) + offset))->~T();
+                    },
+                    newest_record
+                };
+
+                if (!newest_record)
+                    oldest_record = record;
+
+                newest_record = record;
+                return object;
+            }
+        }
+
+        // Takes over the memory and objects of another arena, which is left empty
+        void adopt(arena &&other);
+
+    private:
+        struct alignas(std::max_align_t) chunk {
+            chunk *previous;
+        };
+
+        struct destructor_record {
+            void (*destroy)(destructor_record *record);
+            destructor_record *previous;
+        };
+
+        static constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+        // The chunk being filled is the newest, and the others are linked behind it
+        chunk *newest_chunk = nullptr, *oldest_chunk = nullptr;
+        std::byte *cursor = nullptr, *limit = nullptr;
+
+        destructor_record *newest_record = nullptr, *oldest_record = nullptr;
+
+        void release();
+    };
+}
@@ -0,0 +1,121 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+using namespace util;
+
+namespace {
+    // The pool and deque of the worker running on this thread, if it is one
+    thread_local const void *current_pool = nullptr;
+    thread_local size_t current_index = 0;
+}
+
+thread_pool::thread_pool(const size_t threads) {
+    // hardware_concurrency() may report 0 when it cannot tell
+    const auto count = std::max<size_t>(threads, 1);
+
+    queues.reserve(count);
+    workers.reserve(count);
+
+    for (size_t i = 0; i < count; i++)
+        queues.push_back(std::make_unique<worker_queue>());
+
+    for (size_t i = 0; i < count; i++)
+        workers.emplace_back([this, i] { work(i); });
+}
+
+thread_pool::~thread_pool() {
+    {
+        std::scoped_lock lock { mutex };
+        stopping = true;
+    }
+
+    available.notify_all();
+}
+
+thread_pool& thread_pool::shared() {
+    static thread_pool pool;
+    return pool;
+}
+
+void thread_pool::enqueue(std::function<void()> job) {
+    const auto index = current_pool == this ?
+        current_index :
+        next_queue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+
+    // Counted before the job is queued, so no worker can take it while it is still uncounted, and
+    // under the lock workers sleep with, so none of them can miss the wakeup
+    {
+        std::scoped_lock lock { mutex };
+        pending++;
+    }
+
+    {
+        std::scoped_lock lock { queues[index]->mutex };
+        queues[index]->jobs.push_back(std::move(job));
+    }
+
+    available.notify_one();
+}
+
+std::function<void()> thread_pool::take(const size_t index) {
+    {
+        auto &own = *queues[index];
+        std::scoped_lock lock { own.mutex };
+
+        if (!own.jobs.empty()) {
+            auto job = std::move(own.jobs.back());
+            own.jobs.pop_back();
+            return job;
+        }
+    }
+
+    for (size_t offset = 1; offset < queues.size(); offset++) {
+        auto &victim = *queues[(index + offset) % queues.size()];
+        std::scoped_lock lock { victim.mutex };
+
+        if (!victim.jobs.empty()) {
+            auto job = std::move(victim.jobs.front());
+            victim.jobs.pop_front();
+            return job;
+        }
+    }
+
+    return nullptr;
+}
+
+bool thread_pool::run_one() {
+    // A worker keeps to its own deque first, just as it does outside of a wait
+    auto job = take(current_pool == this ? current_index : 0);
+
+    if (!job)
+        return false;
+
+    pending--;
+    job();
+
+    return true;
+}
+
+void thread_pool::work(const size_t index) {
+    current_pool = this;
+    current_index = index;
+
+    while (true) {
+        {
+            std::unique_lock lock { mutex };
+            available.wait(lock, [this] { return stopping || pending > 0; });
+
+            if (pending == 0)
+                return;
+        }
+
+        // Another worker may have taken the job that woke this one, in which case it goes back to waiting
+        if (auto job = take(index)) {
+            pending--;
+            job();
+        } else {
+            std::this_thread::yield();
+        }
+    }
+}
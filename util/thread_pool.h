@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace util {
+    /**
+     *  Thread Pool: Work-Stealing Worker Set
+     *  -------------------------------------
+     *  A fixed number of workers, each with a deque of its own. Jobs submitted
+     *  from outside the pool are dealt to the deques in turn, and jobs a worker
+     *  submits go onto its own. A worker runs its newest job first, and once it
+     *  has none left steals the oldest job of another, so uneven jobs even out
+     *  without every worker contending for one queue.
+     *
+     *  submit() hands back a future for the job's result, and any exception the
+     *  job throws is rethrown from that future's get(). Destroying the pool
+     *  finishes every job that was already submitted.
+     *
+     *  Anything waiting on a job should do so through wait(), which runs other
+     *  queued jobs until the one waited on is done. A job can then wait on jobs
+     *  of its own, such as a parse run from inside the pool waiting on its
+     *  chunks, without every worker ending up blocked on work none can run.
+     */
+    class thread_pool {
+    public:
+        explicit thread_pool(size_t threads = std::thread::hardware_concurrency());
+        ~thread_pool();
+
+        thread_pool(const thread_pool&) = delete;
+        thread_pool& operator=(const thread_pool&) = delete;
+
+        size_t size() const { return workers.size(); }
+
+        template <typename Fn>
+        auto submit(Fn&& fn) -> std::future<std::invoke_result_t<Fn>> {
+            using result_t = std::invoke_result_t<Fn>;
+
+            auto task = std::make_shared<std::packaged_task<result_t()>>(std::forward<Fn>(fn));
+            auto future = task->get_future();
+
+            enqueue([task] { (*task)(); });
+
+            return future;
+        }
+
+        // Blocks until future is ready, running queued jobs on this thread in the meantime
+        template <typename T>
+        void wait(const std::future<T> &future) {
+            while (future.wait_for(std::chrono::seconds { 0 }) != std::future_status::ready) {
+                if (!run_one())
+                    future.wait_for(IDLE_WAIT);
+            }
+        }
+
+        // A pool sized to the machine, created on first use and shared by the whole compiler
+        static thread_pool& shared();
+
+    private:
+        struct worker_queue {
+            std::mutex mutex;
+            std::deque<std::function<void()>> jobs;
+        };
+
+        // How long wait() sleeps when there is nothing to run, before looking for new jobs again
+        static constexpr auto IDLE_WAIT = std::chrono::microseconds { 100 };
+
+        void enqueue(std::function<void()> job);
+        void work(size_t index);
+
+        // Takes the newest job of the worker at index, or else steals the oldest job of another
+        std::function<void()> take(size_t index);
+
+        // Runs one queued job on the calling thread, and says whether there was one
+        bool run_one();
+
+        std::vector<std::unique_ptr<worker_queue>> queues;
+        std::atomic<size_t> next_queue = 0;
+
+        // Jobs submitted but not yet taken, which workers sleep on when it is 0
+        std::atomic<size_t> pending = 0;
+        bool stopping = false;
+
+        std::mutex mutex;
+        std::condition_variable available;
+
+        std::vector<std::jthread> workers;
+    };
+}